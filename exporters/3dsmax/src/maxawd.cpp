@@ -541,6 +541,7 @@ AWDTriGeom *MaxAWDExporter::ExportTriGeom(Object *obj, INode *node, ISkin *skin,
 
 		AWDGeomUtil geomUtil;
 		geomUtil.joints_per_vertex = jpv;
+		geomUtil.num_threads = 0; // One per CPU
 		geomUtil.include_uv = (opts->ExportUVs() && mesh.tvFace != NULL);
 		geomUtil.include_normals = (opts->ExportNormals() && normals && normals->GetNumNormals()>0);
 
@@ -550,11 +551,24 @@ AWDTriGeom *MaxAWDExporter::ExportTriGeom(Object *obj, INode *node, ISkin *skin,
 		if (numTris==0)
 			return NULL;
 
+		// Face-vertices are collected in flat arrays, and then handed
+		// to the geometry util all at once.
+		int numVerts = numTris * 3;
+		unsigned int *indices = (unsigned int *)malloc(numVerts * sizeof(unsigned int));
+		awd_float64 *positions = (awd_float64 *)malloc(numVerts * 3 * sizeof(awd_float64));
+		awd_float64 *uvs = NULL;
+		awd_float64 *vertNormals = NULL;
+
+		if (geomUtil.include_uv)
+			uvs = (awd_float64 *)malloc(numVerts * 2 * sizeof(awd_float64));
+		if (geomUtil.include_normals)
+			vertNormals = (awd_float64 *)malloc(numVerts * 3 * sizeof(awd_float64));
+
+		int vOut = 0;
 		for (t=0; t<numTris; t++) {
 			int v;
 			TVFace tvface;
 			Face face = mesh.faces[t];
-			DWORD *inds = face.getAllVerts();
 
 			if (geomUtil.include_uv)
 				tvface = mesh.tvFace[t];
@@ -563,46 +577,56 @@ AWDTriGeom *MaxAWDExporter::ExportTriGeom(Object *obj, INode *node, ISkin *skin,
 				int vIdx = face.getVert(v);
 				Point3 vtx = offsMtx * mesh.getVert(vIdx);
 
-				vdata *vd = (vdata *)malloc(sizeof(vdata));
-				vd->orig_idx = vIdx;
-				vd->x = vtx.x;
-				vd->y = vtx.z;
-				vd->z = vtx.y;
+				indices[vOut] = vIdx;
+				positions[vOut*3+0] = vtx.x;
+				positions[vOut*3+1] = vtx.z;
+				positions[vOut*3+2] = vtx.y;
 				
 				// Might not have UV coords
 				if (geomUtil.include_uv) {
 					int tvIdx = tvface.getTVert(v);
 					Point3 tvtx = mesh.getTVert(tvIdx);
 
-					vd->u = tvtx.x;
-					vd->v = 1.0-tvtx.y;
+					uvs[vOut*2+0] = tvtx.x;
+					uvs[vOut*2+1] = 1.0-tvtx.y;
 				}
 
 				if (geomUtil.include_normals) {
 					Point3 normal = normals->GetNormal(t, v);
-					vd->nx = normal.x;
-					vd->ny = normal.z;
-					vd->nz = normal.y;
+					vertNormals[vOut*3+0] = normal.x;
+					vertNormals[vOut*3+1] = normal.z;
+					vertNormals[vOut*3+2] = normal.y;
 				}
 
-				// If there is skinning information, copy it from the weight
-				// and joint index arrays returned by ExportSkin() above.
-				vd->num_bindings = jpv;
-				if (jpv > 0) {
-					vd->weights = (awd_float64*)malloc(jpv*sizeof(awd_float64));
-					vd->joints = (awd_uint32*)malloc(jpv*sizeof(awd_uint32));
+				// TODO: Implement sub-meshing
+				vOut++;
+			}
+		}
 
-					int memoffs = jpv*vIdx;
-					memcpy(vd->weights, weights+memoffs, jpv*sizeof(awd_float64));
-					memcpy(vd->joints, joints+memoffs, jpv*sizeof(awd_uint32));
-				}
+		vdata_arrays arrays;
+		memset(&arrays, 0, sizeof(vdata_arrays));
+		arrays.num_verts = numVerts;
+		arrays.indices = indices;
+		arrays.positions = positions;
+		arrays.uvs = uvs;
+		arrays.normals = vertNormals;
+
+		// If there is skinning information, it is looked up by vertex
+		// index in the weight and joint index arrays returned by
+		// ExportSkin() above.
+		if (jpv > 0) {
+			arrays.num_bindings = jpv;
+			arrays.bindings_by_index = true;
+			arrays.weights = weights;
+			arrays.joints = joints;
+		}
 
-				vd->mtlid = 0; // TODO: Implement sub-meshing
-				vd->force_hard = false;
+		geomUtil.append_vert_arrays(&arrays);
 
-				geomUtil.append_vdata_struct(vd);
-			}
-		}
+		free(indices);
+		free(positions);
+		free(uvs);
+		free(vertNormals);
 		
 		// Generate geometry name by concatenating the name 
 		// of the mesh/node with the suffix "_geom"
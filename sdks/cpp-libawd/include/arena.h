@@ -0,0 +1,45 @@
+#ifndef _LIBAWD_ARENA_H
+#define _LIBAWD_ARENA_H
+
+#include <stddef.h>
+
+
+// Size of the first chunk of an arena. Every new chunk is twice the
+// size of the previous one, up to AWD_ARENA_MAX_CHUNK_SIZE.
+#define AWD_ARENA_CHUNK_SIZE 0x10000
+#define AWD_ARENA_MAX_CHUNK_SIZE 0x1000000
+
+// All allocations are aligned to this many bytes
+#define AWD_ARENA_ALIGN 16
+
+
+typedef struct _awd_arena_chunk {
+    struct _awd_arena_chunk *next;
+    size_t size;
+    size_t used;
+} awd_arena_chunk;
+
+
+/**
+ * Bump allocator for lots of small, short-lived allocations that are
+ * all released at the same time, when the arena is deleted. Memory is
+ * taken from large chunks, so there is no per-allocation overhead, and
+ * individual allocations can not (and must not) be freed.
+*/
+class AWDArena
+{
+    private:
+        awd_arena_chunk *chunks;
+        size_t next_size;
+
+        awd_arena_chunk *add_chunk(size_t);
+
+    public:
+        AWDArena();
+        ~AWDArena();
+
+        void *alloc(size_t);
+        bool owns(const void *);
+};
+
+#endif
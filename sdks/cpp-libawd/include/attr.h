@@ -3,6 +3,8 @@
 
 #include "ns.h"
 #include "awd_types.h"
+#include "outstream.h"
+#include "field.h"
 
 #define ATTR_RETURN_NULL AWD_field_ptr _ptr; _ptr.v = NULL; return _ptr;
 
@@ -14,11 +16,12 @@ class AWDAttr
         AWD_field_type type;
         AWD_field_ptr value;
         awd_uint32 value_len;
+        awd_value_encoder encoder;
 
-        virtual void write_metadata(int)=0;
+        virtual void write_metadata(AWDOutputStream *)=0;
 
     public:
-        void write_attr(int, bool);
+        void write_attr(AWDOutputStream *, bool);
 
         void set_val(AWD_field_ptr, awd_uint32, AWD_field_type);
         AWD_field_ptr get_val(awd_uint32 *, AWD_field_type *);
@@ -38,7 +41,7 @@ class AWDUserAttr :
         AWDNamespace *ns;
         
     protected:
-        void write_metadata(int);
+        void write_metadata(AWDOutputStream *);
 
     public:
         AWDUserAttr *next;
@@ -64,7 +67,7 @@ class AWDUserAttrList {
         ~AWDUserAttrList();
 
         awd_uint32 calc_length(bool);
-        void write_attributes(int, bool);
+        void write_attributes(AWDOutputStream *, bool);
 
         AWD_field_ptr get_val_ptr(AWDNamespace *ns, const char *, awd_uint16);
         bool get(AWDNamespace *, const char *, awd_uint16, AWD_field_ptr *, awd_uint32 *, AWD_field_type *);
@@ -82,7 +85,7 @@ class AWDNumAttr :
     public AWDAttr
 {
     protected:
-        void write_metadata(int);
+        void write_metadata(AWDOutputStream *);
 
     public:
         awd_propkey key;
@@ -104,7 +107,7 @@ class AWDNumAttrList {
         AWDNumAttrList();
         ~AWDNumAttrList();
         awd_uint32 calc_length(bool);
-        void write_attributes(int, bool);
+        void write_attributes(AWDOutputStream *, bool);
 
         AWD_field_ptr get_val_ptr(awd_propkey);
         bool get(awd_propkey, AWD_field_ptr *, awd_uint32 *, AWD_field_type *);
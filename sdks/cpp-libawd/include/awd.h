@@ -14,9 +14,28 @@
 #include "uvanim.h"
 #include "scene.h"
 #include "meta.h"
+#include "toc.h"
+#include "nameidx.h"
+#include "outstream.h"
 
 
 #define AWD_STREAMING               0x1
+#define AWD_WIDE_GEOM               0x2
+#define AWD_WIDE_MTX                0x4
+#define AWD_TOC                     0x8
+#define AWD_NAME_INDEX              0x10
+
+#define AWD_HEADER_LENGTH           12
+
+// Size of output window used in streaming mode. Blocks are buffered
+// up to this size before being compressed and written to the file.
+#define AWD_STREAM_WINDOW           0x100000
+
+// Number of blocks per thread that are serialized in parallel before
+// being written out in order, and the output buffer size each block
+// is serialized with.
+#define AWD_BLOCK_BATCH_SIZE        16
+#define AWD_BLOCK_BUFSIZE           0x10000
 
 
 class AWD
@@ -45,11 +64,29 @@ class AWD
         awd_baddr last_used_baddr;
         awd_nsid last_used_nsid;
         awd_bool header_written;
-
-        void write_header(int, awd_uint32);
+        size_t stream_window;
+        int num_threads;
+        bool parallel_deflate;
+        bool parallel_blocks;
+        int compression_level;
+        bool long_distance;
+        AWD_compression block_compression;
+        awd_uint32 block_threshold;
+        AWDTocBlock *toc;
+        AWDNameIndexBlock *name_index;
+        awd_uint64 toc_offset;
+
+        void write_header(AWDOutputStream *, awd_uint32);
         void flatten_scene(AWDSceneBlock *, AWDBlockList *);
-        size_t write_scene(AWDBlockList *, int);
-        size_t write_blocks(AWDBlockList *, int);
+        size_t write_scene(AWDBlockList *, AWDOutputStream *);
+        size_t write_single_block(AWDBlock *, AWDOutputStream *);
+        size_t write_blocks(AWDBlockList *, AWDOutputStream *);
+        void collect_blocks(AWDBlockList *, AWDBlockList *);
+        void write_blocks_parallel(AWDOutputStream *);
+        void write_all_blocks(AWDOutputStream *);
+        void write_toc_footer(AWDOutputStream *);
+        AWDSink *create_compressor(AWDSink *);
+        awd_uint32 flush_streaming(int);
 
     public:
         AWD(AWD_compression, awd_uint16);
@@ -58,6 +95,28 @@ class AWD
 
         bool has_flag(int);
 
+        size_t get_stream_window();
+        void set_stream_window(size_t);
+
+        int get_num_threads();
+        void set_num_threads(int);
+
+        bool get_parallel_deflate();
+        void set_parallel_deflate(bool);
+
+        bool get_parallel_blocks();
+        void set_parallel_blocks(bool);
+
+        int get_compression_level();
+        void set_compression_level(int);
+
+        bool get_long_distance_matching();
+        void set_long_distance_matching(bool);
+
+        AWD_compression get_block_compression();
+        void set_block_compression(AWD_compression);
+        void set_block_compression(AWD_compression, awd_uint32);
+
         static const int VERSION_MAJOR;
         static const int VERSION_MINOR;
         static const int VERSION_BUILD;
@@ -10,6 +10,7 @@ typedef int awd_int32;
 typedef unsigned char awd_uint8;
 typedef unsigned short awd_uint16;
 typedef unsigned int awd_uint32;
+typedef unsigned long long awd_uint64;
 
 typedef float awd_float32;
 typedef double awd_float64;
@@ -32,11 +33,13 @@ typedef unsigned char awd_bool;
 /*
 #define UI16(x) awdutil_swapui16(x)
 #define UI32(x) awdutil_swapui32(x)
+#define UI64(x) awdutil_swapui64(x)
 #define F32(x)  awdutil_swapf32(x)
 #define F64(x)  awdutil_swapf64(x)
 */
 #define UI16(x) x
 #define UI32(x) x
+#define UI64(x) x
 #define F32(x)  x
 #define F64(x)  x
 
@@ -125,6 +128,8 @@ typedef enum {
     UV_ANIM=121,
 
     // Misc
+    NAME_INDEX=252,
+    TOC=253,
     NAMESPACE=254,
     METADATA=255
 
@@ -135,7 +140,10 @@ typedef enum {
 typedef enum {
     UNCOMPRESSED,
     DEFLATE,
-    LZMA
+    LZMA,
+    LZMA_CHUNKED,
+    ZSTD,
+    LZ4
 } AWD_compression;
 
 
@@ -5,6 +5,29 @@
 
 //#include "awd.h"
 #include "awd_types.h"
+#include "outstream.h"
+
+
+// Address, namespace, type, flags and body length
+#define AWD_BLOCK_HEADER_LENGTH 11
+
+// The upper four bits of the block flags hold the compression type
+// of the block body. A compressed body starts with the length of the
+// uncompressed body, followed by the compressed data.
+#define AWD_BLOCK_COMPRESSION_SHIFT 4
+#define AWD_BLOCK_COMPRESSION_MASK  0xf0
+
+// Block bodies smaller than this are not worth compressing
+#define AWD_BLOCK_COMPRESS_THRESHOLD 0x1000
+
+
+// Describes how a block was stored by write_block()
+typedef struct {
+    awd_uint8 flags;
+    awd_uint32 length;          // Uncompressed body length
+    awd_uint32 stored_length;   // Body length as written to the file
+} AWD_block_info;
+
 
 class AWDBlock
 {
@@ -12,21 +35,26 @@ class AWDBlock
         awd_baddr addr;
         awd_uint8 flags;
 
+        void write_header(AWDOutputStream *, awd_uint8, awd_uint32);
+
     protected:
         AWD_block_type type;
         virtual void prepare_write();
         virtual awd_uint32 calc_body_length(bool)=0;
-        virtual void write_body(int,bool)=0;
+        virtual void write_body(AWDOutputStream *,bool)=0;
 
     public:
         AWDBlock(AWD_block_type);
+        virtual ~AWDBlock();
 
         awd_baddr get_addr();
+        void set_addr(awd_baddr);
         AWD_block_type get_type();
 
         //virtual void add_dependencies(AWD *);
 
-        size_t write_block(int, awd_baddr);
+        size_t write_block(AWDOutputStream *, awd_baddr);
+        size_t write_block(AWDOutputStream *, awd_baddr, AWD_compression, int, awd_uint32, AWD_block_info *);
 };
 
 typedef struct _list_block
@@ -39,12 +67,14 @@ class AWDBlockList
 {
     private:
         int num_blocks;
+        bool own_blocks;
 
     public:
         list_block *first_block;
         list_block *last_block;
 
         AWDBlockList();
+        AWDBlockList(bool);
         ~AWDBlockList();
 
         bool append(AWDBlock *);
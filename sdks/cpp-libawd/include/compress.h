@@ -0,0 +1,240 @@
+#ifndef _LIBAWD_COMPRESS_H
+#define _LIBAWD_COMPRESS_H
+
+#include <zlib.h>
+#ifdef AWD_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AWD_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "awd_types.h"
+#include "sink.h"
+
+
+#define AWD_ZCHUNK_SIZE 0x10000
+
+// Default amount of uncompressed data per independently compressed
+// chunk in LZMA_CHUNKED bodies, and the dictionary size LZMA uses at
+// compression level 9 (which chunks never need to exceed.)
+#define AWD_LZMA_CHUNK_SIZE 0x800000
+#define AWD_LZMA_MAX_DICT_SIZE 0x4000000
+
+// Chunk size for parallel DEFLATE, and the amount of preceding
+// data each chunk is primed with (the maximum deflate distance.)
+#define AWD_DEFLATE_CHUNK_SIZE 0x20000
+#define AWD_DEFLATE_DICT_SIZE 0x8000
+
+// Compression levels used unless a level has been set explicitly.
+// LZ4 levels from 3 and up use the LZ4-HC compressor.
+#define AWD_DEFAULT_LEVEL -1
+#define AWD_DEFLATE_DEFAULT_LEVEL 9
+#define AWD_LZMA_DEFAULT_LEVEL 9
+#define AWD_ZSTD_DEFAULT_LEVEL 19
+#define AWD_LZ4_DEFAULT_LEVEL 9
+
+// Window size (log2) for Zstandard long distance matching
+#define AWD_ZSTD_LDM_WINDOW_LOG 27
+
+
+AWDSink *   awdcomp_create_sink(AWDSink *, AWD_compression, int, int, bool, bool);
+
+
+/**
+ * Sink that DEFLATE-compresses everything written to it and passes
+ * the compressed data on to another sink, one bounded chunk at a
+ * time. The complete zlib stream is only terminated by finish().
+*/
+class AWDDeflateSink :
+    public AWDSink
+{
+    private:
+        AWDSink *next;
+        z_stream zstrm;
+        awd_uint8 *out_buf;
+        bool finished;
+        bool error;
+
+        void deflate_input(int);
+
+    public:
+        AWDDeflateSink(AWDSink *, int);
+        ~AWDDeflateSink();
+
+        void write_bytes(const void *, size_t);
+        void finish();
+
+        bool has_error();
+};
+
+
+/**
+ * Sink that LZMA-compresses everything written to it. The LZMA SDK
+ * encoder pulls its input, so the uncompressed data is collected in
+ * memory and encoded by finish(), which writes the AWD LZMA body
+ * (uncompressed length, encoder props and compressed data) straight
+ * into the next sink.
+*/
+class AWDLzmaSink :
+    public AWDSink
+{
+    private:
+        AWDSink *next;
+        AWDMemorySink *input;
+        int level;
+        bool finished;
+
+    public:
+        AWDLzmaSink(AWDSink *, int);
+        ~AWDLzmaSink();
+
+        void write_bytes(const void *, size_t);
+        void finish();
+};
+
+/**
+ * Base for sinks that split everything written to them into chunks of
+ * a fixed size, and compress one chunk per thread in parallel. Chunks
+ * are collected until there is one for every thread, after which the
+ * whole batch is compressed by compress_batch() and written in order.
+*/
+class AWDChunkingSink :
+    public AWDSink
+{
+    protected:
+        AWDSink *next;
+        int num_threads;
+        size_t chunk_size;
+        AWDMemorySink **inputs;
+        AWDMemorySink **outputs;
+        int num_filled;
+        bool finished;
+
+        void flush_batch();
+        virtual void compress_batch()=0;
+        virtual void finish_stream();
+
+    public:
+        AWDChunkingSink(AWDSink *, int, size_t);
+        ~AWDChunkingSink();
+
+        void write_bytes(const void *, size_t);
+        void finish();
+};
+
+
+/**
+ * Sink that LZMA-compresses chunks independently of each other on
+ * multiple threads. Each chunk is written as its compressed length
+ * followed by a regular AWD LZMA body, so that readers can find all
+ * chunks without decompressing anything, and decompress them in
+ * parallel as well.
+*/
+class AWDChunkedLzmaSink :
+    public AWDChunkingSink
+{
+    private:
+        int level;
+
+    protected:
+        void compress_batch();
+
+    public:
+        AWDChunkedLzmaSink(AWDSink *, int, int, size_t);
+};
+
+
+/**
+ * Sink that DEFLATE-compresses chunks on multiple threads, the way
+ * pigz does. Chunks are raw deflate data ending on a sync flush, each
+ * primed with the last 32K of the preceding data, and are joined into
+ * a single regular zlib stream with a combined adler32 checksum.
+*/
+class AWDParallelDeflateSink :
+    public AWDChunkingSink
+{
+    private:
+        int level;
+        uLong adler;
+        bool started;
+        bool error;
+        awd_uint8 dict[AWD_DEFLATE_DICT_SIZE];
+        size_t dict_len;
+
+        void write_zlib_header();
+
+    protected:
+        void compress_batch();
+        void finish_stream();
+
+    public:
+        AWDParallelDeflateSink(AWDSink *, int, int, size_t);
+
+        bool has_error();
+};
+
+#ifdef AWD_WITH_ZSTD
+/**
+ * Sink that compresses everything written to it into a single
+ * Zstandard frame, optionally using long distance matching and
+ * the library's own worker threads.
+*/
+class AWDZstdSink :
+    public AWDSink
+{
+    private:
+        AWDSink *next;
+        ZSTD_CCtx *cctx;
+        awd_uint8 *out_buf;
+        size_t out_size;
+        bool finished;
+        bool error;
+
+        void compress_input(ZSTD_inBuffer *, ZSTD_EndDirective);
+
+    public:
+        AWDZstdSink(AWDSink *, int, bool, int);
+        ~AWDZstdSink();
+
+        void write_bytes(const void *, size_t);
+        void finish();
+
+        bool has_error();
+};
+#endif
+
+
+#ifdef AWD_WITH_LZ4
+/**
+ * Sink that compresses everything written to it into a single LZ4
+ * frame. Levels of LZ4HC_CLEVEL_MIN and above select LZ4-HC.
+*/
+class AWDLz4Sink :
+    public AWDSink
+{
+    private:
+        AWDSink *next;
+        LZ4F_cctx *cctx;
+        LZ4F_preferences_t prefs;
+        awd_uint8 *out_buf;
+        size_t out_size;
+        bool started;
+        bool finished;
+        bool error;
+
+        void begin();
+        void emit(size_t);
+
+    public:
+        AWDLz4Sink(AWDSink *, int);
+        ~AWDLz4Sink();
+
+        void write_bytes(const void *, size_t);
+        void finish();
+
+        bool has_error();
+};
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _LIBAWD_CONVERT_H
+#define _LIBAWD_CONVERT_H
+
+#include <stddef.h>
+
+#include "awd_types.h"
+
+
+/**
+ * Bulk conversion of arrays to a narrower on-disk type, written to an
+ * output buffer without alignment requirements. Integers are truncated
+ * and doubles rounded the same way a cast does, so output is identical
+ * to converting one element at a time. Uses SSE2 (and AVX/AVX2) when
+ * the compiler targets it, with a scalar loop for everything else.
+ *
+ * File and host byte order are assumed to be the same (see UI16() and
+ * friends in awd_types.h.)
+*/
+void            awdconv_f64_to_f32(awd_uint8 *, const awd_float64 *, size_t);
+void            awdconv_u32_to_u16(awd_uint8 *, const awd_uint32 *, size_t);
+void            awdconv_u32_to_u8(awd_uint8 *, const awd_uint32 *, size_t);
+void            awdconv_i32_to_i16(awd_uint8 *, const awd_int32 *, size_t);
+void            awdconv_i32_to_i8(awd_uint8 *, const awd_int32 *, size_t);
+
+#endif
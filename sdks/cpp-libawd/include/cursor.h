@@ -0,0 +1,86 @@
+#ifndef _LIBAWD_CURSOR_H
+#define _LIBAWD_CURSOR_H
+
+#include <string.h>
+
+#include "awd_types.h"
+#include "outstream.h"
+
+
+/**
+ * Bounds-checked read position in a buffer of serialized AWD data, the
+ * reading counterpart of AWDOutputStream. Reading past the end of the
+ * buffer returns zeros and sets the error flag, so that parsers can do
+ * all their reads first and check for errors once.
+*/
+class AWDCursor
+{
+    private:
+        const awd_uint8 *pos;
+        const awd_uint8 *end;
+        bool error;
+
+        template <typename T>
+        T get_scalar()
+        {
+            T v;
+
+            if ((size_t)(this->end - this->pos) < sizeof(T)) {
+                this->error = true;
+                this->pos = this->end;
+                return 0;
+            }
+
+            memcpy(&v, this->pos, sizeof(T));
+            this->pos += sizeof(T);
+
+            return awd_bo(v);
+        }
+
+    public:
+        AWDCursor(const awd_uint8 *data, size_t len)
+        {
+            this->pos = data;
+            this->end = data + len;
+            this->error = false;
+        }
+
+        bool has_error()                { return this->error; }
+        size_t get_remaining()          { return (size_t)(this->end - this->pos); }
+        const awd_uint8 *get_pointer()  { return this->pos; }
+
+        // Returns pointer to the next len bytes and skips past them,
+        // or NULL if there are not that many bytes left.
+        const awd_uint8 *get_bytes(size_t len)
+        {
+            const awd_uint8 *data;
+
+            if ((size_t)(this->end - this->pos) < len) {
+                this->error = true;
+                this->pos = this->end;
+                return NULL;
+            }
+
+            data = this->pos;
+            this->pos += len;
+
+            return data;
+        }
+
+        inline awd_uint8 get_ui8()      { return this->get_scalar<awd_uint8>(); }
+        inline awd_uint16 get_ui16()    { return this->get_scalar<awd_uint16>(); }
+        inline awd_uint32 get_ui32()    { return this->get_scalar<awd_uint32>(); }
+        inline awd_uint64 get_ui64()    { return this->get_scalar<awd_uint64>(); }
+        inline awd_float32 get_f32()    { return this->get_scalar<awd_float32>(); }
+        inline awd_float64 get_f64()    { return this->get_scalar<awd_float64>(); }
+
+        // String prefixed by 16-bit length, as written by put_varstr().
+        // The string is not null-terminated.
+        const char *get_varstr(awd_uint16 *len)
+        {
+            *len = this->get_ui16();
+            return (const char *)this->get_bytes(*len);
+        }
+};
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _LIBAWD_DECOMPRESS_H
+#define _LIBAWD_DECOMPRESS_H
+
+#include "awd_types.h"
+#include "sink.h"
+
+
+// Decompress an entire body (file body or block body) of the specified
+// compression type, appending the uncompressed data to the sink. Chunked
+// LZMA bodies are decompressed on the specified number of threads.
+bool        awdcomp_decompress(AWD_compression, const awd_uint8 *, size_t, AWDMemorySink *, int);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _LIBAWD_FIELD_H
+#define _LIBAWD_FIELD_H
+
+#include "awd_types.h"
+#include "outstream.h"
+
+
+/**
+ * Compile-time description of each field type: the type its values
+ * have in memory, how many of them make up one element, and the size
+ * of an element in the file (with narrow and wide floats.) Strings and
+ * byte arrays have no fixed size and are not described.
+*/
+template <AWD_field_type F> struct AWDField;
+
+#define AWD_DEFINE_FIELD(F, T) \
+    template <> struct AWDField<F> { \
+        typedef T type; \
+        enum { num_values = 1, size = sizeof(T), wide_size = sizeof(T) }; \
+    };
+#define AWD_DEFINE_FLOAT_FIELD(F, N) \
+    template <> struct AWDField<F> { \
+        typedef awd_float64 type; \
+        enum { num_values = N, size = N*sizeof(awd_float32), wide_size = N*sizeof(awd_float64) }; \
+    };
+
+AWD_DEFINE_FIELD(AWD_FIELD_INT8, awd_int8)
+AWD_DEFINE_FIELD(AWD_FIELD_INT16, awd_int16)
+AWD_DEFINE_FIELD(AWD_FIELD_INT32, awd_int32)
+AWD_DEFINE_FIELD(AWD_FIELD_UINT8, awd_uint8)
+AWD_DEFINE_FIELD(AWD_FIELD_UINT16, awd_uint16)
+AWD_DEFINE_FIELD(AWD_FIELD_UINT32, awd_uint32)
+AWD_DEFINE_FIELD(AWD_FIELD_FLOAT32, awd_float32)
+AWD_DEFINE_FIELD(AWD_FIELD_FLOAT64, awd_float64)
+AWD_DEFINE_FIELD(AWD_FIELD_BOOL, awd_bool)
+AWD_DEFINE_FIELD(AWD_FIELD_COLOR, awd_color)
+AWD_DEFINE_FIELD(AWD_FIELD_BADDR, awd_baddr)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_VECTOR2x1, 2)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_VECTOR3x1, 3)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_VECTOR4x1, 4)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_MTX3x2, 6)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_MTX3x3, 9)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_MTX4x3, 12)
+AWD_DEFINE_FLOAT_FIELD(AWD_FIELD_MTX4x4, 16)
+
+#undef AWD_DEFINE_FIELD
+#undef AWD_DEFINE_FLOAT_FIELD
+
+
+/**
+ * Encoders write an array of values of one field type. Which encoder to
+ * use is looked up once (e.g. when a stream is created or an attribute
+ * is set), so that writing involves no switching on the field type.
+*/
+
+// Writes num values held in memory as S, as field type F
+typedef void (*awd_array_encoder)(AWDOutputStream *, const void *, size_t);
+
+template <AWD_field_type F, typename S>
+void awd_encode_array(AWDOutputStream *out, const void *src, size_t num)
+{
+    out->put_array<typename AWDField<F>::type>((const S *)src, num);
+}
+
+// Writes an attribute value of the given length, as field type F
+typedef void (*awd_value_encoder)(AWDOutputStream *, const void *, awd_uint32, bool);
+
+template <AWD_field_type F>
+void awd_encode_value(AWDOutputStream *out, const void *val, awd_uint32 len, bool wide_mtx)
+{
+    typedef typename AWDField<F>::type T;
+
+    if (AWDField<F>::num_values > 1) {
+        // Vectors and matrices are kept as doubles in memory
+        out->put_floats((const awd_float64 *)val, len, wide_mtx);
+    }
+    else {
+        out->put_array<T>((const T *)val, len / sizeof(T));
+    }
+}
+
+
+awd_array_encoder   awdutil_get_array_encoder(AWD_field_type, AWD_field_type);
+awd_value_encoder   awdutil_get_value_encoder(AWD_field_type);
+
+#endif
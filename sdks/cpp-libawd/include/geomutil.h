@@ -2,6 +2,8 @@
 #define _GEOMUTILS_H
 
 #include "mesh.h"
+#include "arena.h"
+#include "vcache.h"
 
 typedef struct _ninfluence {
     double nx;
@@ -13,7 +15,6 @@ typedef struct _ninfluence {
 
 typedef struct _vdata {
     unsigned int orig_idx;
-    int out_idx;
 
     // Position
     awd_float64 x;
@@ -37,48 +38,101 @@ typedef struct _vdata {
     int mtlid;
 
     bool force_hard;
-
-    ninfluence *first_normal_influence;
-    ninfluence *last_normal_influence;
 } vdata;
 
-typedef struct _vdata_list_item {
-	vdata *vd;
-	struct _vdata_list_item *next;
-} vdata_list_item;
 
-class VertexDataList
-{
-private:
-	int num_items;
-	vdata_list_item *cur;
-	vdata_list_item *first;
-	vdata_list_item *last;
+/**
+ * Contiguous arrays describing a range of face-vertices, for appending
+ * them to an AWDGeomUtil all at once. Positions and normals are three
+ * values per vertex and UVs are two. UVs, normals and force_hard flags
+ * are optional (NULL), and default to zero/false.
+ *
+ * Skinning bindings are num_bindings weights and joint indices per
+ * vertex, with binding_stride values between the first binding of one
+ * vertex and the next (or num_bindings if zero.) If bindings_by_index
+ * is set, they are looked up by original index instead of by position
+ * in the arrays, for clients that store skinning per client vertex.
+*/
+typedef struct {
+    unsigned int num_verts;
+    const unsigned int *indices;
+    const awd_float64 *positions;
+    const awd_float64 *uvs;
+    const awd_float64 *normals;
+    const bool *force_hard;
 
-public:
-	VertexDataList();
-	~VertexDataList();
+    int num_bindings;
+    int binding_stride;
+    bool bindings_by_index;
+    const awd_float64 *weights;
+    const awd_uint32 *joints;
+} vdata_arrays;
 
-	void append_vdata(vdata *);
-	void clear();
-	int get_num_items();
 
-	void iter_reset();
-	vdata *iter_next();
-};
+// Unit of work when building geometry on multiple threads
+typedef struct _awd_geom_job awd_geom_job;
+
 
 class AWDGeomUtil
 {
 private:
-	VertexDataList *expanded;
-	VertexDataList *collapsed;
-	
-	int max_orig_idx;
-	int num_idx_lists;
-	VertexDataList **per_idx_lists;
-
-	void prepare_build();
-    int has_vert(vdata *);
+	// Backs vertex data structs returned by alloc_vdata(), which
+	// are released all at once with the util.
+	AWDArena *arena;
+
+	// Expanded vertices (one per face-vertex, in the order they were
+	// appended) stored as parallel arrays.
+	unsigned int num_verts;
+	unsigned int max_verts;
+	unsigned int *vert_idx;
+	awd_float64 *vert_pos;
+	awd_float64 *vert_uv;
+	awd_float64 *vert_nrm;
+	bool *vert_hard;
+	int *vert_num_bindings;
+
+	// Skinning bindings of all expanded vertices, back to back
+	unsigned int num_bind_vals;
+	unsigned int max_bind_vals;
+	awd_float64 *bind_weights;
+	awd_uint32 *bind_joints;
+
+	// Welding state, by expanded vertex: the vertex whose output vertex
+	// it uses (itself if it created one), the next vertex that created
+	// an output vertex with the same weld key (or -1), the normals that
+	// are averaged when smoothing, and the final output index.
+	int *vert_src;
+	int *vert_next;
+	ninfluence **vert_influences;
+	int *vert_out;
+
+	// Vertices are welded in partitions by original index (vertices
+	// with different original indices are never joined) so that the
+	// partitions can be welded in parallel.
+	int num_parts;
+	unsigned int *part_verts;
+	awd_geom_job *part_jobs;
+
+	// Output streams of the current build
+	awd_float32 *out_pos;
+	awd_float32 *out_uv;
+	awd_float32 *out_nrm;
+	awd_float32 *out_weights;
+	awd_uint16 *out_joints;
+	awd_uint32 *out_tris;
+
+	void reserve_verts(unsigned int);
+	void reserve_bindings(unsigned int);
+	void prepare_build(int);
+	void end_build();
+	bool weld_key_equal(unsigned int, unsigned int);
+	unsigned int weld_hash(unsigned int);
+	void weld_part(awd_geom_job *);
+	void count_range(awd_geom_job *);
+	void output_range(awd_geom_job *);
+	void index_range(awd_geom_job *);
+
+	friend void awdgeom_run_job(void *);
 
 public:
     AWDGeomUtil();
@@ -88,9 +142,19 @@ public:
     double normal_threshold;
     bool include_uv;
     bool include_normals;
+    int num_threads;
+
+    // Reorder triangles for the post-transform vertex cache, and cache
+    // efficiency of the last built geometry before and after that.
+    bool optimize_vertex_cache;
+    int vertex_cache_size;
+    AWD_vcache_stats vcache_before;
+    AWD_vcache_stats vcache_after;
 
+    vdata *alloc_vdata(int);
     void append_vert_data(unsigned int,  double, double, double, double, double, double, double, double, bool);
     void append_vdata_struct(vdata *);
+    void append_vert_arrays(const vdata_arrays *);
     int build_geom(AWDTriGeom *);
 };
 
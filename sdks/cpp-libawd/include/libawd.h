@@ -5,8 +5,23 @@
 #include "awd_types.h"
 //#include "attr.h"
 #include "block.h"
+#include "sink.h"
+#include "outstream.h"
+#include "convert.h"
+#include "vcache.h"
+#include "field.h"
+#include "compress.h"
+#include "toc.h"
+#include "nameidx.h"
+#include "rawblock.h"
+#include "decompress.h"
+#include "cursor.h"
+#include "reader.h"
+#include "source.h"
+#include "streamdec.h"
 #include "mesh.h"
 #include "util.h"
+#include "arena.h"
 #include "skeleton.h"
 #include "skelanim.h"
 #include "material.h"
@@ -18,7 +18,7 @@ class AWDLight :
     protected:
         void prepare_write();
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDLight(const char *, awd_uint16, AWD_light_type);
@@ -39,7 +39,7 @@ class AWDMaterial :
     protected:
         awd_uint32 calc_body_length(bool);
         void prepare_write();
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDMaterial(AWD_mat_type, const char *, awd_uint16);
@@ -44,9 +44,11 @@ class AWDSubGeom :
         unsigned int get_num_streams();
         AWDDataStream *get_stream_at(unsigned int);
         void add_stream(AWD_mesh_str_type, AWD_field_type, AWD_str_ptr, awd_uint32);
+        void add_stream(AWD_mesh_str_type, AWD_field_type, AWD_str_ptr, awd_uint32, awd_release_func, void *);
+        void add_stream(AWDDataStream *);
 
         awd_uint32 calc_sub_length(bool);
-        void write_sub(int, bool);
+        void write_sub(AWDOutputStream *, bool);
 };
 
 
@@ -64,7 +66,7 @@ class AWDTriGeom :
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDTriGeom(const char *, awd_uint16);
@@ -91,7 +93,7 @@ class AWDMeshInst :
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDMeshInst(const char *, awd_uint16, AWDTriGeom *);
@@ -22,7 +22,7 @@ class AWDMetaData :
         char *encoder_version;
         void prepare_write();
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDMetaData();
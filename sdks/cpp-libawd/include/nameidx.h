@@ -0,0 +1,46 @@
+#ifndef _LIBAWD_NAMEIDX_H
+#define _LIBAWD_NAMEIDX_H
+
+#include "block.h"
+#include "awd_types.h"
+
+
+// Name hash, address and file offset
+#define AWD_NAME_INDEX_ENTRY_LENGTH 20
+
+
+typedef struct {
+    awd_uint64 name_hash;
+    awd_baddr addr;
+    awd_uint64 offset;
+} AWD_name_index_entry;
+
+
+/**
+ * Index of all named blocks, sorted by the hash of their name (and by
+ * address within blocks whose names hash the same), so that readers can
+ * look up a block by name with a binary search instead of parsing the
+ * body of every block. Unlike the TOC, the index can be used whatever
+ * the compression of the file, since blocks are found by address.
+*/
+class AWDNameIndexBlock :
+    public AWDBlock
+{
+    private:
+        AWD_name_index_entry *entries;
+        awd_uint32 num_entries;
+        awd_uint32 max_entries;
+
+    protected:
+        awd_uint32 calc_body_length(bool);
+        void write_body(AWDOutputStream *, bool);
+
+    public:
+        AWDNameIndexBlock();
+        ~AWDNameIndexBlock();
+
+        void add_entry(AWDBlock *, awd_uint64);
+        awd_uint32 get_num_entries();
+};
+
+#endif
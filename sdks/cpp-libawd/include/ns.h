@@ -14,7 +14,7 @@ class AWDNamespace :
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDNamespace(const char *, awd_uint16);
@@ -0,0 +1,143 @@
+#ifndef _LIBAWD_OUTSTREAM_H
+#define _LIBAWD_OUTSTREAM_H
+
+#include <string.h>
+
+#include "awd_types.h"
+#include "convert.h"
+#include "sink.h"
+
+
+#define AWD_OSTREAM_BUFSIZE 0x40000
+
+
+// Byte order conversion overloads, so that templated code
+// can convert any scalar type using the same call.
+inline awd_int8    awd_bo(awd_int8 v)      { return v; }
+inline awd_uint8   awd_bo(awd_uint8 v)     { return v; }
+inline awd_int16   awd_bo(awd_int16 v)     { return UI16(v); }
+inline awd_uint16  awd_bo(awd_uint16 v)    { return UI16(v); }
+inline awd_int32   awd_bo(awd_int32 v)     { return UI32(v); }
+inline awd_uint32  awd_bo(awd_uint32 v)    { return UI32(v); }
+inline awd_uint64  awd_bo(awd_uint64 v)    { return UI64(v); }
+inline awd_float32 awd_bo(awd_float32 v)   { return F32(v); }
+inline awd_float64 awd_bo(awd_float64 v)   { return F64(v); }
+
+
+// Converts an array from source type S to on-disk type D, one element
+// at a time. Conversions used by data streams are specialized below to
+// use bulk kernels, and arrays already in the on-disk type are copied
+// as they are (byte order conversions being no-ops.)
+template <typename D, typename S>
+inline void awd_convert_array(awd_uint8 *dst, const S *src, size_t num)
+{
+    size_t i;
+
+    for (i=0; i<num; i++) {
+        D elem = awd_bo((D)src[i]);
+        memcpy(dst + i*sizeof(D), &elem, sizeof(D));
+    }
+}
+
+#define AWD_CONVERT_COPY(T) \
+    template <> inline void awd_convert_array<T, T>(awd_uint8 *dst, const T *src, size_t num) \
+        { memcpy(dst, src, num * sizeof(T)); }
+#define AWD_CONVERT_KERNEL(D, S, kernel) \
+    template <> inline void awd_convert_array<D, S>(awd_uint8 *dst, const S *src, size_t num) \
+        { kernel(dst, src, num); }
+
+AWD_CONVERT_COPY(awd_int8)
+AWD_CONVERT_COPY(awd_int16)
+AWD_CONVERT_COPY(awd_int32)
+AWD_CONVERT_COPY(awd_uint8)
+AWD_CONVERT_COPY(awd_uint16)
+AWD_CONVERT_COPY(awd_uint32)
+AWD_CONVERT_COPY(awd_float32)
+AWD_CONVERT_COPY(awd_float64)
+AWD_CONVERT_KERNEL(awd_float32, awd_float64, awdconv_f64_to_f32)
+AWD_CONVERT_KERNEL(awd_uint16, awd_uint32, awdconv_u32_to_u16)
+AWD_CONVERT_KERNEL(awd_uint8, awd_uint32, awdconv_u32_to_u8)
+AWD_CONVERT_KERNEL(awd_int16, awd_int32, awdconv_i32_to_i16)
+AWD_CONVERT_KERNEL(awd_int8, awd_int32, awdconv_i32_to_i8)
+
+#undef AWD_CONVERT_COPY
+#undef AWD_CONVERT_KERNEL
+
+
+/**
+ * Buffered output stream. All serialization code writes through an
+ * output stream, which collects data in a large internal buffer and
+ * only passes it on to the underlying sink (file descriptor, memory
+ * buffer, compressor) once the buffer is full or flush() is invoked.
+*/
+class AWDOutputStream
+{
+    private:
+        AWDSink *sink;
+        awd_uint8 *buf;
+        size_t buf_len;
+        size_t buf_size;
+        size_t num_drained;
+
+        void drain();
+        void put_bytes_slow(const void *, size_t);
+
+    public:
+        AWDOutputStream(AWDSink *);
+        AWDOutputStream(AWDSink *, size_t);
+        ~AWDOutputStream();
+
+        AWDSink *get_sink();
+        size_t get_position();
+        void flush();
+
+        // Raw data
+        inline void put_bytes(const void *data, size_t len)
+        {
+            if (this->buf_len + len <= this->buf_size) {
+                memcpy(this->buf + this->buf_len, data, len);
+                this->buf_len += len;
+            }
+            else {
+                this->put_bytes_slow(data, len);
+            }
+        }
+
+        // Scalars (byte order is converted as necessary)
+        inline void put_ui8(awd_uint8 v)    { this->put_bytes(&v, sizeof(awd_uint8)); }
+        inline void put_ui16(awd_uint16 v)  { v = awd_bo(v); this->put_bytes(&v, sizeof(awd_uint16)); }
+        inline void put_ui32(awd_uint32 v)  { v = awd_bo(v); this->put_bytes(&v, sizeof(awd_uint32)); }
+        inline void put_ui64(awd_uint64 v)  { v = awd_bo(v); this->put_bytes(&v, sizeof(awd_uint64)); }
+        inline void put_f32(awd_float32 v)  { v = awd_bo(v); this->put_bytes(&v, sizeof(awd_float32)); }
+        inline void put_f64(awd_float64 v)  { v = awd_bo(v); this->put_bytes(&v, sizeof(awd_float64)); }
+
+        void put_varstr(const char *, awd_uint16);
+        void put_floats(const awd_float64 *, size_t, bool);
+
+        // Bulk arrays. Elements are converted from the source type to
+        // the destination (on-disk) type D, and written in one pass
+        // straight into the internal buffer.
+        template <typename D, typename S>
+        void put_array(const S *src, size_t num)
+        {
+            while (num > 0) {
+                size_t n;
+
+                n = (this->buf_size - this->buf_len) / sizeof(D);
+                if (n == 0) {
+                    this->drain();
+                    continue;
+                }
+
+                if (n > num)
+                    n = num;
+
+                awd_convert_array<D>(this->buf + this->buf_len, src, n);
+                this->buf_len += n * sizeof(D);
+                src += n;
+                num -= n;
+            }
+        }
+};
+
+#endif
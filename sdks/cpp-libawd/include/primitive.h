@@ -33,7 +33,7 @@ class AWDPrimitive :
     protected:
         void prepare_write();
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDPrimitive(const char *, awd_uint16, AWD_primitive_type);
@@ -0,0 +1,36 @@
+#ifndef _LIBAWD_RAWBLOCK_H
+#define _LIBAWD_RAWBLOCK_H
+
+#include "block.h"
+#include "name.h"
+#include "awd_types.h"
+
+
+/**
+ * Block with an already serialized body, e.g. one read from another
+ * file, which is written as is. This allows blocks to be copied between
+ * files (and recompressed) without materializing them. Any addresses in
+ * the body are not updated, so blocks must be written with the same
+ * addresses they were read with.
+*/
+class AWDRawBlock :
+    public AWDBlock,
+    public AWDNamedElement
+{
+    private:
+        const awd_uint8 *body;
+        awd_uint32 body_len;
+        bool own_body;
+
+    protected:
+        awd_uint32 calc_body_length(bool);
+        void write_body(AWDOutputStream *, bool);
+
+    public:
+        AWDRawBlock(AWD_block_type, const char *, awd_uint16, const awd_uint8 *, awd_uint32, bool);
+        ~AWDRawBlock();
+
+        const awd_uint8 *get_body(awd_uint32 *);
+};
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef _LIBAWD_READER_H
+#define _LIBAWD_READER_H
+
+#include <string.h>
+
+#include "awd_types.h"
+#include "attr.h"
+#include "sink.h"
+#include "cursor.h"
+#include "outstream.h"
+#include "mesh.h"
+#include "scene.h"
+#include "skeleton.h"
+#include "material.h"
+#include "texture.h"
+
+
+/**
+ * Region of serialized data, inside a mapped file or a decompressed
+ * buffer owned by the reader. Never copied, and only valid while the
+ * reader that returned it is open.
+*/
+typedef struct {
+    const awd_uint8 *data;
+    awd_uint32 length;
+} AWD_data_view;
+
+
+/**
+ * Block header, as found in the file. The offset is that of the block
+ * header, counted as if the file body were uncompressed (the same way
+ * offsets are counted in the TOC.)
+*/
+typedef struct {
+    awd_baddr addr;
+    awd_nsid ns;
+    AWD_block_type type;
+    awd_uint8 flags;
+    awd_uint64 offset;
+    AWD_data_view stored;
+} AWD_block_view;
+
+
+typedef struct {
+    awd_uint8 type;
+    AWD_field_type data_type;
+    AWD_data_view data;
+} AWD_stream_view;
+
+
+// Numeric properties are identified by key, while user attributes
+// have a namespace, a name and a data type.
+typedef struct {
+    awd_propkey key;
+    awd_nsid ns;
+    const char *name;
+    awd_uint16 name_len;
+    AWD_field_type type;
+    AWD_data_view value;
+} AWD_attr_view;
+
+
+typedef struct {
+    AWD_data_view properties;
+    AWD_data_view streams;
+    AWD_data_view user_attributes;
+} AWD_sub_view;
+
+
+/**
+ * Typed view of an array of elements in serialized data. Elements are
+ * not necessarily aligned in the file, and are converted from file
+ * byte order one at a time as they are accessed.
+*/
+template <typename T>
+class AWDArrayView
+{
+    private:
+        const awd_uint8 *data;
+        awd_uint32 num_elements;
+
+    public:
+        AWDArrayView(AWD_data_view view)
+        {
+            this->data = view.data;
+            this->num_elements = view.length / sizeof(T);
+        }
+
+        awd_uint32 get_num_elements() { return this->num_elements; }
+
+        inline T get(awd_uint32 idx)
+        {
+            T v;
+
+            memcpy(&v, this->data + idx * sizeof(T), sizeof(T));
+            return awd_bo(v);
+        }
+};
+
+
+// Name of a block, for block types that have one (NULL otherwise),
+// pointing into the (uncompressed) body.
+const char *    awdreader_get_block_name(AWD_block_type, AWD_data_view, awd_uint16 *);
+
+
+/**
+ * Iterates over an attribute list (numeric properties or user
+ * attributes) as written by the attribute lists' write_attributes().
+*/
+class AWDAttrIterator
+{
+    private:
+        AWDCursor cur;
+        bool user;
+
+    public:
+        AWDAttrIterator(AWD_data_view, bool);
+
+        bool next(AWD_attr_view *);
+        bool has_error();
+};
+
+
+/**
+ * Iterates over the data streams of a sub-mesh.
+*/
+class AWDStreamIterator
+{
+    private:
+        AWDCursor cur;
+
+    public:
+        AWDStreamIterator(AWD_data_view);
+
+        bool next(AWD_stream_view *);
+        bool has_error();
+};
+
+
+/**
+ * View of a TRI_GEOM block body, with its sub-meshes located but none
+ * of their data copied.
+*/
+class AWDGeomView
+{
+    private:
+        const char *name;
+        awd_uint16 name_len;
+        awd_uint16 num_subs;
+        AWD_sub_view *subs;
+        AWD_data_view properties;
+        AWD_data_view user_attributes;
+
+    public:
+        AWDGeomView();
+        ~AWDGeomView();
+
+        bool parse(AWD_data_view);
+
+        const char *get_name(awd_uint16 *);
+        awd_uint16 get_num_subs();
+        AWD_sub_view *get_sub_at(awd_uint16);
+        AWD_data_view get_properties();
+        AWD_data_view get_user_attributes();
+};
+
+
+/**
+ * Reader for AWD files. The file is memory-mapped, and blocks are
+ * located by walking the block headers, without copying any data. A
+ * body that is compressed as a whole is decompressed once into a single
+ * buffer when the file is opened, while blocks that are compressed on
+ * their own are only decompressed when their body is first requested.
+ *
+ * Blocks can also be materialized as regular libawd objects (e.g.
+ * AWDTriGeom or AWDMaterial), which is done the first time the object
+ * of a block is requested. Blocks referenced by address (e.g. the
+ * geometry of a mesh instance) are materialized along with the block
+ * referencing them, so only the requested part of the file is decoded.
+ * Objects are owned by the reader, and may refer to data in the file,
+ * so they are only valid for as long as the reader is open.
+ *
+ * Blocks can be looked up by name. In files written with a name index
+ * only the blocks whose name hashes the same are parsed, otherwise every
+ * block body is parsed until a match is found.
+*/
+class AWDReader
+{
+    private:
+        const awd_uint8 *file_data;
+        size_t file_len;
+        bool mapped;
+
+        // File header fields
+        awd_uint8 major_version;
+        awd_uint8 minor_version;
+        awd_uint16 flags;
+        AWD_compression compression;
+
+        AWDMemorySink *arena;
+        const awd_uint8 *body;
+        size_t body_len;
+
+        AWD_block_view *blocks;
+        AWD_data_view *bodies;
+        AWDBlock **objects;
+        bool *materializing;
+        int num_blocks;
+        int max_blocks;
+        int *addr_index;
+        awd_baddr max_addr;
+        int name_index;
+        int num_threads;
+
+        bool parse_header();
+        bool index_blocks();
+        void index_addresses();
+        bool match_name(int, const char *, awd_uint16, AWD_block_type);
+        void unmap();
+
+        AWDBlock *materialize(AWD_block_view *, AWD_data_view);
+        AWDTriGeom *materialize_geom(AWD_data_view);
+        AWDSkeleton *materialize_skeleton(AWD_data_view);
+        AWDMaterial *materialize_material(AWD_data_view);
+        AWDBitmapTexture *materialize_texture(AWD_data_view);
+        AWDSceneBlock *materialize_scene_block(AWD_block_type, AWD_data_view);
+
+    public:
+        AWDReader();
+        ~AWDReader();
+
+        bool open_file(const char *);
+        bool open_buffer(const void *, size_t);
+        void release();
+
+        int get_num_threads();
+        void set_num_threads(int);
+
+        awd_uint8 get_major_version();
+        awd_uint8 get_minor_version();
+        awd_uint16 get_flags();
+        bool has_flag(int);
+        AWD_compression get_compression();
+        size_t get_body_length();
+
+        int get_num_blocks();
+        AWD_block_view *get_block_at(int);
+        int find_block(awd_baddr);
+        int find_block_by_name(const char *, awd_uint16, AWD_block_type);
+        bool get_body(int, AWD_data_view *);
+
+        AWDBlock *get_object_at(int);
+        AWDBlock *find_object(awd_baddr);
+};
+
+#endif
@@ -18,7 +18,7 @@ class AWDSceneBlock :
         AWDBlockList *children;
 
     protected:
-        void write_scene_common(int, bool);
+        void write_scene_common(AWDOutputStream *, bool);
         awd_uint32 calc_common_length(bool);
 
     public:
@@ -42,7 +42,7 @@ class AWDScene :
 {
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDScene(const char *, awd_uint16);
@@ -55,7 +55,7 @@ class AWDContainer :
 {
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDContainer(const char *, awd_uint16);
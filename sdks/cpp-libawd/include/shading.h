@@ -58,7 +58,7 @@ class AWDShadingMethod :
 
     public:
         awd_uint32 calc_method_length(bool);
-        void write_method(int, bool);
+        void write_method(AWDOutputStream *, bool);
 };
 
 
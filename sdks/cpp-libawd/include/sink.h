@@ -0,0 +1,79 @@
+#ifndef _LIBAWD_SINK_H
+#define _LIBAWD_SINK_H
+
+#include <stdlib.h>
+
+#include "awd_types.h"
+
+
+#define AWD_MEMSINK_INITIAL_SIZE 0x10000
+
+
+/**
+ * Output sink. Anything that serialized AWD data can be written to,
+ * e.g. a growable memory buffer or a file descriptor.
+*/
+class AWDSink
+{
+    public:
+        virtual ~AWDSink();
+
+        virtual void write_bytes(const void *, size_t)=0;
+        virtual void finish();
+        virtual bool has_error();
+};
+
+
+/**
+ * Sink that accumulates all written data in a growable memory buffer.
+*/
+class AWDMemorySink :
+    public AWDSink
+{
+    private:
+        awd_uint8 *buf;
+        size_t buf_len;
+        size_t buf_size;
+
+        void grow(size_t);
+
+    public:
+        AWDMemorySink();
+        AWDMemorySink(size_t);
+        ~AWDMemorySink();
+
+        void write_bytes(const void *, size_t);
+
+        // Direct access to free space at the end of the buffer, for
+        // producers (e.g. decompressors) that write in place
+        awd_uint8 *reserve(size_t);
+        void advance(size_t);
+
+        awd_uint8 *get_buffer();
+        size_t get_length();
+        awd_uint8 *detach_buffer(size_t *);
+        void discard(size_t);
+        void reset();
+};
+
+
+/**
+ * Sink that writes straight through to a file descriptor. The
+ * descriptor is owned by the caller and never closed by the sink.
+*/
+class AWDFileSink :
+    public AWDSink
+{
+    private:
+        int fd;
+        bool error;
+
+    public:
+        AWDFileSink(int);
+
+        void write_bytes(const void *, size_t);
+
+        bool has_error();
+};
+
+#endif
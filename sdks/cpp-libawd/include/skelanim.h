@@ -22,7 +22,7 @@ class AWDSkeletonPose : public AWDNamedElement,
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDSkeletonPose(const char *, awd_uint16);
@@ -51,7 +51,7 @@ class AWDSkeletonAnimation : public AWDNamedElement,
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDSkeletonAnimation(const char *, awd_uint16);
@@ -25,7 +25,7 @@ class AWDSkeletonJoint :
         AWDSkeletonJoint(const char *, awd_uint16, awd_float64 *);
         ~AWDSkeletonJoint();
 
-        int write_joint(int, awd_uint32, bool);
+        int write_joint(AWDOutputStream *, awd_uint32, bool);
         int calc_length(bool);
         int calc_num_children();
 
@@ -50,7 +50,7 @@ class AWDSkeleton :
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDSkeleton(const char *, awd_uint16);
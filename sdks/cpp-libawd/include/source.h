@@ -0,0 +1,44 @@
+#ifndef _LIBAWD_SOURCE_H
+#define _LIBAWD_SOURCE_H
+
+#include <stdlib.h>
+
+#include "awd_types.h"
+
+
+/**
+ * Input source, from which serialized AWD data is pulled a little at a
+ * time, e.g. a pipe or a socket. The counterpart of AWDSink.
+*/
+class AWDSource
+{
+    public:
+        virtual ~AWDSource();
+
+        // Reads up to the requested number of bytes, blocking until at
+        // least one is available. Returns zero at end of input.
+        virtual size_t read_bytes(void *, size_t)=0;
+        virtual bool has_error();
+};
+
+
+/**
+ * Source that reads from a file descriptor, e.g. stdin. The descriptor
+ * is owned by the caller and never closed by the source.
+*/
+class AWDFileSource :
+    public AWDSource
+{
+    private:
+        int fd;
+        bool error;
+
+    public:
+        AWDFileSource(int);
+
+        size_t read_bytes(void *, size_t);
+
+        bool has_error();
+};
+
+#endif
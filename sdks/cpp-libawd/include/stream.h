@@ -2,23 +2,52 @@
 #define _LIBAWD_STREAM_H
 
 #include "awd_types.h"
+#include "outstream.h"
+#include "field.h"
 
 /** 
  * Data stream pointer
 */
 typedef union {
     void *v;
+    awd_int8 *i8;
+    awd_int16 *i16;
     awd_int32 *i32;
+    awd_uint8 *ui8;
+    awd_uint16 *ui16;
     awd_uint32 *ui32;
+    awd_float32 *f32;
     awd_float64 *f64;
 } AWD_str_ptr;
 
 
+/**
+ * Called when a stream that doesn't own its data is deleted, with the
+ * stream data and the argument that was given with the function.
+*/
+typedef void (*awd_release_func)(void *, void *);
+
+
 
+/**
+ * Stream of numeric data. Unless a subclass says otherwise, elements
+ * are kept in memory as 32-bit integers or doubles (see
+ * get_storage_type()) and converted to data_type when written.
+ *
+ * The data is freed along with the stream, unless a release function
+ * has been set, in which case the data is owned by the caller and only
+ * read from when the stream is written. This way arrays owned by
+ * someone else (e.g. a mapped file or an array in a scripting
+ * language) can be written without being copied.
+*/
 class AWDDataStream
 {
-    private:
+    protected:
         awd_uint32 num_elements;
+        bool own_data;
+        awd_release_func release_func;
+        void *release_arg;
+        awd_array_encoder encoder;
 
     public:
         awd_uint8 type;
@@ -28,11 +57,13 @@ class AWDDataStream
         AWDDataStream * next;
         
         AWDDataStream(awd_uint8, AWD_field_type, AWD_str_ptr, awd_uint32);
-        ~AWDDataStream();
+        virtual ~AWDDataStream();
 
         awd_uint32 get_num_elements();
         awd_uint32 get_length();
-        void write_stream(int);
+        virtual AWD_field_type get_storage_type();
+        void set_release_func(awd_release_func, void *);
+        void write_stream(AWDOutputStream *);
 };
 
 
@@ -52,4 +83,55 @@ class AWDPathDataStream : public AWDDataStream
 
 
 
+// Field type of each element type that typed streams can hold
+template <typename T> struct AWDFieldTraits;
+template <> struct AWDFieldTraits<awd_int8>     { static AWD_field_type type() { return AWD_FIELD_INT8; } };
+template <> struct AWDFieldTraits<awd_int16>    { static AWD_field_type type() { return AWD_FIELD_INT16; } };
+template <> struct AWDFieldTraits<awd_int32>    { static AWD_field_type type() { return AWD_FIELD_INT32; } };
+template <> struct AWDFieldTraits<awd_uint8>    { static AWD_field_type type() { return AWD_FIELD_UINT8; } };
+template <> struct AWDFieldTraits<awd_uint16>   { static AWD_field_type type() { return AWD_FIELD_UINT16; } };
+template <> struct AWDFieldTraits<awd_uint32>   { static AWD_field_type type() { return AWD_FIELD_UINT32; } };
+template <> struct AWDFieldTraits<awd_float32>  { static AWD_field_type type() { return AWD_FIELD_FLOAT32; } };
+template <> struct AWDFieldTraits<awd_float64>  { static AWD_field_type type() { return AWD_FIELD_FLOAT64; } };
+
+
+/**
+ * Stream that keeps its elements in memory in the same type as they
+ * are written to file (e.g. float32 vertices or uint16 indices), which
+ * takes half the memory of the default storage for narrow streams and
+ * needs no conversion when written. Takes ownership of the data, which
+ * must have been allocated with malloc(), unless it is given along with
+ * a release function (see AWDDataStream.)
+*/
+template <typename T>
+class AWDTypedStream : public AWDDataStream
+{
+    private:
+        static AWD_str_ptr to_str_ptr(T *data)
+        {
+            AWD_str_ptr ptr;
+
+            ptr.v = data;
+            return ptr;
+        }
+
+    public:
+        AWDTypedStream(awd_uint8 type, T *data, awd_uint32 num_elements) :
+            AWDDataStream(type, AWDFieldTraits<T>::type(), to_str_ptr(data), num_elements)
+        {}
+
+        AWDTypedStream(awd_uint8 type, const T *data, awd_uint32 num_elements,
+                awd_release_func release_func, void *release_arg) :
+            AWDDataStream(type, AWDFieldTraits<T>::type(), to_str_ptr((T *)data), num_elements)
+        {
+            this->set_release_func(release_func, release_arg);
+        }
+
+        T *get_data() { return (T *)this->data.v; }
+
+        AWD_field_type get_storage_type() { return this->data_type; }
+};
+
+
+
 #endif
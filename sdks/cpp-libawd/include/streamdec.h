@@ -0,0 +1,116 @@
+#ifndef _LIBAWD_STREAMDEC_H
+#define _LIBAWD_STREAMDEC_H
+
+#include <zlib.h>
+#ifdef AWD_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AWD_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "awd_types.h"
+#include "sink.h"
+#include "source.h"
+#include "reader.h"
+
+
+// Size of the buffer that stored (compressed) body data is read into
+#define AWD_STREAMDEC_INPUT_SIZE 0x10000
+
+
+/**
+ * Called for each block as soon as it has been decoded, with a view of
+ * its header and of its (uncompressed) body. Both are only valid during
+ * the call. Decoding stops if the callback returns false.
+*/
+typedef bool (*awd_block_func)(AWD_block_view *, AWD_data_view, void *);
+
+
+/**
+ * Decoder that pulls an AWD file from a source a little at a time, and
+ * decompresses the body incrementally, so that every block is passed to
+ * a callback as soon as all of its bytes are available. Unlike the
+ * AWDReader, it never needs the whole file in memory, and works with
+ * sources that can't be mapped or seeked in (e.g. a pipe on stdin.)
+ *
+ * Only the stored data not consumed by the decompressor yet, and the
+ * data of the block currently being received, is kept in memory.
+*/
+class AWDStreamDecoder
+{
+    private:
+        AWDSource *source;
+        int num_threads;
+
+        // File header fields
+        awd_uint8 major_version;
+        awd_uint8 minor_version;
+        awd_uint16 flags;
+        AWD_compression compression;
+        awd_uint32 body_len;
+
+        // Stored body data that has been read from the source, but
+        // not yet consumed by the decompressor
+        awd_uint8 *in_buf;
+        size_t in_pos;
+        size_t in_len;
+        size_t num_read;
+        bool eof;
+
+        // Uncompressed body data, of which everything before out_pos
+        // has already been passed on as blocks.
+        AWDMemorySink *out;
+        size_t out_pos;
+        awd_uint64 out_offset;
+        bool body_done;
+
+        // Scratch buffer for block bodies compressed on their own
+        AWDMemorySink *block_body;
+
+        // Decompressor state
+        z_stream zstrm;
+        bool zstrm_init;
+        void *lzma;
+        awd_uint32 lzma_out_left;
+        size_t lzma_in_left;
+#ifdef AWD_WITH_ZSTD
+        ZSTD_DCtx *zstd;
+#endif
+#ifdef AWD_WITH_LZ4
+        LZ4F_dctx *lz4;
+#endif
+
+        bool fill_input(size_t);
+        bool read_header();
+        bool init_decompressor();
+        void end_decompressor();
+        bool decode_more();
+        bool decode_inflate();
+        bool decode_lzma();
+        bool begin_lzma();
+#ifdef AWD_WITH_ZSTD
+        bool decode_zstd();
+#endif
+#ifdef AWD_WITH_LZ4
+        bool decode_lz4();
+#endif
+        int emit_blocks(awd_block_func, void *);
+
+    public:
+        AWDStreamDecoder(AWDSource *);
+        ~AWDStreamDecoder();
+
+        int get_num_threads();
+        void set_num_threads(int);
+
+        awd_uint8 get_major_version();
+        awd_uint8 get_minor_version();
+        awd_uint16 get_flags();
+        bool has_flag(int);
+        AWD_compression get_compression();
+
+        bool decode(awd_block_func, void *);
+};
+
+#endif
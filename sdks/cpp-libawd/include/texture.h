@@ -27,7 +27,7 @@ class AWDBitmapTexture :
     protected:
         awd_uint32 calc_body_length(bool);
         void prepare_write();
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDBitmapTexture(AWD_tex_type, const char *, awd_uint16);
@@ -59,12 +59,12 @@ class AWDCubeTexture :
     private:
         AWDBlock **sides; // Array of textures
 
-        void write_dir_tex(int, AWD_cube_dir);
+        void write_dir_tex(AWDOutputStream *, AWD_cube_dir);
 
     protected:
         awd_uint32 calc_body_length(bool);
         void prepare_write();
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDCubeTexture(const char *, awd_uint16);
@@ -0,0 +1,17 @@
+#ifndef _LIBAWD_THREAD_H
+#define _LIBAWD_THREAD_H
+
+
+// Job function, invoked once for every job argument
+typedef void (*awd_job_func)(void *);
+
+
+int         awdthread_num_cpus();
+int         awdthread_resolve_count(int);
+
+// Run func(jobs[i]) for every job, spreading the jobs over at most
+// the specified number of threads. Jobs are started in order, each on
+// the first thread to become idle. Returns when all jobs are done.
+void        awdthread_run_jobs(awd_job_func, void **, int, int);
+
+#endif
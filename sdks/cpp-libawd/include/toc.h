@@ -0,0 +1,54 @@
+#ifndef _LIBAWD_TOC_H
+#define _LIBAWD_TOC_H
+
+#include "block.h"
+#include "awd_types.h"
+
+
+// The footer follows the body, and is not included in the body length.
+// It holds the file offset of the TOC block header, and a magic string.
+#define AWD_TOC_FOOTER_LENGTH       12
+#define AWD_TOC_MAGIC               "AWDT"
+
+// Address, type, flags, name hash, file offset, stored and uncompressed length
+#define AWD_TOC_ENTRY_LENGTH        30
+
+
+typedef struct {
+    awd_baddr addr;
+    awd_uint8 type;
+    awd_uint8 flags;
+    awd_uint64 name_hash;
+    awd_uint64 offset;
+    awd_uint32 stored_length;
+    awd_uint32 length;
+} AWD_toc_entry;
+
+
+/**
+ * Table of contents, listing where in the file every block is found so
+ * that readers can seek straight to a block (e.g. by the hash of its
+ * name) instead of scanning all block headers. Offsets are only
+ * meaningful when the file body is not compressed as a whole.
+*/
+class AWDTocBlock :
+    public AWDBlock
+{
+    private:
+        AWD_toc_entry *entries;
+        awd_uint32 num_entries;
+        awd_uint32 max_entries;
+
+    protected:
+        awd_uint32 calc_body_length(bool);
+        void write_body(AWDOutputStream *, bool);
+
+    public:
+        AWDTocBlock();
+        ~AWDTocBlock();
+
+        void add_entry(AWDBlock *, awd_uint64, AWD_block_info *);
+        awd_uint32 get_num_entries();
+};
+
+#endif
@@ -3,13 +3,7 @@
 
 #include "awd.h"
 #include "awd_types.h"
-
-#ifdef WIN32
-#define TMPPATH_MAXLEN 256
-#define TMPFILE_TEMPLATE "awd.XXXXXX"
-#else
-#define TMPFILE_TEMPLATE "/tmp/awd.XXXXXX"
-#endif
+#include "outstream.h"
 
 // Macros to calculate matrix size depending on width (optimized for size or accuracy)
 #define VEC2_SIZE(wide) (wide? (2*sizeof(awd_float64)):(2*sizeof(awd_float32)))
@@ -23,19 +17,18 @@
 
 // Utility functions
 awd_float64 *   awdutil_id_mtx4x4(awd_float64 *);
-int             awdutil_mktmp(char **path);
 
 size_t          awdutil_get_type_size(AWD_field_type, bool);
 
-awd_uint32      awdutil_write_floats(int, awd_float64 *, int, bool);
-awd_uint32      awdutil_write_varstr(int, const char *, awd_uint16);
-
 awd_color       awdutil_float_color(double, double, double, double);
 awd_color       awdutil_int_color(int, int, int, int);
 
 awd_uint16      awdutil_swapui16(awd_uint16);
 awd_uint32      awdutil_swapui32(awd_uint32);
+awd_uint64      awdutil_swapui64(awd_uint64);
 awd_float32     awdutil_swapf32(awd_float32);
 awd_float64     awdutil_swapf64(awd_float64);
 
+awd_uint64      awdutil_hash_name(const char *, awd_uint16);
+
 #endif
@@ -26,7 +26,7 @@ class AWDUVAnimation :
 
     protected:
         awd_uint32 calc_body_length(bool);
-        void write_body(int, bool);
+        void write_body(AWDOutputStream *, bool);
 
     public:
         AWDUVAnimation(const char *, awd_uint16);
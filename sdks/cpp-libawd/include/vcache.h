@@ -0,0 +1,31 @@
+#ifndef _LIBAWD_VCACHE_H
+#define _LIBAWD_VCACHE_H
+
+#include "awd_types.h"
+
+
+// Default size of the post-transform vertex cache that is modelled
+#define AWD_VCACHE_SIZE 32
+
+
+/**
+ * Post-transform cache efficiency of a triangle list, as simulated for
+ * a FIFO cache of a given size. ACMR is the average number of cache
+ * misses (i.e. vertex shader invocations) per triangle, ranging from
+ * 0.5 at best for large regular meshes to 3. ATVR is the average number
+ * of misses per referenced vertex, of which 1.0 is optimal.
+*/
+typedef struct {
+    double acmr;
+    double atvr;
+} AWD_vcache_stats;
+
+
+void            awdvcache_measure(const awd_uint32 *, awd_uint32, awd_uint32, int, AWD_vcache_stats *);
+
+// Reorder the triangles of a triangle list in place, for better use of
+// a vertex cache of the specified size, using Tom Forsyth's "Linear-
+// Speed Vertex Cache Optimisation". The vertex order is not affected.
+void            awdvcache_optimize(awd_uint32 *, awd_uint32, awd_uint32, int);
+
+#endif
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include "arena.h"
+
+#include "platform.h"
+
+
+// Header rounded up so that chunk data stays aligned
+#define AWD_ARENA_HEADER_SIZE \
+    ((sizeof(awd_arena_chunk) + AWD_ARENA_ALIGN - 1) & ~(size_t)(AWD_ARENA_ALIGN - 1))
+
+#define AWD_ARENA_CHUNK_DATA(c) ((char *)(c) + AWD_ARENA_HEADER_SIZE)
+
+
+AWDArena::AWDArena()
+{
+    this->chunks = NULL;
+    this->next_size = AWD_ARENA_CHUNK_SIZE;
+}
+
+
+AWDArena::~AWDArena()
+{
+    awd_arena_chunk *cur;
+
+    cur = this->chunks;
+    while (cur) {
+        awd_arena_chunk *next = cur->next;
+        free(cur);
+        cur = next;
+    }
+
+    this->chunks = NULL;
+}
+
+
+awd_arena_chunk *
+AWDArena::add_chunk(size_t min_size)
+{
+    awd_arena_chunk *chunk;
+    size_t size;
+
+    size = this->next_size;
+    if (size < min_size)
+        size = min_size;
+
+    chunk = (awd_arena_chunk *)malloc(AWD_ARENA_HEADER_SIZE + size);
+    if (!chunk)
+        return NULL;
+
+    chunk->size = size;
+    chunk->used = 0;
+
+    // Newest chunk first, since that is the one allocated from
+    chunk->next = this->chunks;
+    this->chunks = chunk;
+
+    if (this->next_size < AWD_ARENA_MAX_CHUNK_SIZE)
+        this->next_size *= 2;
+
+    return chunk;
+}
+
+
+void *
+AWDArena::alloc(size_t size)
+{
+    awd_arena_chunk *chunk;
+    void *ptr;
+
+    size = (size + AWD_ARENA_ALIGN - 1) & ~(size_t)(AWD_ARENA_ALIGN - 1);
+
+    chunk = this->chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = this->add_chunk(size);
+        if (!chunk)
+            return NULL;
+    }
+
+    ptr = AWD_ARENA_CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
+
+
+bool
+AWDArena::owns(const void *ptr)
+{
+    awd_arena_chunk *cur;
+
+    // Recent allocations are found quickest, since the
+    // newest chunk is at the head of the list.
+    cur = this->chunks;
+    while (cur) {
+        const char *data = AWD_ARENA_CHUNK_DATA(cur);
+        if ((const char *)ptr >= data && (const char *)ptr < data + cur->used)
+            return true;
+
+        cur = cur->next;
+    }
+
+    return false;
+}
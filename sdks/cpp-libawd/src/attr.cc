@@ -11,81 +11,18 @@
 
 
 void
-AWDAttr::write_attr(int fd, bool wide_mtx)
-{
-    AWD_field_ptr val;
-    awd_uint32 bytes_written;
-    awd_int16 i16_be;
-    awd_int32 i32_be;
-    awd_float32 f32_be;
-    awd_float64 f64_be;
-
-    this->write_metadata(fd);
-
-    bytes_written = 0;
-    val.v = this->value.v;
-
-    while (bytes_written < this->value_len) {
-        // Check type, and write data accordingly
-        switch (this->type) {
-            case AWD_FIELD_INT16:
-            case AWD_FIELD_UINT16:
-                i16_be = UI16(*val.i16);
-                write(fd, &i16_be, sizeof(awd_int16));
-                bytes_written += sizeof(awd_int16);
-                val.i16++;
-                break;
-
-            case AWD_FIELD_INT32:
-            case AWD_FIELD_UINT32:
-            case AWD_FIELD_BADDR:
-            case AWD_FIELD_COLOR:
-                i32_be = UI32(*val.i32);
-                write(fd, &i32_be, sizeof(awd_int32));
-                bytes_written += sizeof(awd_int32);
-                val.i32++;
-                break;
-
-            case AWD_FIELD_FLOAT32:
-                f32_be = F32(*val.f32);
-                write(fd, &f32_be, sizeof(awd_float32));
-                bytes_written += sizeof(awd_float32);
-                val.f32++;
-                break;
-
-            case AWD_FIELD_FLOAT64:
-                f64_be = F64(*val.f64);
-                write(fd, &f64_be, sizeof(awd_float64));
-                bytes_written += sizeof(awd_float64);
-                val.f64++;
-                break;
-
-            case AWD_FIELD_STRING:
-                // Write entire string in one go
-                write(fd, val.str, this->value_len);
-                bytes_written += this->value_len;
-                break;
-
-            case AWD_FIELD_BOOL:
-                write(fd, val.b, this->value_len);
-                bytes_written += this->value_len;
-                break;
-
-            case AWD_FIELD_VECTOR2x1:
-            case AWD_FIELD_VECTOR3x1:
-            case AWD_FIELD_VECTOR4x1:
-            case AWD_FIELD_MTX3x2:
-            case AWD_FIELD_MTX3x3:
-            case AWD_FIELD_MTX4x3:
-            case AWD_FIELD_MTX4x4:
-                bytes_written += awdutil_write_floats(fd, val.f64, this->value_len, wide_mtx);
-                break;
-
-            default:
-                printf("unknown type: %d\n", this->type);
-                return;
-        }
+AWDAttr::write_attr(AWDOutputStream *out, bool wide_mtx)
+{
+    this->write_metadata(out);
+
+    // Values are arrays of value_len bytes, written in a single
+    // pass by the encoder of the value type.
+    if (this->encoder == NULL) {
+        printf("unknown type: %d\n", this->type);
+        return;
     }
+
+    this->encoder(out, this->value.v, this->value_len, wide_mtx);
 }
 
 
@@ -96,6 +33,7 @@ AWDAttr::set_val(AWD_field_ptr val, awd_uint32 val_len, AWD_field_type val_type)
     this->value = val;
     this->value_len = val_len;
     this->type = val_type;
+    this->encoder = awdutil_get_value_encoder(val_type);
 }
 
 
@@ -154,20 +92,12 @@ AWDUserAttr::get_key_len()
 
 
 void
-AWDUserAttr::write_metadata(int fd)
+AWDUserAttr::write_metadata(AWDOutputStream *out)
 {
-    awd_uint8 type;
-    awd_uint32 len_be;
-    awd_nsid ns_handle;
-
-    len_be = UI32(this->value_len);
-    type = (awd_uint8)this->type;
-    ns_handle = this->ns->get_handle();
-
-    write(fd, &ns_handle, sizeof(awd_uint8));
-    awdutil_write_varstr(fd, this->key, this->key_len);
-    write(fd, &type, sizeof(awd_uint8));
-    write(fd, &len_be, sizeof(awd_uint32));
+    out->put_ui8(this->ns->get_handle());
+    out->put_varstr(this->key, this->key_len);
+    out->put_ui8((awd_uint8)this->type);
+    out->put_ui32(this->value_len);
 }
 
 
@@ -219,17 +149,15 @@ AWDUserAttrList::calc_length(bool wide_mtx)
 
 
 void
-AWDUserAttrList::write_attributes(int fd, bool wide_mtx)
+AWDUserAttrList::write_attributes(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint32 len_be;
     AWDUserAttr *cur;
 
-    len_be = UI32(this->calc_length(wide_mtx) - sizeof(awd_uint32));
-    write(fd, &len_be, sizeof(awd_uint32));
+    out->put_ui32(this->calc_length(wide_mtx) - sizeof(awd_uint32));
 
     cur = this->first_attr;
     while (cur) {
-        cur->write_attr(fd, wide_mtx);
+        cur->write_attr(out, wide_mtx);
         cur = cur->next;
     }
 }
@@ -333,16 +261,10 @@ AWDNumAttr::AWDNumAttr()
 
 
 void
-AWDNumAttr::write_metadata(int fd)
+AWDNumAttr::write_metadata(AWDOutputStream *out)
 {
-    awd_uint16 key_be;
-    awd_uint32 len_be;
-
-    key_be = UI16(this->key);
-    len_be = UI32(this->value_len);
-
-    write(fd, &key_be, sizeof(awd_uint16));
-    write(fd, &len_be, sizeof(awd_uint32));
+    out->put_ui16(this->key);
+    out->put_ui32(this->value_len);
 }
 
 
@@ -394,17 +316,15 @@ AWDNumAttrList::calc_length(bool wide_mtx)
 
 
 void
-AWDNumAttrList::write_attributes(int fd, bool wide_mtx)
+AWDNumAttrList::write_attributes(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint32 len_be;
     AWDNumAttr *cur;
 
-    len_be = UI32(this->calc_length(wide_mtx) - sizeof(awd_uint32));
-    write(fd, &len_be, sizeof(awd_uint32));
+    out->put_ui32(this->calc_length(wide_mtx) - sizeof(awd_uint32));
 
     cur = this->first_attr;
     while (cur) {
-        cur->write_attr(fd, wide_mtx);
+        cur->write_attr(out, wide_mtx);
         cur = cur->next;
     }
 }
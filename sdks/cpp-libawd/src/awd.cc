@@ -1,17 +1,41 @@
 #include <cstdio>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 
 #include "platform.h"
 
 #include "awd.h"
 #include "util.h"
-#include "awdlzma.h"
-#include "awdzlib.h"
+#include "sink.h"
+#include "compress.h"
+#include "thread.h"
 
-#include "Types.h"
-#include "LzmaEnc.h"
+
+// Serialization of a single block into its own buffer, done by
+// one of the worker threads when blocks are written in parallel
+typedef struct {
+    AWDBlock *block;
+    awd_baddr addr;
+    AWD_compression compression;
+    int level;
+    awd_uint32 threshold;
+    AWDMemorySink *sink;
+    AWD_block_info info;
+} awd_block_job;
+
+
+static void
+awd_serialize_block(void *arg)
+{
+    awd_block_job *job;
+
+    job = (awd_block_job *)arg;
+
+    AWDOutputStream out(job->sink, AWD_BLOCK_BUFSIZE);
+    job->block->write_block(&out, job->addr, job->compression,
+        job->level, job->threshold, &job->info);
+    out.flush();
+}
 
 
 const int AWD::VERSION_MAJOR = 2;
@@ -43,6 +67,24 @@ AWD::AWD(AWD_compression compression, awd_uint16 flags)
     this->last_used_nsid = 0;
     this->last_used_baddr = 0;
     this->header_written = AWD_FALSE;
+    this->stream_window = AWD_STREAM_WINDOW;
+    this->num_threads = 0;
+    this->parallel_deflate = false;
+    this->parallel_blocks = false;
+    this->compression_level = AWD_DEFAULT_LEVEL;
+    this->long_distance = false;
+    this->block_compression = UNCOMPRESSED;
+    this->block_threshold = AWD_BLOCK_COMPRESS_THRESHOLD;
+    this->toc = NULL;
+    this->name_index = NULL;
+    this->toc_offset = 0;
+
+    // Block offsets in the TOC refer to the uncompressed body, which
+    // readers can't seek in if the body is compressed as a whole.
+    if (this->has_flag(AWD_TOC) && compression != UNCOMPRESSED) {
+        printf("TOC requires an uncompressed body (use block compression), not writing TOC\n");
+        this->flags &= ~AWD_TOC;
+    }
 }
 
 
@@ -69,6 +111,119 @@ AWD::has_flag(int flag)
 }
 
 
+size_t
+AWD::get_stream_window()
+{
+    return this->stream_window;
+}
+
+
+void
+AWD::set_stream_window(size_t window)
+{
+    this->stream_window = window;
+}
+
+
+int
+AWD::get_num_threads()
+{
+    return this->num_threads;
+}
+
+
+void
+AWD::set_num_threads(int num_threads)
+{
+    // Zero means one thread per CPU
+    this->num_threads = num_threads;
+}
+
+
+bool
+AWD::get_parallel_deflate()
+{
+    return this->parallel_deflate;
+}
+
+
+void
+AWD::set_parallel_deflate(bool parallel)
+{
+    this->parallel_deflate = parallel;
+}
+
+
+bool
+AWD::get_parallel_blocks()
+{
+    return this->parallel_blocks;
+}
+
+
+void
+AWD::set_parallel_blocks(bool parallel)
+{
+    // Serialize blocks on multiple threads (see num_threads)
+    this->parallel_blocks = parallel;
+}
+
+
+int
+AWD::get_compression_level()
+{
+    return this->compression_level;
+}
+
+
+void
+AWD::set_compression_level(int level)
+{
+    // AWD_DEFAULT_LEVEL selects the default for each codec
+    this->compression_level = level;
+}
+
+
+bool
+AWD::get_long_distance_matching()
+{
+    return this->long_distance;
+}
+
+
+void
+AWD::set_long_distance_matching(bool enable)
+{
+    // Only used by Zstandard
+    this->long_distance = enable;
+}
+
+
+AWD_compression
+AWD::get_block_compression()
+{
+    return this->block_compression;
+}
+
+
+void
+AWD::set_block_compression(AWD_compression compression)
+{
+    this->set_block_compression(compression, AWD_BLOCK_COMPRESS_THRESHOLD);
+}
+
+
+void
+AWD::set_block_compression(AWD_compression compression, awd_uint32 threshold)
+{
+    // Compress the body of every block of at least threshold bytes
+    // independently. Combine with UNCOMPRESSED file compression for
+    // random access to individual blocks.
+    this->block_compression = compression;
+    this->block_threshold = threshold;
+}
+
+
 void
 AWD::set_metadata(AWDMetaData *block)
 {
@@ -171,24 +326,38 @@ AWD::get_namespace(const char *uri)
 
 
 void
-AWD::write_header(int fd, awd_uint32 body_length)
+AWD::write_header(AWDOutputStream *out, awd_uint32 body_length)
 {
-    awd_uint16 flags_be;
+    out->put_bytes("AWD", 3);
+    out->put_ui8(this->major_version);
+    out->put_ui8(this->minor_version);
+    out->put_ui16(this->flags);
+    out->put_ui8((awd_uint8)this->compression);
+    out->put_ui32(body_length);
+}
 
-    // Convert to big-endian if necessary
-    flags_be = UI16(this->flags);
-    body_length = UI32(body_length);
+size_t
+AWD::write_single_block(AWDBlock *block, AWDOutputStream *out)
+{
+    size_t len;
+    awd_uint64 offset;
+    AWD_block_info info;
+
+    offset = AWD_HEADER_LENGTH + out->get_position();
+    len = block->write_block(out, ++this->last_used_baddr,
+        this->block_compression, this->compression_level, this->block_threshold, &info);
 
-    write(fd, "AWD", 3);
-    write(fd, &this->major_version, sizeof(awd_uint8));
-    write(fd, &this->minor_version, sizeof(awd_uint8));
-    write(fd, &flags_be, sizeof(awd_uint16));
-    write(fd, (awd_uint8*)&this->compression, sizeof(awd_uint8));
-    write(fd, &body_length, sizeof(awd_uint32));
+    if (this->toc)
+        this->toc->add_entry(block, offset, &info);
+    if (this->name_index)
+        this->name_index->add_entry(block, offset);
+
+    return len;
 }
 
+
 size_t
-AWD::write_blocks(AWDBlockList *blocks, int fd)
+AWD::write_blocks(AWDBlockList *blocks, AWDOutputStream *out)
 {
     size_t len;
     AWDBlock *block;
@@ -196,7 +365,7 @@ AWD::write_blocks(AWDBlockList *blocks, int fd)
 
     len = 0;
     while ((block = it.next()) != NULL) {
-        len += block->write_block(fd, ++this->last_used_baddr);
+        len += this->write_single_block(block, out);
     }
 
     return len;
@@ -218,169 +387,326 @@ AWD::flatten_scene(AWDSceneBlock *cur, AWDBlockList *flat_list)
 }
 
 size_t
-AWD::write_scene(AWDBlockList *blocks, int fd)
+AWD::write_scene(AWDBlockList *blocks, AWDOutputStream *out)
 {
+    size_t len;
     AWDBlock *block;
     AWDBlockList *ordered;
     AWDBlockIterator it(blocks);
 
-    ordered = new AWDBlockList();
+    ordered = new AWDBlockList(false);
 
     while ((block = it.next()) != NULL) {
         this->flatten_scene((AWDSceneBlock*)block, ordered);
     }
 
-    return this->write_blocks(ordered, fd);
+    len = this->write_blocks(ordered, out);
+    delete ordered;
+
+    return len;
 }
 
 
-awd_uint32
-AWD::flush(int out_fd)
+void
+AWD::collect_blocks(AWDBlockList *blocks, AWDBlockList *all)
 {
-    int tmp_fd;
-    char *tmp_path;
+    AWDBlock *block;
+    AWDBlockIterator it(blocks);
 
-    off_t tmp_len;
-    awd_uint8 *tmp_buf;
+    while ((block = it.next()) != NULL) {
+        all->force_append(block);
+    }
+}
 
-    awd_uint8 *body_buf;
-    awd_uint32 body_len;
 
-    tmp_len = 0;
-    tmp_fd = awdutil_mktmp(&tmp_path);
-    if (tmp_fd < 0) {
-        extern int errno;
-        printf("Could not open temporary file necessary for writing, errno=%d\n", errno);
-        return AWD_FALSE;
+void
+AWD::write_blocks_parallel(AWDOutputStream *out)
+{
+    int i;
+    int first;
+    int num_blocks;
+    int num_threads;
+    int batch_size;
+    AWDBlock *block;
+    AWDBlockList *all;
+    AWDBlockList *scene;
+    awd_block_job *jobs;
+    void **job_ptrs;
+
+    // Collect blocks in the same order as they are written sequentially
+    all = new AWDBlockList(false);
+    if (this->metadata)
+        all->force_append(this->metadata);
+
+    this->collect_blocks(this->namespace_blocks, all);
+    this->collect_blocks(this->skeleton_blocks, all);
+    this->collect_blocks(this->skelpose_blocks, all);
+    this->collect_blocks(this->skelanim_blocks, all);
+    this->collect_blocks(this->texture_blocks, all);
+    this->collect_blocks(this->material_blocks, all);
+    this->collect_blocks(this->mesh_data_blocks, all);
+    this->collect_blocks(this->uvanim_blocks, all);
+
+    scene = new AWDBlockList(false);
+    AWDBlockIterator scene_it(this->scene_blocks);
+    while ((block = scene_it.next()) != NULL) {
+        this->flatten_scene((AWDSceneBlock*)block, scene);
+    }
+    this->collect_blocks(scene, all);
+    delete scene;
+
+    // Blocks refer to each other by address, so all addresses must
+    // be assigned before any block is serialized.
+    num_blocks = all->get_num_blocks();
+    jobs = (awd_block_job *)malloc(num_blocks * sizeof(awd_block_job));
+    job_ptrs = (void **)malloc(num_blocks * sizeof(void *));
+
+    AWDBlockIterator it(all);
+    for (i=0; i<num_blocks; i++) {
+        jobs[i].block = it.next();
+        jobs[i].addr = ++this->last_used_baddr;
+        jobs[i].compression = this->block_compression;
+        jobs[i].level = this->compression_level;
+        jobs[i].threshold = this->block_threshold;
+        jobs[i].sink = NULL;
+        jobs[i].block->set_addr(jobs[i].addr);
+        job_ptrs[i] = &jobs[i];
     }
 
-    if (this->metadata) {
-        tmp_len += this->metadata->write_block(tmp_fd, ++this->last_used_baddr);
+    // Serialize one batch of blocks at a time, so that only the blocks
+    // of the current batch are held in memory, and then write them out
+    // in address order.
+    num_threads = awdthread_resolve_count(this->num_threads);
+    batch_size = num_threads * AWD_BLOCK_BATCH_SIZE;
+    for (first=0; first<num_blocks; first+=batch_size) {
+        int num_batch;
+
+        num_batch = num_blocks - first;
+        if (num_batch > batch_size)
+            num_batch = batch_size;
+
+        for (i=first; i<first+num_batch; i++)
+            jobs[i].sink = new AWDMemorySink();
+
+        awdthread_run_jobs(awd_serialize_block, &job_ptrs[first], num_batch, num_threads);
+
+        for (i=first; i<first+num_batch; i++) {
+            awd_uint64 offset;
+
+            offset = AWD_HEADER_LENGTH + out->get_position();
+            out->put_bytes(jobs[i].sink->get_buffer(), jobs[i].sink->get_length());
+
+            if (this->toc)
+                this->toc->add_entry(jobs[i].block, offset, &jobs[i].info);
+            if (this->name_index)
+                this->name_index->add_entry(jobs[i].block, offset);
+
+            delete jobs[i].sink;
+            jobs[i].sink = NULL;
+        }
     }
 
-    tmp_len += this->write_blocks(this->namespace_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->skeleton_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->skelpose_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->skelanim_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->texture_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->material_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->mesh_data_blocks, tmp_fd);
-    tmp_len += this->write_blocks(this->uvanim_blocks, tmp_fd);
-    tmp_len += this->write_scene(this->scene_blocks, tmp_fd);
-
-    tmp_buf = (awd_uint8 *) malloc(tmp_len);
-	lseek(tmp_fd, 0, SEEK_SET);
-    read(tmp_fd, tmp_buf, tmp_len);
-
-    // Temp file no longer needed
-    close(tmp_fd);
-    unlink((const char *)tmp_path);
-
-
-    if (this->compression == UNCOMPRESSED) {
-        // Uncompressed, so output should be the exact
-        // same data that was in the temporary file
-        body_len = tmp_len;
-        body_buf = tmp_buf;
+    free(job_ptrs);
+    free(jobs);
+    delete all;
+}
+
+
+AWDSink *
+AWD::create_compressor(AWDSink *next)
+{
+    return awdcomp_create_sink(next, this->compression, this->compression_level,
+        awdthread_resolve_count(this->num_threads), this->parallel_deflate, this->long_distance);
+}
+
+
+void
+AWD::write_all_blocks(AWDOutputStream *out)
+{
+    if (this->has_flag(AWD_TOC))
+        this->toc = new AWDTocBlock();
+    if (this->has_flag(AWD_NAME_INDEX))
+        this->name_index = new AWDNameIndexBlock();
+
+    if (this->parallel_blocks && awdthread_resolve_count(this->num_threads) > 1) {
+        this->write_blocks_parallel(out);
     }
-    else if (this->compression == DEFLATE) {
-        int stat;
-        z_streamp zstrm;
-        int zlib_len;
-        awd_uint8 *zlib_buf;
-        bool done;
-
-        zlib_len = tmp_len;
-        zlib_buf = (awd_uint8*)malloc(zlib_len);
-
-        zstrm = (z_streamp)malloc(sizeof(z_stream_s));
-        zstrm->zalloc = awd_zalloc;
-        zstrm->zfree = awd_zfree;
-        zstrm->opaque = NULL;
-        zstrm->next_in = tmp_buf;
-        zstrm->avail_in = tmp_len;
-        zstrm->next_out = zlib_buf;
-        zstrm->avail_out = zlib_len;
-
-        stat = deflateInit(zstrm, 9);
-
-        done = false;
-        while (!done) {
-            stat = deflate(zstrm, Z_NO_FLUSH);
-
-            switch (stat) {
-                case Z_STREAM_END:
-                case Z_BUF_ERROR:
-                    done = true;
-                    break;
-            }
+    else {
+        if (this->metadata) {
+            this->write_single_block(this->metadata, out);
         }
 
-        deflate(zstrm, Z_FINISH);
-        deflateEnd(zstrm);
+        this->write_blocks(this->namespace_blocks, out);
+        this->write_blocks(this->skeleton_blocks, out);
+        this->write_blocks(this->skelpose_blocks, out);
+        this->write_blocks(this->skelanim_blocks, out);
+        this->write_blocks(this->texture_blocks, out);
+        this->write_blocks(this->material_blocks, out);
+        this->write_blocks(this->mesh_data_blocks, out);
+        this->write_blocks(this->uvanim_blocks, out);
+        this->write_scene(this->scene_blocks, out);
+    }
 
-        body_len = zstrm->total_out;
-        body_buf = (awd_uint8*)malloc(body_len);
-        memcpy(body_buf, zlib_buf, body_len);
+    // Name index goes after all blocks it refers to, but before the
+    // TOC, which lists it like any other block.
+    if (this->name_index) {
+        AWDNameIndexBlock *name_index = this->name_index;
 
-        free(zlib_buf);
-        free(zstrm);
+        this->name_index = NULL;
+        this->write_single_block(name_index, out);
+        delete name_index;
     }
-    else if (this->compression == LZMA) {
-        Byte *lzma_buf;
-        SizeT lzma_len, props_len;
-        CLzmaEncProps props;
-        ISzAlloc alloc;
-        Byte *props_buf;
-        long tmp_len_bo;
-
-        // Create allocation structure. LZMA library uses
-        // these functions for memory management. They are
-        // defined in awdlzma.c as simple wrappers for 
-        // malloc() and free().
-        alloc.Alloc = &awd_SzAlloc;
-        alloc.Free = &awd_SzFree;
-
-        lzma_len = tmp_len;
-        lzma_buf = (Byte *)malloc(tmp_len);
-        props_len = sizeof(CLzmaEncProps);
-        props_buf = (Byte *)malloc(props_len);
-
-        LzmaEncProps_Init(&props);
-        props.algo = 1;
-        props.level = 9;
-
-        LzmaEncode(lzma_buf, &lzma_len, tmp_buf, tmp_len,
-            &props, props_buf, &props_len, 0, NULL, &alloc, &alloc);
-
-        // Body length is the length of the actual
-        // compressed body + size of props and an integer
-        // definining the uncompressed length (see below)
-        body_len = (awd_uint32)lzma_len + (awd_uint32)props_len + sizeof(awd_uint32);
-
-        // Create new buffer containing LZMA props, length
-        // of uncompressed body and the actual body data
-        // concatenated together.
-        tmp_len_bo = UI32(tmp_len);
-        body_buf = (awd_uint8*)malloc(body_len);
-        memcpy(body_buf, &tmp_len_bo, sizeof(awd_uint32));
-        memcpy(body_buf+sizeof(awd_uint32), props_buf, props_len);
-        memcpy(body_buf+props_len+sizeof(awd_uint32), lzma_buf, lzma_len);
+
+    // TOC is the last block of the body, and never compressed so
+    // that readers can parse it straight from the file.
+    if (this->toc) {
+        this->toc_offset = AWD_HEADER_LENGTH + out->get_position();
+        this->toc->write_block(out, ++this->last_used_baddr);
+        delete this->toc;
+        this->toc = NULL;
     }
+}
 
 
-    // Write header and then body from possibly
-    // compressed buffer
+void
+AWD::write_toc_footer(AWDOutputStream *out)
+{
+    out->put_ui64(this->toc_offset);
+    out->put_bytes(AWD_TOC_MAGIC, 4);
+}
+
+
+awd_uint32
+AWD::flush_streaming(int out_fd)
+{
+    off_t header_pos;
+    off_t end_pos;
+    AWDFileSink file_sink(out_fd);
+    AWDSink *body_sink;
+    AWDOutputStream *out;
+    bool error;
+
+    // Compressor sits between the output stream and the file, and
+    // passes compressed data on in bounded chunks as it's produced.
+    body_sink = this->create_compressor(&file_sink);
+    if (body_sink == NULL)
+        return AWD_FALSE;
+
+    // The body length is not known until all blocks have been written,
+    // so the header is written with a zero length which is patched
+    // afterwards if the output is seekable. Non-seekable outputs (e.g.
+    // pipes) keep the zero length, and the body extends until EOF.
+    header_pos = -1;
     if (this->header_written == AWD_FALSE) {
         this->header_written = AWD_TRUE;
-        this->write_header(out_fd, body_len);
+        header_pos = lseek(out_fd, 0, SEEK_CUR);
+
+        out = new AWDOutputStream(&file_sink, AWD_HEADER_LENGTH);
+        this->write_header(out, 0);
+        delete out;
+    }
+
+    out = new AWDOutputStream(body_sink, this->stream_window);
+    this->write_all_blocks(out);
+    out->flush();
+    delete out;
+
+    body_sink->finish();
+    error = body_sink->has_error();
+    if (body_sink != &file_sink)
+        delete body_sink;
+
+    if (header_pos >= 0) {
+        end_pos = lseek(out_fd, 0, SEEK_CUR);
+        if (end_pos >= 0) {
+            awd_uint32 body_len;
+
+            body_len = UI32((awd_uint32)(end_pos - header_pos - AWD_HEADER_LENGTH));
+
+            // Length is the last field of the header
+            lseek(out_fd, header_pos + AWD_HEADER_LENGTH - sizeof(awd_uint32), SEEK_SET);
+            file_sink.write_bytes(&body_len, sizeof(awd_uint32));
+            lseek(out_fd, end_pos, SEEK_SET);
+        }
     }
 
-    write(out_fd, body_buf, body_len);
+    // Footer follows the body. On non-seekable outputs, where the body
+    // extends until EOF, readers must leave out the last footer bytes.
+    if (this->has_flag(AWD_TOC)) {
+        out = new AWDOutputStream(&file_sink, AWD_TOC_FOOTER_LENGTH);
+        this->write_toc_footer(out);
+        delete out;
+    }
+
+    if (error || file_sink.has_error())
+        return AWD_FALSE;
 
     return AWD_TRUE;
 }
 
 
+awd_uint32
+AWD::flush(int out_fd)
+{
+    AWDMemorySink *body_sink;
+    AWDSink *comp_sink;
+    AWDOutputStream *out;
+    bool comp_error;
+
+    awd_uint8 *body_buf;
+    awd_uint32 body_len;
+
+    if (this->has_flag(AWD_STREAMING))
+        return this->flush_streaming(out_fd);
+
+    // Serialize all blocks through the compressor and into an in-memory
+    // buffer. The body length must be known before the header can be
+    // written, but compression is done as the serialized data arrives,
+    // so only the (compressed) body is ever held in memory.
+    body_sink = new AWDMemorySink();
+    comp_sink = this->create_compressor(body_sink);
+    if (comp_sink == NULL) {
+        delete body_sink;
+        return AWD_FALSE;
+    }
+
+    out = new AWDOutputStream(comp_sink);
+    this->write_all_blocks(out);
+    out->flush();
+    delete out;
+
+    comp_sink->finish();
+    comp_error = comp_sink->has_error();
+    if (comp_sink != body_sink)
+        delete comp_sink;
+
+    if (comp_error) {
+        delete body_sink;
+        return AWD_FALSE;
+    }
+
+    body_buf = body_sink->get_buffer();
+    body_len = (awd_uint32)body_sink->get_length();
+
+    // Write header and then body from possibly
+    // compressed buffer
+    AWDFileSink out_sink(out_fd);
+    out = new AWDOutputStream(&out_sink, AWD_HEADER_LENGTH);
+    if (this->header_written == AWD_FALSE) {
+        this->header_written = AWD_TRUE;
+        this->write_header(out, body_len);
+    }
 
+    out->put_bytes(body_buf, body_len);
+    if (this->has_flag(AWD_TOC))
+        this->write_toc_footer(out);
+    out->flush();
+    delete out;
 
+    delete body_sink;
+
+    if (out_sink.has_error())
+        return AWD_FALSE;
+
+    return AWD_TRUE;
+}
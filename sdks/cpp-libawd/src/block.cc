@@ -1,6 +1,7 @@
 #include "awd_types.h"
 #include "block.h"
 #include "util.h"
+#include "compress.h"
 
 #include "platform.h"
 
@@ -15,6 +16,13 @@ AWDBlock::AWDBlock(AWD_block_type type)
 }
 
 
+AWDBlock::~AWDBlock()
+{
+    // Sub-classes are deleted through block pointers, e.g.
+    // by block lists, so the destructor must be virtual.
+}
+
+
 void
 AWDBlock::prepare_write()
 {
@@ -23,42 +31,105 @@ AWDBlock::prepare_write()
     // that need to happen before length is calculated
 }
 
-size_t
-AWDBlock::write_block(int fd, awd_baddr addr)
+void
+AWDBlock::write_header(AWDOutputStream *out, awd_uint8 flags, awd_uint32 length)
 {
     awd_uint8 ns_addr;
+
+    //TODO: Get addr of actual namespace
+    ns_addr = 0;
+
+    out->put_ui32(this->addr);
+    out->put_ui8(ns_addr);
+    out->put_ui8((awd_uint8)this->type);
+    out->put_ui8(flags);
+    out->put_ui32(length);
+}
+
+
+size_t
+AWDBlock::write_block(AWDOutputStream *out, awd_baddr addr)
+{
+    return this->write_block(out, addr, UNCOMPRESSED, AWD_DEFAULT_LEVEL, 0, NULL);
+}
+
+
+size_t
+AWDBlock::write_block(AWDOutputStream *out, awd_baddr addr,
+    AWD_compression compression, int level, awd_uint32 threshold, AWD_block_info *info)
+{
+    awd_uint8 flags;
     awd_uint32 length;
-    awd_uint32 length_be;
-    awd_baddr block_addr_be;
+    awd_uint32 stored_length;
+    AWDMemorySink raw_sink;
+    AWDMemorySink packed_sink;
+    AWDSink *comp_sink;
 
 	// TODO: Don't hard-code!
 	bool wide_mtx = false;
 
-    this->addr = addr;
+    // Address may have been assigned up front, while other threads
+    // are serializing blocks that refer to this one
+    if (this->addr != addr)
+        this->addr = addr;
 
     this->prepare_write();
     length = this->calc_body_length(wide_mtx);
 
-    //TODO: Get addr of actual namespace
-    ns_addr = 0;
+    if (info != NULL) {
+        info->flags = this->flags;
+        info->length = length;
+        info->stored_length = length;
+    }
 
-    // Convert to big-endian if necessary
-    block_addr_be = UI32(this->addr);
-    length_be = UI32(length);
+    if (compression == UNCOMPRESSED || length < threshold) {
+        this->write_header(out, this->flags, length);
 
-    // Write header
-    write(fd, &block_addr_be, sizeof(awd_baddr));
-    write(fd, &ns_addr, sizeof(awd_uint8));
-    write(fd, &this->type, sizeof(awd_uint8));
-    write(fd, &this->flags, sizeof(awd_uint8));
-    write(fd, &length_be, sizeof(awd_uint32));
+        // Write body using concrete implementation
+        // in block sub-classes
+        this->write_body(out, wide_mtx);
 
-    // Write body using concrete implementation
-    // in block sub-classes
-    this->write_body(fd, wide_mtx);
+        return (size_t)length + AWD_BLOCK_HEADER_LENGTH;
+    }
+
+    // Serialize body on its own and compress it independently
+    // of all other blocks, so that it can be decoded on its own.
+    AWDOutputStream raw_out(&raw_sink);
+    this->write_body(&raw_out, wide_mtx);
+    raw_out.flush();
+
+    comp_sink = awdcomp_create_sink(&packed_sink, compression, level, 1, false, false);
+    if (comp_sink != NULL) {
+        comp_sink->write_bytes(raw_sink.get_buffer(), raw_sink.get_length());
+        comp_sink->finish();
+        if (comp_sink->has_error())
+            packed_sink.reset();
+        delete comp_sink;
+    }
+
+    // Store body as is if compression failed or didn't pay off
+    if (packed_sink.get_length() == 0 ||
+        packed_sink.get_length() + sizeof(awd_uint32) >= length) {
+
+        this->write_header(out, this->flags, length);
+        out->put_bytes(raw_sink.get_buffer(), length);
+
+        return (size_t)length + AWD_BLOCK_HEADER_LENGTH;
+    }
+
+    flags = this->flags | (awd_uint8)(compression << AWD_BLOCK_COMPRESSION_SHIFT);
+    stored_length = (awd_uint32)(packed_sink.get_length() + sizeof(awd_uint32));
+    if (info != NULL) {
+        info->flags = flags;
+        info->stored_length = stored_length;
+    }
 
+    this->write_header(out, flags, stored_length);
 
-    return (size_t)length + 11;
+    out->put_ui32(length);
+    out->put_bytes(packed_sink.get_buffer(), packed_sink.get_length());
+
+    return (size_t)stored_length + AWD_BLOCK_HEADER_LENGTH;
 }
 
 
@@ -70,6 +141,13 @@ AWDBlock::get_addr()
 }
 
 
+void
+AWDBlock::set_addr(awd_baddr addr)
+{
+    this->addr = addr;
+}
+
+
 AWD_block_type
 AWDBlock::get_type()
 {
@@ -84,6 +162,18 @@ AWDBlockList::AWDBlockList()
     this->first_block = NULL;
     this->last_block = NULL;
     this->num_blocks = 0;
+    this->own_blocks = true;
+}
+
+
+AWDBlockList::AWDBlockList(bool own_blocks)
+{
+    // Lists that don't own their blocks only reference
+    // blocks which will be deleted by some other list
+    this->first_block = NULL;
+    this->last_block = NULL;
+    this->num_blocks = 0;
+    this->own_blocks = own_blocks;
 }
 
 AWDBlockList::~AWDBlockList()
@@ -94,7 +184,8 @@ AWDBlockList::~AWDBlockList()
     while(cur) {
         list_block *next = cur->next;
         cur->next = NULL;
-        delete cur->block;
+        if (this->own_blocks)
+            delete cur->block;
 		delete cur;
         cur = next;
     }
@@ -53,14 +53,14 @@ AWDCamera::calc_body_length(bool wide_mtx)
 
 
 void
-AWDCamera::write_body(int fd, bool wide_mtx)
+AWDCamera::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    this->write_scene_common(fd, wide_mtx);
+    this->write_scene_common(out, wide_mtx);
 
-    write(fd, &this->type, sizeof(awd_uint8));
-    write(fd, &this->lens, sizeof(awd_uint8));
+    out->put_ui8((awd_uint8)this->type);
+    out->put_ui8((awd_uint8)this->lens);
 
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
@@ -0,0 +1,920 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "compress.h"
+#include "awdlzma.h"
+#include "awdzlib.h"
+#include "thread.h"
+
+#include "Types.h"
+#include "LzmaEnc.h"
+
+
+AWDSink *
+awdcomp_create_sink(AWDSink *next, AWD_compression type, int level,
+    int threads, bool parallel_deflate, bool long_distance)
+{
+    // Returns a sink which compresses everything written to it using
+    // the specified compression type, and passes the result on to the
+    // next sink. Without compression, the next sink is returned as is.
+    // Returns NULL if the compression type is not supported by this
+    // build of libawd.
+    switch (type) {
+        case UNCOMPRESSED:
+            return next;
+
+        case DEFLATE:
+            if (level == AWD_DEFAULT_LEVEL)
+                level = AWD_DEFLATE_DEFAULT_LEVEL;
+
+            if (parallel_deflate && threads > 1)
+                return new AWDParallelDeflateSink(next, level, threads, AWD_DEFLATE_CHUNK_SIZE);
+
+            return new AWDDeflateSink(next, level);
+
+        case LZMA:
+        case LZMA_CHUNKED:
+            if (level == AWD_DEFAULT_LEVEL)
+                level = AWD_LZMA_DEFAULT_LEVEL;
+
+            if (type == LZMA_CHUNKED)
+                return new AWDChunkedLzmaSink(next, level, threads, AWD_LZMA_CHUNK_SIZE);
+
+            return new AWDLzmaSink(next, level);
+
+        case ZSTD:
+#ifdef AWD_WITH_ZSTD
+            if (level == AWD_DEFAULT_LEVEL)
+                level = AWD_ZSTD_DEFAULT_LEVEL;
+
+            return new AWDZstdSink(next, level, long_distance, threads);
+#else
+            printf("libawd was built without Zstandard support (AWD_WITH_ZSTD)\n");
+            return NULL;
+#endif
+
+        case LZ4:
+#ifdef AWD_WITH_LZ4
+            if (level == AWD_DEFAULT_LEVEL)
+                level = AWD_LZ4_DEFAULT_LEVEL;
+
+            return new AWDLz4Sink(next, level);
+#else
+            printf("libawd was built without LZ4 support (AWD_WITH_LZ4)\n");
+            return NULL;
+#endif
+    }
+
+    printf("Unknown compression type %d\n", (int)type);
+    return NULL;
+}
+
+
+
+
+AWDDeflateSink::AWDDeflateSink(AWDSink *next, int level)
+{
+    this->next = next;
+    this->finished = false;
+    this->error = false;
+    this->out_buf = (awd_uint8 *)malloc(AWD_ZCHUNK_SIZE);
+
+    this->zstrm.zalloc = awd_zalloc;
+    this->zstrm.zfree = awd_zfree;
+    this->zstrm.opaque = NULL;
+    this->zstrm.next_in = NULL;
+    this->zstrm.avail_in = 0;
+
+    if (deflateInit(&this->zstrm, level) != Z_OK) {
+        printf("Could not initialize zlib\n");
+        this->error = true;
+        this->finished = true;
+    }
+}
+
+
+AWDDeflateSink::~AWDDeflateSink()
+{
+    if (!this->finished)
+        deflateEnd(&this->zstrm);
+
+    free(this->out_buf);
+    this->out_buf = NULL;
+}
+
+
+void
+AWDDeflateSink::deflate_input(int flush)
+{
+    int stat;
+
+    // Keep deflating into the fixed-size output chunk and passing
+    // it on, until zlib has consumed all input and (when finishing)
+    // written the end of the stream. Z_BUF_ERROR only means that no
+    // progress was possible, i.e. that all output has been drained.
+    do {
+        size_t have;
+
+        this->zstrm.next_out = this->out_buf;
+        this->zstrm.avail_out = AWD_ZCHUNK_SIZE;
+
+        stat = deflate(&this->zstrm, flush);
+        if (stat == Z_STREAM_ERROR) {
+            printf("zlib stream error\n");
+            this->error = true;
+            return;
+        }
+
+        have = AWD_ZCHUNK_SIZE - this->zstrm.avail_out;
+        if (have > 0)
+            this->next->write_bytes(this->out_buf, have);
+    }
+    while (this->zstrm.avail_out == 0 ||
+        (flush == Z_FINISH && stat == Z_OK));
+}
+
+
+void
+AWDDeflateSink::write_bytes(const void *data, size_t len)
+{
+    const awd_uint8 *ptr;
+
+    if (this->finished || this->error)
+        return;
+
+    // Feed input in fixed-size chunks, which also keeps the length
+    // within the range of zlib's 32-bit avail_in counter.
+    ptr = (const awd_uint8 *)data;
+    while (len > 0 && !this->error) {
+        size_t chunk;
+
+        chunk = (len < AWD_ZCHUNK_SIZE)? len : AWD_ZCHUNK_SIZE;
+
+        this->zstrm.next_in = (Bytef *)ptr;
+        this->zstrm.avail_in = (uInt)chunk;
+        this->deflate_input(Z_NO_FLUSH);
+
+        ptr += chunk;
+        len -= chunk;
+    }
+}
+
+
+void
+AWDDeflateSink::finish()
+{
+    if (this->finished)
+        return;
+
+    this->zstrm.next_in = NULL;
+    this->zstrm.avail_in = 0;
+    if (!this->error)
+        this->deflate_input(Z_FINISH);
+
+    deflateEnd(&this->zstrm);
+    this->finished = true;
+
+    this->next->finish();
+}
+
+
+bool
+AWDDeflateSink::has_error()
+{
+    return (this->error || this->next->has_error());
+}
+
+
+
+
+// Adapters between the LZMA SDK stream interfaces and libawd
+// memory buffers/sinks. The SDK interface struct must come first
+// so that the SDK can pass the adapter back as its own pointer.
+typedef struct {
+    ISeqInStream funcs;
+    const awd_uint8 *data;
+    size_t rem;
+} awd_lzma_instream;
+
+typedef struct {
+    ISeqOutStream funcs;
+    AWDSink *sink;
+} awd_lzma_outstream;
+
+
+static SRes
+awd_lzma_read(void *p, void *buf, size_t *size)
+{
+    awd_lzma_instream *in = (awd_lzma_instream *)p;
+
+    if (*size > in->rem)
+        *size = in->rem;
+
+    memcpy(buf, in->data, *size);
+    in->data += *size;
+    in->rem -= *size;
+
+    return SZ_OK;
+}
+
+
+static size_t
+awd_lzma_write(void *p, const void *buf, size_t size)
+{
+    awd_lzma_outstream *out = (awd_lzma_outstream *)p;
+
+    out->sink->write_bytes(buf, size);
+    return size;
+}
+
+
+static void
+awd_lzma_encode(const awd_uint8 *data, size_t len, int level, awd_uint32 dict_size, AWDSink *out)
+{
+    CLzmaEncHandle enc;
+    CLzmaEncProps props;
+    ISzAlloc alloc;
+    Byte props_buf[LZMA_PROPS_SIZE];
+    SizeT props_len;
+    awd_uint32 in_len;
+    awd_lzma_instream in_str;
+    awd_lzma_outstream out_str;
+
+    // Create allocation structure. LZMA library uses
+    // these functions for memory management.
+    alloc.Alloc = &awd_SzAlloc;
+    alloc.Free = &awd_SzFree;
+
+    LzmaEncProps_Init(&props);
+    props.algo = 1;
+    props.level = level;
+    props.dictSize = dict_size;
+
+    enc = LzmaEnc_Create(&alloc);
+    LzmaEnc_SetProps(enc, &props);
+
+    props_len = LZMA_PROPS_SIZE;
+    LzmaEnc_WriteProperties(enc, props_buf, &props_len);
+
+    // Body starts with length of uncompressed data and props
+    in_len = UI32((awd_uint32)len);
+    out->write_bytes(&in_len, sizeof(awd_uint32));
+    out->write_bytes(props_buf, props_len);
+
+    in_str.funcs.Read = awd_lzma_read;
+    in_str.data = data;
+    in_str.rem = len;
+    out_str.funcs.Write = awd_lzma_write;
+    out_str.sink = out;
+
+    LzmaEnc_Encode(enc, &out_str.funcs, &in_str.funcs, NULL, &alloc, &alloc);
+    LzmaEnc_Destroy(enc, &alloc, &alloc);
+}
+
+
+AWDLzmaSink::AWDLzmaSink(AWDSink *next, int level)
+{
+    this->next = next;
+    this->level = level;
+    this->input = new AWDMemorySink();
+    this->finished = false;
+}
+
+
+AWDLzmaSink::~AWDLzmaSink()
+{
+    delete this->input;
+}
+
+
+void
+AWDLzmaSink::write_bytes(const void *data, size_t len)
+{
+    if (!this->finished)
+        this->input->write_bytes(data, len);
+}
+
+
+void
+AWDLzmaSink::finish()
+{
+    if (this->finished)
+        return;
+
+    awd_lzma_encode(this->input->get_buffer(), this->input->get_length(),
+        this->level, 0, this->next);
+
+    this->input->reset();
+    this->finished = true;
+
+    this->next->finish();
+}
+
+
+
+
+AWDChunkingSink::AWDChunkingSink(AWDSink *next, int num_threads, size_t chunk_size)
+{
+    int i;
+
+    if (num_threads < 1)
+        num_threads = 1;
+
+    this->next = next;
+    this->num_threads = num_threads;
+    this->chunk_size = chunk_size;
+    this->num_filled = 0;
+    this->finished = false;
+
+    this->inputs = (AWDMemorySink **)malloc(num_threads * sizeof(AWDMemorySink *));
+    this->outputs = (AWDMemorySink **)malloc(num_threads * sizeof(AWDMemorySink *));
+    for (i=0; i<num_threads; i++) {
+        this->inputs[i] = new AWDMemorySink();
+        this->outputs[i] = new AWDMemorySink();
+    }
+}
+
+
+AWDChunkingSink::~AWDChunkingSink()
+{
+    int i;
+
+    for (i=0; i<this->num_threads; i++) {
+        delete this->inputs[i];
+        delete this->outputs[i];
+    }
+
+    free(this->inputs);
+    free(this->outputs);
+}
+
+
+void
+AWDChunkingSink::flush_batch()
+{
+    int i;
+
+    if (this->num_filled == 0)
+        return;
+
+    this->compress_batch();
+
+    for (i=0; i<this->num_filled; i++)
+        this->inputs[i]->reset();
+
+    this->num_filled = 0;
+}
+
+
+void
+AWDChunkingSink::finish_stream()
+{
+    // Nothing to add after the last chunk by default
+}
+
+
+void
+AWDChunkingSink::write_bytes(const void *data, size_t len)
+{
+    const awd_uint8 *ptr;
+
+    if (this->finished)
+        return;
+
+    ptr = (const awd_uint8 *)data;
+    while (len > 0) {
+        AWDMemorySink *cur;
+        size_t space;
+
+        cur = this->inputs[this->num_filled];
+        space = this->chunk_size - cur->get_length();
+        if (space > len)
+            space = len;
+
+        cur->write_bytes(ptr, space);
+        ptr += space;
+        len -= space;
+
+        // Compress all chunks in parallel once
+        // there is one for every thread
+        if (cur->get_length() == this->chunk_size) {
+            this->num_filled++;
+            if (this->num_filled == this->num_threads)
+                this->flush_batch();
+        }
+    }
+}
+
+
+void
+AWDChunkingSink::finish()
+{
+    if (this->finished)
+        return;
+
+    // Include last, partially filled chunk
+    if (this->inputs[this->num_filled]->get_length() > 0)
+        this->num_filled++;
+
+    this->flush_batch();
+    this->finish_stream();
+    this->finished = true;
+
+    this->next->finish();
+}
+
+
+
+
+// Arguments and result of compressing one chunk on a worker thread
+typedef struct {
+    const awd_uint8 *data;
+    size_t len;
+    int level;
+    awd_uint32 dict_size;
+    AWDMemorySink *output;
+} awd_lzma_chunk_job;
+
+
+static void
+awd_lzma_chunk_main(void *arg)
+{
+    awd_lzma_chunk_job *job = (awd_lzma_chunk_job *)arg;
+
+    job->output->reset();
+    awd_lzma_encode(job->data, job->len, job->level, job->dict_size, job->output);
+}
+
+
+AWDChunkedLzmaSink::AWDChunkedLzmaSink(AWDSink *next, int level, int num_threads, size_t chunk_size) :
+    AWDChunkingSink(next, num_threads, chunk_size)
+{
+    this->level = level;
+}
+
+
+void
+AWDChunkedLzmaSink::compress_batch()
+{
+    int i;
+    void **args;
+    awd_lzma_chunk_job *jobs;
+    awd_uint32 dict_size;
+
+    // There is no point in a dictionary larger than the chunk, and
+    // it keeps per-thread encoder memory down.
+    dict_size = 0;
+    if (this->chunk_size < AWD_LZMA_MAX_DICT_SIZE)
+        dict_size = (awd_uint32)this->chunk_size;
+
+    jobs = (awd_lzma_chunk_job *)malloc(this->num_filled * sizeof(awd_lzma_chunk_job));
+    args = (void **)malloc(this->num_filled * sizeof(void *));
+    for (i=0; i<this->num_filled; i++) {
+        jobs[i].data = this->inputs[i]->get_buffer();
+        jobs[i].len = this->inputs[i]->get_length();
+        jobs[i].level = this->level;
+        jobs[i].dict_size = dict_size;
+        jobs[i].output = this->outputs[i];
+        args[i] = &jobs[i];
+    }
+
+    awdthread_run_jobs(awd_lzma_chunk_main, args, this->num_filled, this->num_threads);
+
+    // Write chunks in order, each prefixed by its compressed
+    // length so that readers can locate all chunks up front.
+    for (i=0; i<this->num_filled; i++) {
+        awd_uint32 stored_len;
+
+        stored_len = UI32((awd_uint32)this->outputs[i]->get_length());
+        this->next->write_bytes(&stored_len, sizeof(awd_uint32));
+        this->next->write_bytes(this->outputs[i]->get_buffer(), this->outputs[i]->get_length());
+    }
+
+    free(args);
+    free(jobs);
+}
+
+
+
+
+// Arguments and result of deflating one chunk on a worker thread
+typedef struct {
+    const awd_uint8 *data;
+    size_t len;
+    const awd_uint8 *dict;
+    size_t dict_len;
+    int level;
+    uLong adler;
+    AWDMemorySink *output;
+    bool error;
+} awd_deflate_chunk_job;
+
+
+static void
+awd_deflate_chunk_main(void *arg)
+{
+    z_stream zstrm;
+    int stat;
+    awd_uint8 *out_buf;
+    awd_deflate_chunk_job *job = (awd_deflate_chunk_job *)arg;
+
+    job->output->reset();
+    job->adler = adler32(adler32(0, NULL, 0), job->data, (uInt)job->len);
+    job->error = false;
+
+    zstrm.zalloc = awd_zalloc;
+    zstrm.zfree = awd_zfree;
+    zstrm.opaque = NULL;
+
+    // Raw deflate (negative window bits) since the zlib header and
+    // checksum are written once for the whole stream.
+    if (deflateInit2(&zstrm, job->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        job->error = true;
+        return;
+    }
+
+    // Prime with the end of the preceding data, so that matches
+    // can still reach back across the chunk boundary.
+    if (job->dict_len > 0)
+        deflateSetDictionary(&zstrm, job->dict, (uInt)job->dict_len);
+
+    out_buf = (awd_uint8 *)malloc(AWD_ZCHUNK_SIZE);
+
+    // End with a sync flush, which byte-aligns the output so
+    // that the next chunk can simply be appended to it.
+    zstrm.next_in = (Bytef *)job->data;
+    zstrm.avail_in = (uInt)job->len;
+    do {
+        zstrm.next_out = out_buf;
+        zstrm.avail_out = AWD_ZCHUNK_SIZE;
+
+        stat = deflate(&zstrm, Z_SYNC_FLUSH);
+        if (stat == Z_STREAM_ERROR) {
+            job->error = true;
+            break;
+        }
+
+        job->output->write_bytes(out_buf, AWD_ZCHUNK_SIZE - zstrm.avail_out);
+    }
+    while (zstrm.avail_out == 0);
+
+    deflateEnd(&zstrm);
+    free(out_buf);
+}
+
+
+AWDParallelDeflateSink::AWDParallelDeflateSink(AWDSink *next, int level, int num_threads, size_t chunk_size) :
+    AWDChunkingSink(next, num_threads, chunk_size)
+{
+    this->level = level;
+    this->adler = adler32(0, NULL, 0);
+    this->started = false;
+    this->error = false;
+    this->dict_len = 0;
+}
+
+
+void
+AWDParallelDeflateSink::write_zlib_header()
+{
+    awd_uint8 hdr[2];
+    int level_flags;
+
+    // Same header as zlib would write for this level
+    if (this->level >= 0 && this->level < 2)
+        level_flags = 0;
+    else if (this->level >= 2 && this->level < 6)
+        level_flags = 1;
+    else if (this->level == 6 || this->level < 0)
+        level_flags = 2;
+    else
+        level_flags = 3;
+
+    hdr[0] = 0x78; // Deflate, 32K window
+    hdr[1] = (awd_uint8)(level_flags << 6);
+    hdr[1] += 31 - (((hdr[0] << 8) + hdr[1]) % 31);
+
+    this->next->write_bytes(hdr, 2);
+    this->started = true;
+}
+
+
+void
+AWDParallelDeflateSink::compress_batch()
+{
+    int i;
+    void **args;
+    awd_deflate_chunk_job *jobs;
+
+    if (!this->started)
+        this->write_zlib_header();
+
+    jobs = (awd_deflate_chunk_job *)malloc(this->num_filled * sizeof(awd_deflate_chunk_job));
+    args = (void **)malloc(this->num_filled * sizeof(void *));
+    for (i=0; i<this->num_filled; i++) {
+        jobs[i].data = this->inputs[i]->get_buffer();
+        jobs[i].len = this->inputs[i]->get_length();
+        jobs[i].level = this->level;
+        jobs[i].output = this->outputs[i];
+        args[i] = &jobs[i];
+
+        if (i == 0) {
+            jobs[i].dict = this->dict;
+            jobs[i].dict_len = this->dict_len;
+        }
+        else {
+            jobs[i].dict_len = jobs[i-1].len;
+            if (jobs[i].dict_len > AWD_DEFLATE_DICT_SIZE)
+                jobs[i].dict_len = AWD_DEFLATE_DICT_SIZE;
+            jobs[i].dict = jobs[i-1].data + jobs[i-1].len - jobs[i].dict_len;
+        }
+    }
+
+    awdthread_run_jobs(awd_deflate_chunk_main, args, this->num_filled, this->num_threads);
+
+    // Concatenate raw chunks and combine their checksums
+    for (i=0; i<this->num_filled; i++) {
+        if (jobs[i].error)
+            this->error = true;
+
+        this->next->write_bytes(this->outputs[i]->get_buffer(), this->outputs[i]->get_length());
+        this->adler = adler32_combine(this->adler, jobs[i].adler, (z_off_t)jobs[i].len);
+    }
+
+    // Keep end of this batch as dictionary for the next one. The
+    // previous dictionary may be part of it if the chunk was short.
+    i = this->num_filled - 1;
+    if (jobs[i].len >= AWD_DEFLATE_DICT_SIZE) {
+        this->dict_len = AWD_DEFLATE_DICT_SIZE;
+        memcpy(this->dict, jobs[i].data + jobs[i].len - AWD_DEFLATE_DICT_SIZE, AWD_DEFLATE_DICT_SIZE);
+    }
+    else {
+        size_t keep;
+
+        keep = AWD_DEFLATE_DICT_SIZE - jobs[i].len;
+        if (keep > this->dict_len)
+            keep = this->dict_len;
+
+        memmove(this->dict, this->dict + this->dict_len - keep, keep);
+        memcpy(this->dict + keep, jobs[i].data, jobs[i].len);
+        this->dict_len = keep + jobs[i].len;
+    }
+
+    free(args);
+    free(jobs);
+}
+
+
+void
+AWDParallelDeflateSink::finish_stream()
+{
+    awd_uint8 trailer[6];
+
+    if (!this->started)
+        this->write_zlib_header();
+
+    // Empty final block with fixed codes, since all chunks ended
+    // with a sync flush. Then the big-endian adler32 checksum.
+    trailer[0] = 0x03;
+    trailer[1] = 0x00;
+    trailer[2] = (awd_uint8)(this->adler >> 24);
+    trailer[3] = (awd_uint8)(this->adler >> 16);
+    trailer[4] = (awd_uint8)(this->adler >> 8);
+    trailer[5] = (awd_uint8)(this->adler);
+
+    this->next->write_bytes(trailer, 6);
+}
+
+
+bool
+AWDParallelDeflateSink::has_error()
+{
+    return (this->error || this->next->has_error());
+}
+
+
+
+
+#ifdef AWD_WITH_ZSTD
+AWDZstdSink::AWDZstdSink(AWDSink *next, int level, bool long_distance, int num_threads)
+{
+    this->next = next;
+    this->finished = false;
+    this->error = false;
+    this->out_size = ZSTD_CStreamOutSize();
+    this->out_buf = (awd_uint8 *)malloc(this->out_size);
+
+    this->cctx = ZSTD_createCCtx();
+    if (this->cctx == NULL) {
+        printf("Could not initialize Zstandard\n");
+        this->error = true;
+        this->finished = true;
+        return;
+    }
+
+    ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_compressionLevel, level);
+    if (long_distance) {
+        ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_enableLongDistanceMatching, 1);
+        ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_windowLog, AWD_ZSTD_LDM_WINDOW_LOG);
+    }
+
+    // Fails harmlessly if the library was built without threading,
+    // in which case compression happens on the calling thread.
+    if (num_threads > 1)
+        ZSTD_CCtx_setParameter(this->cctx, ZSTD_c_nbWorkers, num_threads);
+}
+
+
+AWDZstdSink::~AWDZstdSink()
+{
+    if (this->cctx)
+        ZSTD_freeCCtx(this->cctx);
+
+    free(this->out_buf);
+    this->out_buf = NULL;
+}
+
+
+void
+AWDZstdSink::compress_input(ZSTD_inBuffer *in, ZSTD_EndDirective mode)
+{
+    size_t remaining;
+
+    // Continue until all input is consumed or, when ending the
+    // frame, until the compressor reports nothing left to flush.
+    do {
+        ZSTD_outBuffer out;
+
+        out.dst = this->out_buf;
+        out.size = this->out_size;
+        out.pos = 0;
+
+        remaining = ZSTD_compressStream2(this->cctx, &out, in, mode);
+        if (ZSTD_isError(remaining)) {
+            printf("Zstandard error: %s\n", ZSTD_getErrorName(remaining));
+            this->error = true;
+            return;
+        }
+
+        if (out.pos > 0)
+            this->next->write_bytes(this->out_buf, out.pos);
+    }
+    while ((mode == ZSTD_e_end)? (remaining > 0) : (in->pos < in->size));
+}
+
+
+void
+AWDZstdSink::write_bytes(const void *data, size_t len)
+{
+    ZSTD_inBuffer in;
+
+    if (this->finished || this->error || len == 0)
+        return;
+
+    in.src = data;
+    in.size = len;
+    in.pos = 0;
+    this->compress_input(&in, ZSTD_e_continue);
+}
+
+
+void
+AWDZstdSink::finish()
+{
+    ZSTD_inBuffer in;
+
+    if (this->finished)
+        return;
+
+    in.src = NULL;
+    in.size = 0;
+    in.pos = 0;
+    if (!this->error)
+        this->compress_input(&in, ZSTD_e_end);
+
+    this->finished = true;
+    this->next->finish();
+}
+
+
+bool
+AWDZstdSink::has_error()
+{
+    return (this->error || this->next->has_error());
+}
+#endif
+
+
+
+
+#ifdef AWD_WITH_LZ4
+AWDLz4Sink::AWDLz4Sink(AWDSink *next, int level)
+{
+    this->next = next;
+    this->started = false;
+    this->finished = false;
+    this->error = false;
+
+    memset(&this->prefs, 0, sizeof(LZ4F_preferences_t));
+    this->prefs.compressionLevel = level;
+    this->prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+    this->prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+
+    // Input is fed in chunks, and the output buffer must
+    // be able to hold the worst case for one such chunk.
+    this->out_size = LZ4F_compressBound(AWD_ZCHUNK_SIZE, &this->prefs);
+    if (this->out_size < LZ4F_HEADER_SIZE_MAX)
+        this->out_size = LZ4F_HEADER_SIZE_MAX;
+    this->out_buf = (awd_uint8 *)malloc(this->out_size);
+
+    if (LZ4F_isError(LZ4F_createCompressionContext(&this->cctx, LZ4F_VERSION))) {
+        printf("Could not initialize LZ4\n");
+        this->cctx = NULL;
+        this->error = true;
+        this->finished = true;
+    }
+}
+
+
+AWDLz4Sink::~AWDLz4Sink()
+{
+    if (this->cctx)
+        LZ4F_freeCompressionContext(this->cctx);
+
+    free(this->out_buf);
+    this->out_buf = NULL;
+}
+
+
+void
+AWDLz4Sink::emit(size_t ret)
+{
+    if (LZ4F_isError(ret)) {
+        printf("LZ4 error: %s\n", LZ4F_getErrorName(ret));
+        this->error = true;
+    }
+    else if (ret > 0) {
+        this->next->write_bytes(this->out_buf, ret);
+    }
+}
+
+
+void
+AWDLz4Sink::begin()
+{
+    this->started = true;
+    this->emit(LZ4F_compressBegin(this->cctx, this->out_buf, this->out_size, &this->prefs));
+}
+
+
+void
+AWDLz4Sink::write_bytes(const void *data, size_t len)
+{
+    const awd_uint8 *ptr;
+
+    if (this->finished || this->error)
+        return;
+
+    if (!this->started)
+        this->begin();
+
+    ptr = (const awd_uint8 *)data;
+    while (len > 0 && !this->error) {
+        size_t chunk;
+
+        chunk = (len < AWD_ZCHUNK_SIZE)? len : AWD_ZCHUNK_SIZE;
+        this->emit(LZ4F_compressUpdate(this->cctx, this->out_buf, this->out_size,
+            ptr, chunk, NULL));
+
+        ptr += chunk;
+        len -= chunk;
+    }
+}
+
+
+void
+AWDLz4Sink::finish()
+{
+    if (this->finished)
+        return;
+
+    if (!this->error) {
+        if (!this->started)
+            this->begin();
+
+        this->emit(LZ4F_compressEnd(this->cctx, this->out_buf, this->out_size, NULL));
+    }
+
+    this->finished = true;
+    this->next->finish();
+}
+
+
+bool
+AWDLz4Sink::has_error()
+{
+    return (this->error || this->next->has_error());
+}
+#endif
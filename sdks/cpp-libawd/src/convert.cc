@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "convert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AWD_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "platform.h"
+
+
+void
+awdconv_f64_to_f32(awd_uint8 *dst, const awd_float64 *src, size_t num)
+{
+    size_t i;
+
+    i = 0;
+
+#if defined(__AVX__)
+    for (; i+8 <= num; i+=8) {
+        __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i));
+        __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i + 4));
+
+        _mm_storeu_ps((float *)(dst + i*sizeof(awd_float32)), lo);
+        _mm_storeu_ps((float *)(dst + (i+4)*sizeof(awd_float32)), hi);
+    }
+#endif
+
+#if defined(AWD_CONVERT_SSE2)
+    for (; i+4 <= num; i+=4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+
+        _mm_storeu_ps((float *)(dst + i*sizeof(awd_float32)), _mm_movelh_ps(lo, hi));
+    }
+#endif
+
+    for (; i<num; i++) {
+        awd_float32 v = (awd_float32)src[i];
+        memcpy(dst + i*sizeof(awd_float32), &v, sizeof(awd_float32));
+    }
+}
+
+
+void
+awdconv_u32_to_u16(awd_uint8 *dst, const awd_uint32 *src, size_t num)
+{
+    size_t i;
+
+    i = 0;
+
+    // Low halves are sign-extended first, so that the saturating
+    // pack keeps them as they are (i.e. truncates like a cast.)
+#if defined(__AVX2__)
+    for (; i+16 <= num; i+=16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i + 8));
+
+        a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+        b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+
+        // Packing works within 128-bit lanes, so lanes are put back
+        // in order afterwards.
+        a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(dst + i*sizeof(awd_uint16)), a);
+    }
+#endif
+
+#if defined(AWD_CONVERT_SSE2)
+    for (; i+8 <= num; i+=8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+
+        a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        _mm_storeu_si128((__m128i *)(dst + i*sizeof(awd_uint16)), _mm_packs_epi32(a, b));
+    }
+#endif
+
+    for (; i<num; i++) {
+        awd_uint16 v = (awd_uint16)src[i];
+        memcpy(dst + i*sizeof(awd_uint16), &v, sizeof(awd_uint16));
+    }
+}
+
+
+void
+awdconv_u32_to_u8(awd_uint8 *dst, const awd_uint32 *src, size_t num)
+{
+    size_t i;
+
+    i = 0;
+
+#if defined(AWD_CONVERT_SSE2)
+    // Masking to the low byte makes both saturating packs lossless
+    __m128i mask = _mm_set1_epi32(0xff);
+
+    for (; i+16 <= num; i+=16) {
+        __m128i a = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i)), mask);
+        __m128i b = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 4)), mask);
+        __m128i c = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 8)), mask);
+        __m128i d = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + i + 12)), mask);
+
+        a = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i *)(dst + i), a);
+    }
+#endif
+
+    for (; i<num; i++)
+        dst[i] = (awd_uint8)src[i];
+}
+
+
+void
+awdconv_i32_to_i16(awd_uint8 *dst, const awd_int32 *src, size_t num)
+{
+    // Truncation is the same for signed and unsigned integers
+    awdconv_u32_to_u16(dst, (const awd_uint32 *)src, num);
+}
+
+
+void
+awdconv_i32_to_i8(awd_uint8 *dst, const awd_int32 *src, size_t num)
+{
+    awdconv_u32_to_u8(dst, (const awd_uint32 *)src, num);
+}
@@ -0,0 +1,361 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef AWD_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef AWD_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "decompress.h"
+#include "compress.h"
+#include "awdlzma.h"
+#include "thread.h"
+
+#include "Types.h"
+#include "LzmaDec.h"
+
+
+static bool
+awd_inflate(const awd_uint8 *data, size_t len, AWDMemorySink *out)
+{
+    int ret;
+    z_stream zstrm;
+
+    memset(&zstrm, 0, sizeof(z_stream));
+    if (inflateInit(&zstrm) != Z_OK) {
+        printf("Could not initialize zlib\n");
+        return false;
+    }
+
+    zstrm.next_in = (Bytef *)data;
+    zstrm.avail_in = (uInt)len;
+
+    // Inflate straight into the end of the output buffer
+    do {
+        zstrm.next_out = (Bytef *)out->reserve(AWD_ZCHUNK_SIZE);
+        zstrm.avail_out = AWD_ZCHUNK_SIZE;
+
+        ret = inflate(&zstrm, Z_NO_FLUSH);
+        out->advance(AWD_ZCHUNK_SIZE - zstrm.avail_out);
+
+        // Buffer error means no progress was possible, which with
+        // plenty of output space means that input was truncated.
+        if (ret == Z_BUF_ERROR && zstrm.avail_in == 0)
+            break;
+    }
+    while (ret == Z_OK);
+
+    inflateEnd(&zstrm);
+
+    if (ret != Z_STREAM_END) {
+        printf("Could not inflate body (zlib error %d)\n", ret);
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool
+awd_lzma_decode(const awd_uint8 *data, size_t len, awd_uint8 *dst, awd_uint32 dst_len)
+{
+    SRes res;
+    SizeT out_len;
+    SizeT in_len;
+    ISzAlloc alloc;
+    ELzmaStatus status;
+
+    // Body starts with length of uncompressed data and props
+    if (len < sizeof(awd_uint32) + LZMA_PROPS_SIZE)
+        return false;
+
+    alloc.Alloc = &awd_SzAlloc;
+    alloc.Free = &awd_SzFree;
+
+    out_len = dst_len;
+    in_len = len - sizeof(awd_uint32) - LZMA_PROPS_SIZE;
+    res = LzmaDecode(dst, &out_len, data + sizeof(awd_uint32) + LZMA_PROPS_SIZE, &in_len,
+        data + sizeof(awd_uint32), LZMA_PROPS_SIZE, LZMA_FINISH_ANY, &status, &alloc);
+
+    return (res == SZ_OK && out_len == dst_len);
+}
+
+
+static awd_uint32
+awd_lzma_length(const awd_uint8 *data)
+{
+    awd_uint32 len;
+
+    memcpy(&len, data, sizeof(awd_uint32));
+    return UI32(len);
+}
+
+
+static bool
+awd_lzma_decompress(const awd_uint8 *data, size_t len, AWDMemorySink *out)
+{
+    awd_uint32 out_len;
+    awd_uint8 *dst;
+
+    if (len < sizeof(awd_uint32) + LZMA_PROPS_SIZE) {
+        printf("Truncated LZMA body\n");
+        return false;
+    }
+
+    out_len = awd_lzma_length(data);
+    dst = out->reserve(out_len);
+    if (!awd_lzma_decode(data, len, dst, out_len)) {
+        printf("Could not decode LZMA body\n");
+        return false;
+    }
+
+    out->advance(out_len);
+    return true;
+}
+
+
+// Decoding of one LZMA_CHUNKED chunk on a worker thread
+typedef struct {
+    const awd_uint8 *data;
+    size_t len;
+    awd_uint8 *dst;
+    awd_uint32 dst_len;
+    bool ok;
+} awd_lzma_dechunk_job;
+
+
+static void
+awd_lzma_dechunk_main(void *arg)
+{
+    awd_lzma_dechunk_job *job = (awd_lzma_dechunk_job *)arg;
+
+    job->ok = awd_lzma_decode(job->data, job->len, job->dst, job->dst_len);
+}
+
+
+static bool
+awd_lzma_chunked_decompress(const awd_uint8 *data, size_t len, AWDMemorySink *out, int num_threads)
+{
+    int i;
+    int num_chunks;
+    size_t offs;
+    size_t total_len;
+    awd_uint8 *dst;
+    awd_lzma_dechunk_job *jobs;
+    void **args;
+    bool ok;
+
+    // Find all chunks first, to know their uncompressed lengths
+    // and decode all chunks in place in parallel.
+    num_chunks = 0;
+    offs = 0;
+    while (offs < len) {
+        awd_uint32 chunk_len;
+
+        if (len - offs < sizeof(awd_uint32) + sizeof(awd_uint32) + LZMA_PROPS_SIZE)
+            break;
+
+        chunk_len = awd_lzma_length(data + offs);
+        if (chunk_len > len - offs - sizeof(awd_uint32))
+            break;
+
+        offs += sizeof(awd_uint32) + chunk_len;
+        num_chunks++;
+    }
+
+    if (offs != len) {
+        printf("Truncated LZMA chunk\n");
+        return false;
+    }
+
+    jobs = (awd_lzma_dechunk_job *)malloc(num_chunks * sizeof(awd_lzma_dechunk_job));
+    args = (void **)malloc(num_chunks * sizeof(void *));
+
+    total_len = 0;
+    offs = 0;
+    for (i=0; i<num_chunks; i++) {
+        jobs[i].len = awd_lzma_length(data + offs);
+        jobs[i].data = data + offs + sizeof(awd_uint32);
+        jobs[i].dst_len = awd_lzma_length(jobs[i].data);
+        jobs[i].ok = false;
+        args[i] = &jobs[i];
+
+        total_len += jobs[i].dst_len;
+        offs += sizeof(awd_uint32) + jobs[i].len;
+    }
+
+    dst = out->reserve(total_len);
+    for (i=0; i<num_chunks; i++) {
+        jobs[i].dst = dst;
+        dst += jobs[i].dst_len;
+    }
+
+    awdthread_run_jobs(awd_lzma_dechunk_main, args, num_chunks, num_threads);
+
+    ok = true;
+    for (i=0; i<num_chunks; i++) {
+        if (!jobs[i].ok)
+            ok = false;
+    }
+
+    free(args);
+    free(jobs);
+
+    if (!ok) {
+        printf("Could not decode LZMA chunk\n");
+        return false;
+    }
+
+    out->advance(total_len);
+    return true;
+}
+
+
+#ifdef AWD_WITH_ZSTD
+static bool
+awd_zstd_decompress(const awd_uint8 *data, size_t len, AWDMemorySink *out)
+{
+    size_t ret;
+    size_t out_size;
+    ZSTD_DCtx *dctx;
+    ZSTD_inBuffer in;
+
+    dctx = ZSTD_createDCtx();
+    if (dctx == NULL) {
+        printf("Could not initialize Zstandard\n");
+        return false;
+    }
+
+    // Allow the window used by long distance matching
+    ZSTD_DCtx_setParameter(dctx, ZSTD_d_windowLogMax, AWD_ZSTD_LDM_WINDOW_LOG);
+
+    in.src = data;
+    in.size = len;
+    in.pos = 0;
+
+    out_size = ZSTD_DStreamOutSize();
+    for (;;) {
+        ZSTD_outBuffer zout;
+
+        zout.dst = out->reserve(out_size);
+        zout.size = out_size;
+        zout.pos = 0;
+
+        ret = ZSTD_decompressStream(dctx, &zout, &in);
+        if (ZSTD_isError(ret)) {
+            printf("Zstandard error: %s\n", ZSTD_getErrorName(ret));
+            break;
+        }
+
+        out->advance(zout.pos);
+
+        // Frame is complete once all of its output is flushed, and
+        // input is truncated if no more output can be produced.
+        if (zout.pos < zout.size && (ret == 0 || in.pos == in.size))
+            break;
+    }
+
+    ZSTD_freeDCtx(dctx);
+
+    if (ret != 0) {
+        if (!ZSTD_isError(ret))
+            printf("Truncated Zstandard body\n");
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+
+#ifdef AWD_WITH_LZ4
+static bool
+awd_lz4_decompress(const awd_uint8 *data, size_t len, AWDMemorySink *out)
+{
+    size_t ret;
+    LZ4F_dctx *dctx;
+
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION))) {
+        printf("Could not initialize LZ4\n");
+        return false;
+    }
+
+    ret = 1;
+    while (ret != 0) {
+        size_t in_len;
+        size_t out_len;
+        awd_uint8 *dst;
+
+        in_len = len;
+        out_len = AWD_ZCHUNK_SIZE;
+        dst = out->reserve(out_len);
+
+        ret = LZ4F_decompress(dctx, dst, &out_len, data, &in_len, NULL);
+        if (LZ4F_isError(ret)) {
+            printf("LZ4 error: %s\n", LZ4F_getErrorName(ret));
+            break;
+        }
+
+        out->advance(out_len);
+        data += in_len;
+        len -= in_len;
+
+        // No progress means that input was truncated
+        if (in_len == 0 && out_len == 0)
+            break;
+    }
+
+    LZ4F_freeDecompressionContext(dctx);
+
+    if (ret != 0) {
+        if (!LZ4F_isError(ret))
+            printf("Truncated LZ4 body\n");
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+
+bool
+awdcomp_decompress(AWD_compression type, const awd_uint8 *data, size_t len,
+    AWDMemorySink *out, int num_threads)
+{
+    switch (type) {
+        case UNCOMPRESSED:
+            out->write_bytes(data, len);
+            return true;
+
+        case DEFLATE:
+            return awd_inflate(data, len, out);
+
+        case LZMA:
+            return awd_lzma_decompress(data, len, out);
+
+        case LZMA_CHUNKED:
+            return awd_lzma_chunked_decompress(data, len, out, num_threads);
+
+        case ZSTD:
+#ifdef AWD_WITH_ZSTD
+            return awd_zstd_decompress(data, len, out);
+#else
+            printf("libawd was built without Zstandard support (AWD_WITH_ZSTD)\n");
+            return false;
+#endif
+
+        case LZ4:
+#ifdef AWD_WITH_LZ4
+            return awd_lz4_decompress(data, len, out);
+#else
+            printf("libawd was built without LZ4 support (AWD_WITH_LZ4)\n");
+            return false;
+#endif
+    }
+
+    printf("Unknown compression type %d\n", (int)type);
+    return false;
+}
@@ -0,0 +1,74 @@
+#include "field.h"
+
+#include "platform.h"
+
+
+// Strings and byte arrays are written as they are
+static void
+awd_encode_bytes(AWDOutputStream *out, const void *val, awd_uint32 len, bool wide_mtx)
+{
+    out->put_bytes(val, len);
+}
+
+
+#define AWD_ARRAY_ENCODERS(F) \
+    case F: \
+        switch (storage) { \
+            case AWD_FIELD_INT32:   return awd_encode_array<F, awd_int32>; \
+            case AWD_FIELD_UINT32:  return awd_encode_array<F, awd_uint32>; \
+            case AWD_FIELD_FLOAT64: return awd_encode_array<F, awd_float64>; \
+            default: \
+                if (storage == F) \
+                    return awd_encode_array<F, AWDField<F>::type>; \
+                return NULL; \
+        }
+
+awd_array_encoder
+awdutil_get_array_encoder(AWD_field_type type, AWD_field_type storage)
+{
+    // Values are held in memory either as the field type itself, or
+    // as 32-bit integers or doubles (see AWDDataStream.)
+    switch (type) {
+        AWD_ARRAY_ENCODERS(AWD_FIELD_INT8)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_INT16)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_INT32)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_UINT8)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_UINT16)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_UINT32)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_FLOAT32)
+        AWD_ARRAY_ENCODERS(AWD_FIELD_FLOAT64)
+        default:
+            return NULL;
+    }
+}
+
+#undef AWD_ARRAY_ENCODERS
+
+
+awd_value_encoder
+awdutil_get_value_encoder(AWD_field_type type)
+{
+    switch (type) {
+        case AWD_FIELD_INT8:        return awd_encode_value<AWD_FIELD_INT8>;
+        case AWD_FIELD_INT16:       return awd_encode_value<AWD_FIELD_INT16>;
+        case AWD_FIELD_INT32:       return awd_encode_value<AWD_FIELD_INT32>;
+        case AWD_FIELD_UINT8:       return awd_encode_value<AWD_FIELD_UINT8>;
+        case AWD_FIELD_UINT16:      return awd_encode_value<AWD_FIELD_UINT16>;
+        case AWD_FIELD_UINT32:      return awd_encode_value<AWD_FIELD_UINT32>;
+        case AWD_FIELD_FLOAT32:     return awd_encode_value<AWD_FIELD_FLOAT32>;
+        case AWD_FIELD_FLOAT64:     return awd_encode_value<AWD_FIELD_FLOAT64>;
+        case AWD_FIELD_BOOL:        return awd_encode_value<AWD_FIELD_BOOL>;
+        case AWD_FIELD_COLOR:       return awd_encode_value<AWD_FIELD_COLOR>;
+        case AWD_FIELD_BADDR:       return awd_encode_value<AWD_FIELD_BADDR>;
+        case AWD_FIELD_STRING:      return awd_encode_bytes;
+        case AWD_FIELD_BYTEARRAY:   return awd_encode_bytes;
+        case AWD_FIELD_VECTOR2x1:   return awd_encode_value<AWD_FIELD_VECTOR2x1>;
+        case AWD_FIELD_VECTOR3x1:   return awd_encode_value<AWD_FIELD_VECTOR3x1>;
+        case AWD_FIELD_VECTOR4x1:   return awd_encode_value<AWD_FIELD_VECTOR4x1>;
+        case AWD_FIELD_MTX3x2:      return awd_encode_value<AWD_FIELD_MTX3x2>;
+        case AWD_FIELD_MTX3x3:      return awd_encode_value<AWD_FIELD_MTX3x3>;
+        case AWD_FIELD_MTX4x3:      return awd_encode_value<AWD_FIELD_MTX4x3>;
+        case AWD_FIELD_MTX4x4:      return awd_encode_value<AWD_FIELD_MTX4x4>;
+        default:                    return NULL;
+    }
+}
@@ -4,126 +4,252 @@
 
 #include "platform.h"
 #include "geomutil.h"
+#include "thread.h"
 
-VertexDataList::VertexDataList()
-{
-	this->num_items = 0;
-	this->cur = NULL;
-	this->first = NULL;
-	this->last = NULL;
-}
 
-VertexDataList::~VertexDataList()
-{
-	vdata_list_item *cur_item = this->first;
-    while (cur_item) {
-        ninfluence *cur_n;
-		vdata *cur_v = cur_item->vd;
-        vdata_list_item *next_item = cur_item->next;
-
-        // Free skinning data if any
-        if (cur_v->num_bindings) {
-            free(cur_v->weights);
-            free(cur_v->joints);
-        }
+// Number of partitions (and output ranges) per thread. Having more
+// than one keeps threads busy when partitions differ in cost.
+#define AWD_GEOM_PARTS_PER_THREAD 4
 
-        // Free normal influence list
-        cur_n = cur_v->first_normal_influence;
-        while (cur_n) {
-            ninfluence *next_n = cur_n->next;
-            free(cur_n);
-            cur_n = next_n;
-        }
 
-        free(cur_v);
-        cur_item = next_item;
-    }
+typedef enum {
+    AWD_GEOM_WELD,
+    AWD_GEOM_COUNT,
+    AWD_GEOM_OUTPUT,
+    AWD_GEOM_INDEX
+} awd_geom_phase;
 
-	this->clear();
-}
 
-void
-VertexDataList::append_vdata(vdata *vd)
-{
-	vdata_list_item *item = (vdata_list_item*)malloc(sizeof(vdata_list_item));
-	item->vd = vd;
+// Welding of a partition, or output of a range of expanded vertices,
+// done by one of the worker threads.
+struct _awd_geom_job {
+    AWDGeomUtil *util;
+    awd_geom_phase phase;
 
-	if (!this->first) {
-		this->first = item;
-	}
-	else {
-		this->last->next = item;
-	}
+    // Partition: expanded vertices in order, and arena that
+    // backs their normal influences.
+    unsigned int *verts;
+    unsigned int num_verts;
+    AWDArena *arena;
+
+    // Range: expanded vertices first to end, the number of output
+    // vertices and binding values they contribute, and where in the
+    // output those start.
+    unsigned int first;
+    unsigned int end;
+    unsigned int num_out;
+    unsigned int num_bind_vals;
+    unsigned int first_out;
+    unsigned int first_bind;
+};
 
-	this->last = item;
-	this->last->next = NULL;
-	this->num_items++;
-}
 
 void
-VertexDataList::clear()
+awdgeom_run_job(void *arg)
 {
-	this->num_items = 0;
-	this->first = NULL;
-	this->last = NULL;
+    awd_geom_job *job = (awd_geom_job *)arg;
+
+    switch (job->phase) {
+        case AWD_GEOM_WELD:
+            job->util->weld_part(job);
+            break;
+        case AWD_GEOM_COUNT:
+            job->util->count_range(job);
+            break;
+        case AWD_GEOM_OUTPUT:
+            job->util->output_range(job);
+            break;
+        case AWD_GEOM_INDEX:
+            job->util->index_range(job);
+            break;
+    }
 }
 
-int
-VertexDataList::get_num_items()
+AWDGeomUtil::AWDGeomUtil()
 {
-	return this->num_items;
+	this->arena = new AWDArena();
+
+	this->num_verts = 0;
+	this->max_verts = 0;
+	this->vert_idx = NULL;
+	this->vert_pos = NULL;
+	this->vert_uv = NULL;
+	this->vert_nrm = NULL;
+	this->vert_hard = NULL;
+	this->vert_num_bindings = NULL;
+
+	this->num_bind_vals = 0;
+	this->max_bind_vals = 0;
+	this->bind_weights = NULL;
+	this->bind_joints = NULL;
+
+	this->vert_src = NULL;
+	this->vert_next = NULL;
+	this->vert_influences = NULL;
+	this->vert_out = NULL;
+	this->num_parts = 0;
+	this->part_verts = NULL;
+	this->part_jobs = NULL;
+
+	this->out_pos = NULL;
+	this->out_uv = NULL;
+	this->out_nrm = NULL;
+	this->out_weights = NULL;
+	this->out_joints = NULL;
+	this->out_tris = NULL;
+
+    this->normal_threshold = 0;
+    this->joints_per_vertex = 0;
+    this->include_uv = true;
+    this->include_normals = true;
+    this->num_threads = 1;
+    this->optimize_vertex_cache = false;
+    this->vertex_cache_size = AWD_VCACHE_SIZE;
+    memset(&this->vcache_before, 0, sizeof(AWD_vcache_stats));
+    memset(&this->vcache_after, 0, sizeof(AWD_vcache_stats));
 }
 
-void
-VertexDataList::iter_reset()
+AWDGeomUtil::~AWDGeomUtil()
 {
-	this->cur = this->first;
+	this->end_build();
+
+	free(vert_idx);
+	free(vert_pos);
+	free(vert_uv);
+	free(vert_nrm);
+	free(vert_hard);
+	free(vert_num_bindings);
+	free(bind_weights);
+	free(bind_joints);
+
+	// Releases vdata structs
+	delete arena;
 }
 
-vdata *
-VertexDataList::iter_next()
+
+void
+AWDGeomUtil::reserve_verts(unsigned int num)
 {
-	if (this->cur) {
-		vdata *vd = this->cur->vd;
-		this->cur = this->cur->next;
-		return vd;
-	}
-	else {
-		return NULL;
-	}
+    unsigned int max;
+
+    if (this->num_verts + num <= this->max_verts)
+        return;
+
+    max = this->max_verts? this->max_verts * 2 : 256;
+    if (max < this->num_verts + num)
+        max = this->num_verts + num;
+
+    this->vert_idx = (unsigned int *)realloc(this->vert_idx, max * sizeof(unsigned int));
+    this->vert_pos = (awd_float64 *)realloc(this->vert_pos, max * 3 * sizeof(awd_float64));
+    this->vert_uv = (awd_float64 *)realloc(this->vert_uv, max * 2 * sizeof(awd_float64));
+    this->vert_nrm = (awd_float64 *)realloc(this->vert_nrm, max * 3 * sizeof(awd_float64));
+    this->vert_hard = (bool *)realloc(this->vert_hard, max * sizeof(bool));
+    this->vert_num_bindings = (int *)realloc(this->vert_num_bindings, max * sizeof(int));
+    this->max_verts = max;
 }
 
-AWDGeomUtil::AWDGeomUtil()
+
+void
+AWDGeomUtil::reserve_bindings(unsigned int num)
 {
-	this->expanded = new VertexDataList();
-	this->collapsed = new VertexDataList();
-	this->per_idx_lists = NULL;
-	this->max_orig_idx = 0;
-    this->normal_threshold = 0;
-    this->joints_per_vertex = 0;
-    this->include_uv = true;
-    this->include_normals = true;
+    unsigned int max;
+
+    if (this->num_bind_vals + num <= this->max_bind_vals)
+        return;
+
+    max = this->max_bind_vals? this->max_bind_vals * 2 : 1024;
+    if (max < this->num_bind_vals + num)
+        max = this->num_bind_vals + num;
+
+    this->bind_weights = (awd_float64 *)realloc(this->bind_weights, max * sizeof(awd_float64));
+    this->bind_joints = (awd_uint32 *)realloc(this->bind_joints, max * sizeof(awd_uint32));
+    this->max_bind_vals = max;
 }
 
-AWDGeomUtil::~AWDGeomUtil()
+
+/**
+ * Allocate a vertex data struct from the arena of this util, with room
+ * for the specified number of skinning bindings. It is zero-initialized
+ * and then filled in by the caller before passing it to
+ * append_vdata_struct(). The util retains ownership, and it must not be
+ * freed by the caller.
+*/
+vdata *
+AWDGeomUtil::alloc_vdata(int num_bindings)
 {
-	int i;
-	for (i=0; i<num_idx_lists; i++) {
-		// Empty list to not delete items, which are
-		// duplicated in the expanded list.
-		per_idx_lists[i]->clear();
-		delete per_idx_lists[i];
-	}
+    vdata *vd;
+
+    vd = (vdata *)arena->alloc(sizeof(vdata));
+    memset(vd, 0, sizeof(vdata));
+
+    if (num_bindings > 0) {
+        vd->num_bindings = num_bindings;
+        vd->weights = (awd_float64 *)arena->alloc(num_bindings * sizeof(awd_float64));
+        vd->joints = (awd_uint32 *)arena->alloc(num_bindings * sizeof(awd_uint32));
+        memset(vd->weights, 0, num_bindings * sizeof(awd_float64));
+        memset(vd->joints, 0, num_bindings * sizeof(awd_uint32));
+    }
+
+    return vd;
+}
 
-	free(per_idx_lists);
 
-	// Empty list to not delete items, which are
-	// duplicated in the expanded list.
-	collapsed->clear();
-	delete collapsed;
+/**
+ * Append face-vertices from contiguous arrays. The data is copied, so
+ * the arrays can be released as soon as this returns.
+*/
+void
+AWDGeomUtil::append_vert_arrays(const vdata_arrays *arr)
+{
+    unsigned int i;
+    unsigned int num;
+    unsigned int first;
+
+    num = arr->num_verts;
+    if (num == 0)
+        return;
+
+    this->reserve_verts(num);
+    first = this->num_verts;
+
+    memcpy(&this->vert_idx[first], arr->indices, num * sizeof(unsigned int));
+    memcpy(&this->vert_pos[first*3], arr->positions, num * 3 * sizeof(awd_float64));
+
+    if (arr->uvs)
+        memcpy(&this->vert_uv[first*2], arr->uvs, num * 2 * sizeof(awd_float64));
+    else
+        memset(&this->vert_uv[first*2], 0, num * 2 * sizeof(awd_float64));
+
+    if (arr->normals)
+        memcpy(&this->vert_nrm[first*3], arr->normals, num * 3 * sizeof(awd_float64));
+    else
+        memset(&this->vert_nrm[first*3], 0, num * 3 * sizeof(awd_float64));
+
+    if (arr->force_hard)
+        memcpy(&this->vert_hard[first], arr->force_hard, num * sizeof(bool));
+    else
+        memset(&this->vert_hard[first], 0, num * sizeof(bool));
+
+    if (arr->num_bindings > 0 && arr->weights && arr->joints) {
+        int nb = arr->num_bindings;
+        int stride = arr->binding_stride? arr->binding_stride : nb;
+
+        this->reserve_bindings(num * nb);
+        for (i=0; i<num; i++) {
+            size_t src;
+
+            src = (size_t)(arr->bindings_by_index? arr->indices[i] : i) * stride;
+            memcpy(&this->bind_weights[this->num_bind_vals], &arr->weights[src], nb * sizeof(awd_float64));
+            memcpy(&this->bind_joints[this->num_bind_vals], &arr->joints[src], nb * sizeof(awd_uint32));
+            this->vert_num_bindings[first+i] = nb;
+            this->num_bind_vals += nb;
+        }
+    }
+    else {
+        memset(&this->vert_num_bindings[first], 0, num * sizeof(int));
+    }
 
-	// Delete entire list, including items.
-	delete expanded;
+    this->num_verts += num;
 }
 
 
@@ -131,327 +257,635 @@ void
 AWDGeomUtil::append_vert_data(unsigned int idx, double x, double y, double z,
     double u, double v, double nx, double ny, double nz, bool force_hard)
 {
-    vdata *vd;
-
-    vd = (vdata *)malloc(sizeof(vdata));
-    vd->orig_idx = idx;
-    vd->out_idx = -1;
-    vd->x = x;
-    vd->y = y;
-    vd->z = z;
-    vd->u = u;
-    vd->v = v;
-    vd->nx = nx;
-    vd->ny = ny;
-    vd->nz = nz;
-    vd->mtlid = 0;
-    vd->num_bindings = 0;
-    vd->weights = NULL;
-    vd->joints = NULL;
-    vd->force_hard = force_hard;
-
-    append_vdata_struct(vd);
+    vdata_arrays arr;
+    awd_float64 pos[3];
+    awd_float64 uv[2];
+    awd_float64 nrm[3];
+
+    pos[0] = x; pos[1] = y; pos[2] = z;
+    uv[0] = u; uv[1] = v;
+    nrm[0] = nx; nrm[1] = ny; nrm[2] = nz;
+
+    memset(&arr, 0, sizeof(vdata_arrays));
+    arr.num_verts = 1;
+    arr.indices = &idx;
+    arr.positions = pos;
+    arr.uvs = uv;
+    arr.normals = nrm;
+    arr.force_hard = &force_hard;
+
+    this->append_vert_arrays(&arr);
 }
 
 
+/**
+ * Append a vertex to the expanded geometry. Vertices allocated using
+ * alloc_vdata() are released along with the util. Any others must have
+ * been allocated using malloc(), as must their skinning arrays, and the
+ * util takes ownership of them (and frees them right away, since the
+ * data is copied.)
+*/
 void
 AWDGeomUtil::append_vdata_struct(vdata *vd)
 {
-	vd->first_normal_influence = NULL;
-	vd->last_normal_influence = NULL;
-	vd->out_idx = 0;
-	expanded->append_vdata(vd);
+    vdata_arrays arr;
+    awd_float64 pos[3];
+    awd_float64 uv[2];
+    awd_float64 nrm[3];
+
+    pos[0] = vd->x; pos[1] = vd->y; pos[2] = vd->z;
+    uv[0] = vd->u; uv[1] = vd->v;
+    nrm[0] = vd->nx; nrm[1] = vd->ny; nrm[2] = vd->nz;
+
+    memset(&arr, 0, sizeof(vdata_arrays));
+    arr.num_verts = 1;
+    arr.indices = &vd->orig_idx;
+    arr.positions = pos;
+    arr.uvs = uv;
+    arr.normals = nrm;
+    arr.force_hard = &vd->force_hard;
+    arr.num_bindings = vd->num_bindings;
+    arr.weights = vd->weights;
+    arr.joints = vd->joints;
+
+    this->append_vert_arrays(&arr);
+
+    if (!arena->owns(vd)) {
+        if (vd->num_bindings) {
+            free(vd->weights);
+            free(vd->joints);
+        }
 
-	if (vd->orig_idx > max_orig_idx)
-		max_orig_idx = vd->orig_idx;
+        free(vd);
+    }
 }
 
 
-static inline void
-add_unique_influence(vdata *vd, double nx, double ny, double nz)
+static void
+add_unique_influence(AWDArena *arena, ninfluence **first, const awd_float64 *n)
 {
-    if (!vd->first_normal_influence) {
-        ninfluence *inf = (ninfluence *)malloc(sizeof(ninfluence));
-        inf->nx = nx;
-        inf->ny = ny;
-        inf->nz = nz;
-        inf->next = NULL;
-        vd->first_normal_influence = inf;
-        vd->last_normal_influence = inf;
-    }
-    else {
-        ninfluence *cur;
-        ninfluence *inf;
+    ninfluence *cur;
+    ninfluence *inf;
 
-        cur = vd->first_normal_influence;
-        while (cur) {
-            if (cur->nx==nx && cur->ny==ny && cur->nz==nz)
+    cur = *first;
+    if (cur) {
+        while (1) {
+            if (cur->nx==n[0] && cur->ny==n[1] && cur->nz==n[2])
                 return;
 
+            if (!cur->next)
+                break;
+
             cur = cur->next;
         }
+    }
+
+    // If reached, no duplicates exist
+    inf = (ninfluence *)arena->alloc(sizeof(ninfluence));
+    inf->nx = n[0];
+    inf->ny = n[1];
+    inf->nz = n[2];
+    inf->next = NULL;
+
+    if (cur)
+        cur->next = inf;
+    else
+        *first = inf;
+}
+
+
+// Bits of a coordinate for hashing. Zeroes are folded together since
+// -0.0 and 0.0 compare equal, so that equal keys always hash equally.
+static inline awd_uint64
+weld_bits(double d)
+{
+    awd_uint64 bits;
+
+    if (d == 0.0)
+        d = 0.0;
 
-        // If reached, no duplicates exist
-        inf = (ninfluence *)malloc(sizeof(ninfluence));
-        inf->nx = nx;
-        inf->ny = ny;
-        inf->nz = nz;
-        inf->next = NULL;
-        vd->last_normal_influence->next = inf;
-        vd->last_normal_influence = inf;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+
+static inline awd_uint64
+weld_mix(awd_uint64 h, double d)
+{
+    h ^= weld_bits(d);
+    h *= 0x100000001b3ULL;
+    return h ^ (h >> 29);
+}
+
+
+bool
+AWDGeomUtil::weld_key_equal(unsigned int a, unsigned int b)
+{
+    const awd_float64 *pa, *pb;
+
+    if (this->vert_idx[a] != this->vert_idx[b])
+        return false;
+
+    pa = &this->vert_pos[a*3];
+    pb = &this->vert_pos[b*3];
+    if (pa[0] != pb[0] || pa[1] != pb[1] || pa[2] != pb[2])
+        return false;
+
+    if (this->include_uv) {
+        pa = &this->vert_uv[a*2];
+        pb = &this->vert_uv[b*2];
+        if (pa[0] != pb[0] || pa[1] != pb[1])
+            return false;
+    }
+
+    // With a threshold, normals are matched fuzzily in weld_part(),
+    // and hence can't be part of the key.
+    if (this->include_normals && this->normal_threshold <= 0) {
+        pa = &this->vert_nrm[a*3];
+        pb = &this->vert_nrm[b*3];
+        if (pa[0] != pb[0] || pa[1] != pb[1] || pa[2] != pb[2])
+            return false;
     }
+
+    return true;
 }
 
 
-int
-AWDGeomUtil::has_vert(vdata *vd)
+unsigned int
+AWDGeomUtil::weld_hash(unsigned int i)
 {
-    int idx;
-    vdata *cur;
-	VertexDataList *list;
+    awd_uint64 h;
 
-    // The list that is used for look-up is a list that only contains
-	// vertex data structs that originate from the same client vertex.
-	// Vertices that weren't the same in the client app should never
-	// be joined together, and this optimization stems from that fact.
-	list = per_idx_lists[vd->orig_idx];
+    h = 0xcbf29ce484222325ULL ^ this->vert_idx[i];
+    h = weld_mix(h, this->vert_pos[i*3+0]);
+    h = weld_mix(h, this->vert_pos[i*3+1]);
+    h = weld_mix(h, this->vert_pos[i*3+2]);
 
-    idx = 0;
-	list->iter_reset();
-	cur = list->iter_next();
-	while (cur) {
+    if (this->include_uv) {
+        h = weld_mix(h, this->vert_uv[i*2+0]);
+        h = weld_mix(h, this->vert_uv[i*2+1]);
+    }
+
+    if (this->include_normals && this->normal_threshold <= 0) {
+        h = weld_mix(h, this->vert_nrm[i*3+0]);
+        h = weld_mix(h, this->vert_nrm[i*3+1]);
+        h = weld_mix(h, this->vert_nrm[i*3+2]);
+    }
+
+    return (unsigned int)(h ^ (h >> 32));
+}
+
+
+/**
+ * Weld the vertices of a partition, in the order they were appended.
+ * For every vertex, this finds the earlier vertex whose output vertex
+ * it can share, if any, using an open-addressing hash table keyed on
+ * original index, position, UV and (unless smoothing) normal. Each slot
+ * holds the first vertex that created an output vertex with a given
+ * key (or -1), the rest are chained through vert_next in order.
+*/
+void
+AWDGeomUtil::weld_part(awd_geom_job *job)
+{
+    unsigned int n;
+    unsigned int mask;
+    unsigned int size;
+    int *table;
+    bool smooth;
+
+    smooth = (this->include_normals && this->normal_threshold > 0);
+
+    // Keep the table at most half full, which bounds the length of
+    // probe sequences so that welding stays linear in vertex count.
+    size = 16;
+    while (size < 2*job->num_verts)
+        size <<= 1;
+
+    mask = size - 1;
+    table = (int *)malloc(size * sizeof(int));
+    memset(table, 0xff, size * sizeof(int));
+
+    for (n=0; n<job->num_verts; n++) {
+        unsigned int i;
+        unsigned int s;
+        int *slot;
+        int cur;
+        const awd_float64 *vn;
+
+        i = job->verts[n];
+        vn = &this->vert_nrm[i*3];
 
         // If any of vertices have force_hard set, their normals must
-        // not be averaged. Hence, they must be returned by this 
-        // function as separate verts.
-        if (cur->force_hard || vd->force_hard)
-            goto next;
-
-        // If position doesn't match, move on to next vertex
-        if (cur->x != vd->x || cur->y != vd->y || cur->z != vd->z)
-            goto next;
-
-        // If UV coordinates do not match, move on to next vertex
-        if (this->include_uv) {
-            if (cur->u != vd->u || cur->v != vd->v)
-				goto next;
+        // not be averaged. Hence, they must be kept as separate verts.
+        // Vertices with force_hard set are never added to the table,
+        // so only this one needs checking.
+        if (this->vert_hard[i])
+            goto new_vert;
+
+        // The only candidates are vertices with the exact same key, i.e.
+        // that originate from the same client vertex, and have the same
+        // position and UV (and normal, unless using a threshold.)
+        s = this->weld_hash(i) & mask;
+        while (table[s] >= 0) {
+            if (this->weld_key_equal(table[s], i))
+                break;
+
+            s = (s+1) & mask;
         }
 
-        // Check if normals match (possibly with fuzzy matching using a
-        // threshold) and if they don't, move on to the next vertex.
-        if (this->include_normals) {
-            if (this->normal_threshold > 0) {
-                if (vd->nx==cur->nx && vd->ny==cur->ny && vd->nz==cur->nz) {
+        slot = &table[s];
+        cur = *slot;
+        while (cur >= 0) {
+
+            // Check if normals match using the threshold, and if they
+            // don't, move on to the next vertex. Exact matching of normals
+            // has already been taken care of by the key.
+            if (smooth) {
+                const awd_float64 *cn = &this->vert_nrm[cur*3];
+
+                if (vn[0]==cn[0] && vn[1]==cn[1] && vn[2]==cn[2]) {
                     // The exact same normals; avoid angle calculation
-                    add_unique_influence(cur, vd->nx, vd->ny, vd->nz);
+                    add_unique_influence(job->arena, &this->vert_influences[cur], vn);
                 }
                 else {
                     double angle;
                     double l0, l1;
 
                     // Calculate lenghts (usually 1.0)
-                    l0 = sqrt(cur->nx*cur->nx + cur->ny*cur->ny + cur->nz*cur->nz);
-                    l1 = sqrt(vd->nx*vd->nx + vd->ny*vd->ny + vd->nz*vd->nz);
+                    l0 = sqrt(cn[0]*cn[0] + cn[1]*cn[1] + cn[2]*cn[2]);
+                    l1 = sqrt(vn[0]*vn[0] + vn[1]*vn[1] + vn[2]*vn[2]);
 
                     // Calculate angle and compare to threshold
-                    angle = acos((cur->nx*vd->nx + cur->ny*vd->ny + cur->nz*vd->nz) / (l0*l1));
+                    angle = acos((cn[0]*vn[0] + cn[1]*vn[1] + cn[2]*vn[2]) / (l0*l1));
                     if (angle <= this->normal_threshold) {
-                        add_unique_influence(cur, vd->nx, vd->ny, vd->nz);
+                        add_unique_influence(job->arena, &this->vert_influences[cur], vn);
                     }
                     else {
-                        goto next;
+                        slot = &this->vert_next[cur];
+                        cur = *slot;
+                        continue;
                     }
                 }
             }
-            else if (cur->nx != vd->nx || cur->ny != vd->ny || cur->nz != vd->nz)
-                goto next;
-		}
 
-        // Important: Don't put any more tests here after the normal test, which
-        // needs to come last since it will add normal influences, which should
-        // not be included unless the vertex matches.
+            // Made it here? Then vertices match!
+            break;
+        }
+
+        if (cur >= 0) {
+            this->vert_src[i] = cur;
+            continue;
+        }
 
-        // Made it here? Then vertices match!
-        return cur->out_idx;
+        // No match, so the vertex is appended last in its chain
+        // (slot now points at the end of it.)
+        *slot = i;
 
-next:
-        idx++;
-		cur = list->iter_next();
+new_vert:
+        this->vert_src[i] = i;
+        this->vert_next[i] = -1;
+        this->vert_influences[i] = NULL;
+
+        // This is the first time that this vertex is encountered,
+        // so it's own influence needs to be added.
+        if (smooth)
+            add_unique_influence(job->arena, &this->vert_influences[i], vn);
     }
 
-    // This is the first time that this vertex is encountered,
-    // so it's own influence needs to be added.
-    add_unique_influence(vd, vd->nx, vd->ny, vd->nz);
+    free(table);
+}
+
 
-    return -1;
+// Count the output vertices and binding values of a range
+void
+AWDGeomUtil::count_range(awd_geom_job *job)
+{
+    unsigned int i;
+
+    job->num_out = 0;
+    job->num_bind_vals = 0;
+    for (i=job->first; i<job->end; i++) {
+        if (this->vert_src[i] == (int)i)
+            job->num_out++;
+
+        job->num_bind_vals += this->vert_num_bindings[i];
+    }
 }
 
 
+// Assign output indices to the vertices of a range that created an
+// output vertex, and write their data to the output streams.
 void
-AWDGeomUtil::prepare_build()
+AWDGeomUtil::output_range(awd_geom_job *job)
 {
-	int i;
-	
-	num_idx_lists = this->max_orig_idx + 1;
+    unsigned int i;
+    unsigned int o;
+    unsigned int b_idx;
+    int jpv;
+
+    jpv = this->joints_per_vertex;
+    o = job->first_out;
+    b_idx = job->first_bind;
 
-	per_idx_lists = (VertexDataList**)malloc(num_idx_lists * sizeof(VertexDataList *));
-	for (i=0; i<num_idx_lists; i++) {
-		per_idx_lists[i] = new VertexDataList();
+    for (i=job->first; i<job->end; i++) {
+        int num_bindings = this->vert_num_bindings[i];
+
+        if (this->vert_src[i] == (int)i) {
+            const awd_float64 *pos = &this->vert_pos[i*3];
+
+            this->vert_out[i] = o;
+
+            this->out_pos[o*3+0] = (awd_float32)pos[0];
+            this->out_pos[o*3+1] = (awd_float32)pos[1];
+            this->out_pos[o*3+2] = (awd_float32)pos[2];
+
+            if (this->include_uv) {
+                this->out_uv[o*2+0] = (awd_float32)this->vert_uv[i*2+0];
+                this->out_uv[o*2+1] = (awd_float32)this->vert_uv[i*2+1];
+            }
+
+            if (this->include_normals) {
+                // Smoothing (averaging of normals) required?
+                if (this->normal_threshold > 0) {
+                    int num_influences;
+                    double nx, ny, nz;
+                    ninfluence *inf;
+
+                    nx = ny = nz = 0.0;
+                    num_influences = 0;
+                    inf = this->vert_influences[i];
+                    while (inf) {
+                        nx += inf->nx;
+                        ny += inf->ny;
+                        nz += inf->nz;
+                        inf = inf->next;
+                        num_influences++;
+                    }
+
+                    this->out_nrm[o*3+0] = (awd_float32)(nx / num_influences);
+                    this->out_nrm[o*3+1] = (awd_float32)(ny / num_influences);
+                    this->out_nrm[o*3+2] = (awd_float32)(nz / num_influences);
+                }
+                else {
+                    this->out_nrm[o*3+0] = (awd_float32)this->vert_nrm[i*3+0];
+                    this->out_nrm[o*3+1] = (awd_float32)this->vert_nrm[i*3+1];
+                    this->out_nrm[o*3+2] = (awd_float32)this->vert_nrm[i*3+2];
+                }
+            }
+
+            // If there are bindings, transfer them from the
+            // binding arrays to output streams.
+            if (num_bindings>0 && jpv>0) {
+                int w_idx;
+                for (w_idx=0; w_idx<jpv && w_idx<num_bindings; w_idx++) {
+                    this->out_weights[o*jpv + w_idx] = (awd_float32)this->bind_weights[b_idx + w_idx];
+                    this->out_joints[o*jpv + w_idx] = (awd_uint16)this->bind_joints[b_idx + w_idx];
+                }
+            }
+
+            o++;
+        }
+
+        b_idx += num_bindings;
+    }
+}
+
+
+// Write the triangle indices of a range, once all vertices have
+// been assigned their output index.
+void
+AWDGeomUtil::index_range(awd_geom_job *job)
+{
+    unsigned int i;
+
+    for (i=job->first; i<job->end; i++)
+        this->out_tris[i] = this->vert_out[this->vert_src[i]];
+}
+
+
+void
+AWDGeomUtil::prepare_build(int threads)
+{
+	int p;
+	unsigned int i;
+	unsigned int start;
+	unsigned int *offsets;
+
+	this->end_build();
+
+	vert_src = (int*)malloc(num_verts * sizeof(int));
+	vert_next = (int*)malloc(num_verts * sizeof(int));
+	vert_influences = (ninfluence**)malloc(num_verts * sizeof(ninfluence *));
+	vert_out = (int*)malloc(num_verts * sizeof(int));
+
+	// Sort vertices into partitions by original index, keeping them in
+	// order within each partition. Output doesn't depend on the number
+	// of partitions, since vertices in different partitions are never
+	// joined, and within a partition they are processed in order.
+	num_parts = (threads > 1)? threads * AWD_GEOM_PARTS_PER_THREAD : 1;
+	part_verts = (unsigned int*)malloc(num_verts * sizeof(unsigned int));
+	part_jobs = (awd_geom_job*)calloc(num_parts, sizeof(awd_geom_job));
+	offsets = (unsigned int*)calloc(num_parts, sizeof(unsigned int));
+
+	for (i=0; i<num_verts; i++)
+		part_jobs[vert_idx[i] % num_parts].num_verts++;
+
+	start = 0;
+	for (p=0; p<num_parts; p++) {
+		part_jobs[p].util = this;
+		part_jobs[p].phase = AWD_GEOM_WELD;
+		part_jobs[p].verts = &part_verts[start];
+		part_jobs[p].arena = new AWDArena();
+		offsets[p] = start;
+		start += part_jobs[p].num_verts;
 	}
+
+	for (i=0; i<num_verts; i++)
+		part_verts[offsets[vert_idx[i] % num_parts]++] = i;
+
+	free(offsets);
+}
+
+
+void
+AWDGeomUtil::end_build()
+{
+	int p;
+
+	for (p=0; p<num_parts; p++)
+		delete part_jobs[p].arena;
+
+	free(part_jobs);
+	free(part_verts);
+	free(vert_src);
+	free(vert_next);
+	free(vert_influences);
+	free(vert_out);
+
+	num_parts = 0;
+	part_jobs = NULL;
+	part_verts = NULL;
+	vert_src = NULL;
+	vert_next = NULL;
+	vert_influences = NULL;
+	vert_out = NULL;
 }
 
 
-int 
+int
 AWDGeomUtil::build_geom(AWDTriGeom *md)
 {
-    vdata *vd;
     AWDSubGeom *sub;
-    AWD_field_type tri_str_type;
 
+    int p;
+    int threads;
+    int num_ranges;
+    unsigned int i;
+    unsigned int num_out;
+    unsigned int num_bind_vals;
+    awd_geom_job *ranges;
+    void **job_ptrs;
     int v_idx, i_idx;
-    AWD_str_ptr v_str;
-    AWD_str_ptr i_str;
-    AWD_str_ptr n_str;
-    AWD_str_ptr u_str;
-    AWD_str_ptr w_str;
-    AWD_str_ptr j_str;
 
-	int num_exp = expanded->get_num_items();
+	int num_exp = this->num_verts;
 
-    sub = new AWDSubGeom();
-    v_str.f64 = (awd_float64*) malloc(sizeof(awd_float64) * 3 * num_exp);
-    i_str.ui32 = (awd_uint32*) malloc(sizeof(awd_uint32) * num_exp);
+    // Streams are built in the type they are written in, i.e. float32
+    // for all vertex data and uint16 joint indices. Triangle indices are
+    // narrowed to uint16 when done, if the vertex count allows.
+    out_nrm = out_uv = out_weights = NULL;
+    out_joints = NULL;
+    out_pos = (awd_float32*) malloc(sizeof(awd_float32) * 3 * num_exp);
+    out_tris = (awd_uint32*) malloc(sizeof(awd_uint32) * num_exp);
 
-    if (this->include_normals) 
-        n_str.f64 = (awd_float64*) malloc(sizeof(awd_float64) * 3 * num_exp);
+    if (this->include_normals)
+        out_nrm = (awd_float32*) malloc(sizeof(awd_float32) * 3 * num_exp);
 
     if (this->include_uv)
-        u_str.f64 = (awd_float64*) malloc(sizeof(awd_float64) * 2 * num_exp);
+        out_uv = (awd_float32*) malloc(sizeof(awd_float32) * 2 * num_exp);
 
     if (this->joints_per_vertex > 0) {
         int max_num_vals = num_exp * this->joints_per_vertex;
-        w_str.f64 = (awd_float64*) malloc(sizeof(awd_float64) * max_num_vals);
-        j_str.ui32 = (awd_uint32*) malloc(sizeof(awd_uint32) * max_num_vals);
+        out_weights = (awd_float32*) malloc(sizeof(awd_float32) * max_num_vals);
+        out_joints = (awd_uint16*) malloc(sizeof(awd_uint16) * max_num_vals);
 
-        memset(w_str.v, 0, max_num_vals * sizeof(awd_float64));
-        memset(j_str.v, 0, max_num_vals * sizeof(awd_uint32));
+        memset(out_weights, 0, max_num_vals * sizeof(awd_float32));
+        memset(out_joints, 0, max_num_vals * sizeof(awd_uint16));
     }
 
-	// Prebuild a lookup list of vertices by their original index, so that
-	// has_vert() can check only those vertices that used to be the same
-	// client vertex, instead of looping over them all.
-	prepare_build();
-
-    v_idx = i_idx = 0;
-
-	expanded->iter_reset();
-	vd = expanded->iter_next();
-	while (vd) {
-        int idx = this->has_vert(vd);
-        if (idx >= 0) {
-            i_str.ui32[i_idx++] = idx;
-        }
-        else {
-            v_str.f64[v_idx*3+0] = vd->x;
-            v_str.f64[v_idx*3+1] = vd->y;
-            v_str.f64[v_idx*3+2] = vd->z;
+    threads = awdthread_resolve_count(this->num_threads);
+    prepare_build(threads);
+
+    // Weld partitions, possibly in parallel
+    job_ptrs = (void**)malloc(num_parts * sizeof(void *));
+    for (p=0; p<num_parts; p++)
+        job_ptrs[p] = &part_jobs[p];
+
+    awdthread_run_jobs(awdgeom_run_job, job_ptrs, num_parts, threads);
+    free(job_ptrs);
+
+    // Output is produced in ranges of expanded vertices. Output indices
+    // are assigned in the order vertices were appended, using the sums
+    // of output vertices (and bindings) in all preceding ranges, so
+    // that they are the same whatever the number of threads.
+    num_ranges = num_parts;
+    ranges = (awd_geom_job*)calloc(num_ranges, sizeof(awd_geom_job));
+    job_ptrs = (void**)malloc(num_ranges * sizeof(void *));
+    for (p=0; p<num_ranges; p++) {
+        ranges[p].util = this;
+        ranges[p].phase = AWD_GEOM_COUNT;
+        ranges[p].first = (unsigned int)((awd_uint64)num_verts * p / num_ranges);
+        ranges[p].end = (unsigned int)((awd_uint64)num_verts * (p+1) / num_ranges);
+        job_ptrs[p] = &ranges[p];
+    }
 
-            if (this->include_uv) {
-                u_str.f64[v_idx*2+0] = vd->u;
-                u_str.f64[v_idx*2+1] = vd->v;
-            }
+    awdthread_run_jobs(awdgeom_run_job, job_ptrs, num_ranges, threads);
 
-            if (this->include_normals) {
-                n_str.f64[v_idx*3+0] = vd->nx;
-                n_str.f64[v_idx*3+1] = vd->ny;
-                n_str.f64[v_idx*3+2] = vd->nz;
-            }
+    num_out = 0;
+    num_bind_vals = 0;
+    for (p=0; p<num_ranges; p++) {
+        ranges[p].phase = AWD_GEOM_OUTPUT;
+        ranges[p].first_out = num_out;
+        ranges[p].first_bind = num_bind_vals;
+        num_out += ranges[p].num_out;
+        num_bind_vals += ranges[p].num_bind_vals;
+    }
 
-            // If there are bindings, transfer them from 
-            // array in vdata struct to output streams.
-            if (vd->num_bindings>0) {
-                int w_idx;
-                int jpv = vd->num_bindings;
-                for (w_idx=0; w_idx<jpv; w_idx++) {
-                    w_str.f64[v_idx*jpv + w_idx] = vd->weights[w_idx];
-                    j_str.ui32[v_idx*jpv + w_idx] = vd->joints[w_idx];
-                }
-            }
+    awdthread_run_jobs(awdgeom_run_job, job_ptrs, num_ranges, threads);
 
-			vd->out_idx = v_idx;
-            i_str.ui32[i_idx++] = v_idx++;
+    for (p=0; p<num_ranges; p++)
+        ranges[p].phase = AWD_GEOM_INDEX;
 
-			collapsed->append_vdata(vd);
-			per_idx_lists[vd->orig_idx]->append_vdata(vd);
-        }
+    awdthread_run_jobs(awdgeom_run_job, job_ptrs, num_ranges, threads);
 
-		vd = expanded->iter_next();
-    }
+    free(job_ptrs);
+    free(ranges);
 
-    // Smoothing (averaging of normals) required?
-    if (this->normal_threshold > 0) {
-		collapsed->iter_reset();
-		vd = collapsed->iter_next();
-		while (vd) {
-            int num_influences;
-            double nx, ny, nz;
-            ninfluence *inf;
-
-            nx = ny = nz = 0.0;
-            num_influences = 0;
-            inf = vd->first_normal_influence;
-            while (inf) {
-                nx += inf->nx;
-                ny += inf->ny;
-                nz += inf->nz;
-                inf = inf->next;
-                num_influences++;
-            }
+    end_build();
 
-            n_str.f64[vd->out_idx*3+0] = nx / num_influences;
-            n_str.f64[vd->out_idx*3+1] = ny / num_influences;
-            n_str.f64[vd->out_idx*3+2] = nz / num_influences;
+    v_idx = num_out;
+    i_idx = num_exp;
 
-			vd = collapsed->iter_next();
-        }
+    // Triangles are output in the order they were appended, which is
+    // optionally changed to make better use of the vertex cache.
+    awdvcache_measure(out_tris, i_idx, v_idx, this->vertex_cache_size, &this->vcache_before);
+    if (this->optimize_vertex_cache) {
+        awdvcache_optimize(out_tris, i_idx, v_idx, this->vertex_cache_size);
+        awdvcache_measure(out_tris, i_idx, v_idx, this->vertex_cache_size, &this->vcache_after);
+    }
+    else {
+        this->vcache_after = this->vcache_before;
     }
 
     // Reallocate the vertex buffer using final length after vertices were
-    // joined. There's no need to reallocate the index buffer since the 
+    // joined. There's no need to reallocate the index buffer since the
     // triangle count will not have changed.
-    v_str.v = realloc(v_str.v, sizeof(awd_float64) * 3 * v_idx);
+    out_pos = (awd_float32*) realloc(out_pos, sizeof(awd_float32) * 3 * v_idx);
+
+    sub = new AWDSubGeom();
+    sub->add_stream(new AWDTypedStream<awd_float32>(VERTICES, out_pos, v_idx*3));
 
     // Choose stream type for the triangle stream depending on whether
     // all vertex indices can be represented by an uint16 or not.
-    tri_str_type = (v_idx > 0xffff)? AWD_FIELD_UINT32 : AWD_FIELD_UINT16;
+    if (v_idx > 0xffff) {
+        sub->add_stream(new AWDTypedStream<awd_uint32>(TRIANGLES, out_tris, i_idx));
+    }
+    else {
+        awd_uint16 *i16_str;
 
-    sub = new AWDSubGeom();
-    sub->add_stream(VERTICES, AWD_FIELD_FLOAT32, v_str, v_idx*3);
-    sub->add_stream(TRIANGLES, tri_str_type, i_str, i_idx);
+        i16_str = (awd_uint16*) malloc(sizeof(awd_uint16) * i_idx);
+        for (i=0; i<(unsigned int)i_idx; i++)
+            i16_str[i] = (awd_uint16)out_tris[i];
+
+        free(out_tris);
+        sub->add_stream(new AWDTypedStream<awd_uint16>(TRIANGLES, i16_str, i_idx));
+    }
 
     if (this->include_normals) {
         // Reallocate buffer using actual length and add to sub-geom
-        n_str.v = realloc(n_str.v, sizeof(awd_float64) * 3 * v_idx);
-        sub->add_stream(VERTEX_NORMALS, AWD_FIELD_FLOAT32, n_str, v_idx*3);
+        out_nrm = (awd_float32*) realloc(out_nrm, sizeof(awd_float32) * 3 * v_idx);
+        sub->add_stream(new AWDTypedStream<awd_float32>(VERTEX_NORMALS, out_nrm, v_idx*3));
     }
 
     if (this->include_uv) {
         // Reallocate buffer using actual length and add to sub-geom
-        u_str.v = realloc(u_str.v, sizeof(awd_float64) * 2 * v_idx);
-        sub->add_stream(UVS, AWD_FIELD_FLOAT32, u_str, v_idx*2);
+        out_uv = (awd_float32*) realloc(out_uv, sizeof(awd_float32) * 2 * v_idx);
+        sub->add_stream(new AWDTypedStream<awd_float32>(UVS, out_uv, v_idx*2));
     }
 
     if (this->joints_per_vertex > 0) {
         // Reallocate buffers using actual length and add to sub-geom
-        w_str.v = realloc(w_str.v, sizeof(awd_float64) * v_idx * this->joints_per_vertex);
-        j_str.v = realloc(j_str.v, sizeof(awd_uint32) * v_idx * this->joints_per_vertex);
-        sub->add_stream(VERTEX_WEIGHTS, AWD_FIELD_FLOAT32, w_str, v_idx*this->joints_per_vertex);
-        sub->add_stream(JOINT_INDICES, AWD_FIELD_UINT16, j_str, v_idx*this->joints_per_vertex);
+        out_weights = (awd_float32*) realloc(out_weights, sizeof(awd_float32) * v_idx * this->joints_per_vertex);
+        out_joints = (awd_uint16*) realloc(out_joints, sizeof(awd_uint16) * v_idx * this->joints_per_vertex);
+        sub->add_stream(new AWDTypedStream<awd_float32>(VERTEX_WEIGHTS, out_weights, v_idx*this->joints_per_vertex));
+        sub->add_stream(new AWDTypedStream<awd_uint16>(JOINT_INDICES, out_joints, v_idx*this->joints_per_vertex));
     }
 
+    // Streams are owned by the sub-geom from here on
+    out_pos = out_uv = out_nrm = out_weights = NULL;
+    out_joints = NULL;
+    out_tris = NULL;
+
     md->add_sub_mesh(sub);
 
     return 1;
 }
-
-
@@ -10,6 +10,11 @@ AWDLight::AWDLight(const char *name, awd_uint16 name_len, AWD_light_type type) :
 }
 
 
+AWDLight::~AWDLight()
+{
+}
+
+
 void
 AWDLight::prepare_write()
 {
@@ -27,11 +32,11 @@ AWDLight::calc_body_length(bool wide_mtx)
 
 
 void
-AWDLight::write_body(int fd, bool wide_mtx)
+AWDLight::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    this->write_scene_common(fd, wide_mtx);
-    write(fd, &this->type, sizeof(awd_uint8));
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->write_scene_common(out, wide_mtx);
+    out->put_ui8((awd_uint8)this->type);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
@@ -140,21 +140,21 @@ AWDMaterial::prepare_write()
 
 
 void
-AWDMaterial::write_body(int fd, bool wide_mtx)
+AWDMaterial::write_body(AWDOutputStream *out, bool wide_mtx)
 {
     AWD_mat_method *cur;
 
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-    write(fd, &this->type, sizeof(awd_uint8));
-    write(fd, &this->num_methods, sizeof(awd_uint8));
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_ui8((awd_uint8)this->type);
+    out->put_ui8(this->num_methods);
 
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     cur = this->first_method;
     while (cur) {
-        cur->method->write_method(fd, wide_mtx);
+        cur->method->write_method(out, wide_mtx);
         cur = cur->next;
     }
 
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
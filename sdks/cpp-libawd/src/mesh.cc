@@ -66,11 +66,28 @@ AWDSubGeom::get_stream_at(unsigned int idx)
 
 void 
 AWDSubGeom::add_stream(AWD_mesh_str_type type, AWD_field_type data_type, AWD_str_ptr data, awd_uint32 num_elements)
+{
+    this->add_stream(new AWDGeomDataStream((awd_uint8)type, data_type, data, num_elements));
+}
+
+
+void
+AWDSubGeom::add_stream(AWD_mesh_str_type type, AWD_field_type data_type, AWD_str_ptr data, awd_uint32 num_elements,
+    awd_release_func release_func, void *release_arg)
 {
     AWDDataStream *str;
 
+    // Data stays owned by the caller, see AWDDataStream
     str = new AWDGeomDataStream((awd_uint8)type, data_type, data, num_elements);
+    str->set_release_func(release_func, release_arg);
+    this->add_stream(str);
+}
+
 
+void
+AWDSubGeom::add_stream(AWDDataStream *str)
+{
+    // Sub-geometry takes ownership of the stream
     if (this->first_stream == NULL) {
         this->first_stream = str;
     }
@@ -115,26 +132,22 @@ AWDSubGeom::calc_sub_length(bool wide_mtx)
 
 
 void
-AWDSubGeom::write_sub(int fd, bool wide_mtx)
+AWDSubGeom::write_sub(AWDOutputStream *out, bool wide_mtx)
 {
     AWDDataStream *str;
-    awd_uint32 sub_len;
-
-    // Verify byte-order
-    sub_len = UI32(this->calc_streams_length());
 
     // Write sub-mesh header
-    write(fd, &sub_len, sizeof(awd_uint32));
+    out->put_ui32(this->calc_streams_length());
 
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     str = this->first_stream;
     while(str) {
-        str->write_stream(fd);
+        str->write_stream(out);
         str = str->next;
     }
 
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -256,28 +269,26 @@ AWDTriGeom::calc_body_length(bool wide_mtx)
 
 
 void
-AWDTriGeom::write_body(int fd, bool wide_mtx)
+AWDTriGeom::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint16 num_subs_be;
     AWDSubGeom *sub;
 
     // Write name and sub count
-    num_subs_be = UI16(this->num_subs);
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length()); 
-    write(fd, &num_subs_be, sizeof(awd_uint16));
+    out->put_varstr(this->get_name(), this->get_name_length()); 
+    out->put_ui16(this->num_subs);
 
     // Write list of optional properties
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     // Write all sub-meshes
     sub = this->first_sub;
     while (sub) {
-        sub->write_sub(fd, wide_mtx);
+        sub->write_sub(out, wide_mtx);
         sub = sub->next;
     }
     
     // Write list of user attributes
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -337,32 +348,29 @@ AWDMeshInst::calc_body_length(bool wide_mtx)
 
 
 void
-AWDMeshInst::write_body(int fd, bool wide_mtx)
+AWDMeshInst::write_body(AWDOutputStream *out, bool wide_mtx)
 {
     AWDBlock *block;
     AWDBlockIterator *it;
     awd_baddr geom_addr;
-    awd_uint16 num_materials;
 
-    this->write_scene_common(fd, wide_mtx);
+    this->write_scene_common(out, wide_mtx);
 
     // Write mesh geom address (can be NULL)
     geom_addr = 0;
     if (this->geom != NULL)
-        geom_addr = UI32(this->geom->get_addr());
-    write(fd, &geom_addr, sizeof(awd_uint32));
+        geom_addr = this->geom->get_addr();
+    out->put_ui32(geom_addr);
 
     // Write materials list. First write material count, and then
     // iterate over materials block list and write all addresses
     printf("material count: %d\n", this->materials->get_num_blocks());
-    num_materials = UI16((awd_uint16)this->materials->get_num_blocks());
-    write(fd, &num_materials, sizeof(awd_uint16));
+    out->put_ui16((awd_uint16)this->materials->get_num_blocks());
     it = new AWDBlockIterator(this->materials);
     while ((block = it->next()) != NULL) {
-        awd_baddr addr = UI32(block->get_addr());
-        write(fd, &addr, sizeof(awd_baddr));
+        out->put_ui32(block->get_addr());
     }
 
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
@@ -46,8 +46,8 @@ AWDMetaData::calc_body_length(bool wide_mtx)
 
 
 void
-AWDMetaData::write_body(int fd, bool wide_mtx)
+AWDMetaData::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 }
 
@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include "nameidx.h"
+#include "name.h"
+#include "util.h"
+
+#include "platform.h"
+
+
+AWDNameIndexBlock::AWDNameIndexBlock() :
+    AWDBlock(NAME_INDEX)
+{
+    this->entries = NULL;
+    this->num_entries = 0;
+    this->max_entries = 0;
+}
+
+
+AWDNameIndexBlock::~AWDNameIndexBlock()
+{
+    if (this->entries) {
+        free(this->entries);
+        this->entries = NULL;
+    }
+}
+
+
+void
+AWDNameIndexBlock::add_entry(AWDBlock *block, awd_uint64 offset)
+{
+    AWD_name_index_entry *entry;
+    AWDNamedElement *named;
+    awd_uint64 hash;
+
+    // Only named blocks can be looked up by name
+    named = dynamic_cast<AWDNamedElement *>(block);
+    if (!named)
+        return;
+
+    hash = awdutil_hash_name(named->get_name(), named->get_name_length());
+    if (hash == 0)
+        return;
+
+    if (this->num_entries == this->max_entries) {
+        this->max_entries = this->max_entries? 2*this->max_entries : 64;
+        this->entries = (AWD_name_index_entry *)realloc(this->entries,
+            this->max_entries * sizeof(AWD_name_index_entry));
+    }
+
+    entry = &this->entries[this->num_entries++];
+    entry->name_hash = hash;
+    entry->addr = block->get_addr();
+    entry->offset = offset;
+}
+
+
+awd_uint32
+AWDNameIndexBlock::get_num_entries()
+{
+    return this->num_entries;
+}
+
+
+static int
+awd_compare_name_entries(const void *a, const void *b)
+{
+    const AWD_name_index_entry *ea = (const AWD_name_index_entry *)a;
+    const AWD_name_index_entry *eb = (const AWD_name_index_entry *)b;
+
+    if (ea->name_hash != eb->name_hash)
+        return (ea->name_hash < eb->name_hash)? -1 : 1;
+    if (ea->addr != eb->addr)
+        return (ea->addr < eb->addr)? -1 : 1;
+    return 0;
+}
+
+
+awd_uint32
+AWDNameIndexBlock::calc_body_length(bool wide_mtx)
+{
+    return sizeof(awd_uint32) + this->num_entries * AWD_NAME_INDEX_ENTRY_LENGTH;
+}
+
+
+void
+AWDNameIndexBlock::write_body(AWDOutputStream *out, bool wide_mtx)
+{
+    awd_uint32 i;
+
+    if (this->num_entries > 1)
+        qsort(this->entries, this->num_entries, sizeof(AWD_name_index_entry), awd_compare_name_entries);
+
+    out->put_ui32(this->num_entries);
+    for (i=0; i<this->num_entries; i++) {
+        AWD_name_index_entry *entry = &this->entries[i];
+
+        out->put_ui64(entry->name_hash);
+        out->put_ui32(entry->addr);
+        out->put_ui64(entry->offset);
+    }
+}
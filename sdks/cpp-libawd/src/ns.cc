@@ -48,8 +48,8 @@ AWDNamespace::calc_body_length(bool wide_mtx)
 
 
 void 
-AWDNamespace::write_body(int fd, bool wide_mtx)
+AWDNamespace::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    write(fd, &(this->handle), sizeof(awd_nsid));
-    awdutil_write_varstr(fd, this->uri, this->uri_len);
+    out->put_ui8(this->handle);
+    out->put_varstr(this->uri, this->uri_len);
 }
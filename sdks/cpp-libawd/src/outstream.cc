@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "outstream.h"
+#include "awd_types.h"
+
+
+AWDOutputStream::AWDOutputStream(AWDSink *sink)
+{
+    this->sink = sink;
+    this->buf_size = AWD_OSTREAM_BUFSIZE;
+    this->buf = (awd_uint8 *)malloc(this->buf_size);
+    this->buf_len = 0;
+    this->num_drained = 0;
+}
+
+
+AWDOutputStream::AWDOutputStream(AWDSink *sink, size_t buf_size)
+{
+    // Buffer must at least fit the largest scalar
+    if (buf_size < sizeof(awd_float64))
+        buf_size = sizeof(awd_float64);
+
+    this->sink = sink;
+    this->buf_size = buf_size;
+    this->buf = (awd_uint8 *)malloc(this->buf_size);
+    this->buf_len = 0;
+    this->num_drained = 0;
+}
+
+
+AWDOutputStream::~AWDOutputStream()
+{
+    this->drain();
+    free(this->buf);
+    this->buf = NULL;
+}
+
+
+AWDSink *
+AWDOutputStream::get_sink()
+{
+    return this->sink;
+}
+
+
+size_t
+AWDOutputStream::get_position()
+{
+    return this->num_drained + this->buf_len;
+}
+
+
+void
+AWDOutputStream::drain()
+{
+    if (this->buf_len > 0) {
+        this->sink->write_bytes(this->buf, this->buf_len);
+        this->num_drained += this->buf_len;
+        this->buf_len = 0;
+    }
+}
+
+
+void
+AWDOutputStream::flush()
+{
+    this->drain();
+}
+
+
+void
+AWDOutputStream::put_bytes_slow(const void *data, size_t len)
+{
+    // Data does not fit in what remains of the buffer. Empty the
+    // buffer, and then either buffer the new data or, if it's larger
+    // than the entire buffer, pass it straight on to the sink.
+    this->drain();
+
+    if (len < this->buf_size) {
+        memcpy(this->buf, data, len);
+        this->buf_len = len;
+    }
+    else {
+        this->sink->write_bytes(data, len);
+        this->num_drained += len;
+    }
+}
+
+
+void
+AWDOutputStream::put_varstr(const char *str, awd_uint16 str_len)
+{
+    if (str != NULL) {
+        this->put_ui16(str_len);
+        this->put_bytes(str, str_len);
+    }
+    else {
+        this->put_ui16(0);
+    }
+}
+
+
+void
+AWDOutputStream::put_floats(const awd_float64 *list, size_t num, bool wide)
+{
+    if (wide)
+        this->put_array<awd_float64>(list, num);
+    else
+        this->put_array<awd_float32>(list, num);
+}
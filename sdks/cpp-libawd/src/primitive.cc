@@ -28,11 +28,11 @@ AWDPrimitive::calc_body_length(bool wide_mtx)
 }
 
 void
-AWDPrimitive::write_body(int fd, bool wide_mtx)
+AWDPrimitive::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    write(fd, &this->type, sizeof(awd_uint8));
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    out->put_ui8((awd_uint8)this->type);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
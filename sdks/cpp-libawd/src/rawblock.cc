@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include "rawblock.h"
+
+#include "platform.h"
+
+
+AWDRawBlock::AWDRawBlock(AWD_block_type type, const char *name, awd_uint16 name_len,
+    const awd_uint8 *body, awd_uint32 body_len, bool own_body) :
+    AWDBlock(type),
+    AWDNamedElement(name, name_len)
+{
+    // Body is only freed with the block if owned
+    this->body = body;
+    this->body_len = body_len;
+    this->own_body = own_body;
+}
+
+
+AWDRawBlock::~AWDRawBlock()
+{
+    if (this->own_body && this->body) {
+        free((void *)this->body);
+        this->body = NULL;
+    }
+}
+
+
+const awd_uint8 *
+AWDRawBlock::get_body(awd_uint32 *len)
+{
+    *len = this->body_len;
+    return this->body;
+}
+
+
+awd_uint32
+AWDRawBlock::calc_body_length(bool wide_mtx)
+{
+    return this->body_len;
+}
+
+
+void
+AWDRawBlock::write_body(AWDOutputStream *out, bool wide_mtx)
+{
+    out->put_bytes(this->body, this->body_len);
+}
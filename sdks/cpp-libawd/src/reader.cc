@@ -0,0 +1,1223 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "reader.h"
+#include "awd.h"
+#include "decompress.h"
+#include "thread.h"
+#include "util.h"
+
+#include "platform.h"
+
+
+static bool
+awd_get_list(AWDCursor *cur, AWD_data_view *view)
+{
+    // Attribute lists are prefixed by their length
+    view->length = cur->get_ui32();
+    view->data = cur->get_bytes(view->length);
+
+    return !cur->has_error();
+}
+
+
+const char *
+awdreader_get_block_name(AWD_block_type type, AWD_data_view body, awd_uint16 *len)
+{
+    const char *name;
+    AWDCursor cur(body.data, body.length);
+
+    // TODO: Don't hard-code (see AWDBlock::write_block)
+    bool wide_mtx = false;
+
+    switch (type) {
+        case TRI_GEOM:
+        case SKELETON:
+        case SKELETON_POSE:
+        case SKELETON_ANIM:
+        case SIMPLE_MATERIAL:
+        case BITMAP_TEXTURE:
+        case CUBE_TEXTURE:
+        case UV_ANIM:
+            // Name is the first field
+            break;
+
+        case SCENE:
+        case CONTAINER:
+        case MESH_INSTANCE:
+        case LIGHT:
+        case CAMERA:
+            // Name follows parent address and transform, as
+            // written by AWDSceneBlock::write_scene_common()
+            cur.get_bytes(sizeof(awd_baddr) + 12 * (wide_mtx? sizeof(awd_float64) : sizeof(awd_float32)));
+            break;
+
+        default:
+            *len = 0;
+            return NULL;
+    }
+
+    name = cur.get_varstr(len);
+    if (cur.has_error()) {
+        *len = 0;
+        return NULL;
+    }
+
+    return name;
+}
+
+
+
+AWDAttrIterator::AWDAttrIterator(AWD_data_view list, bool user) :
+    cur(list.data, list.length)
+{
+    this->user = user;
+}
+
+
+bool
+AWDAttrIterator::next(AWD_attr_view *attr)
+{
+    if (this->cur.get_remaining() == 0 || this->cur.has_error())
+        return false;
+
+    if (this->user) {
+        attr->key = 0;
+        attr->ns = this->cur.get_ui8();
+        attr->name = this->cur.get_varstr(&attr->name_len);
+        attr->type = (AWD_field_type)this->cur.get_ui8();
+    }
+    else {
+        // Type of properties is implied by their key
+        attr->key = this->cur.get_ui16();
+        attr->ns = 0;
+        attr->name = NULL;
+        attr->name_len = 0;
+        attr->type = (AWD_field_type)0;
+    }
+
+    attr->value.length = this->cur.get_ui32();
+    attr->value.data = this->cur.get_bytes(attr->value.length);
+
+    return !this->cur.has_error();
+}
+
+
+bool
+AWDAttrIterator::has_error()
+{
+    return this->cur.has_error();
+}
+
+
+
+AWDStreamIterator::AWDStreamIterator(AWD_data_view streams) :
+    cur(streams.data, streams.length)
+{
+}
+
+
+bool
+AWDStreamIterator::next(AWD_stream_view *str)
+{
+    if (this->cur.get_remaining() == 0 || this->cur.has_error())
+        return false;
+
+    str->type = this->cur.get_ui8();
+    str->data_type = (AWD_field_type)this->cur.get_ui8();
+    str->data.length = this->cur.get_ui32();
+    str->data.data = this->cur.get_bytes(str->data.length);
+
+    return !this->cur.has_error();
+}
+
+
+bool
+AWDStreamIterator::has_error()
+{
+    return this->cur.has_error();
+}
+
+
+
+AWDGeomView::AWDGeomView()
+{
+    this->name = NULL;
+    this->name_len = 0;
+    this->num_subs = 0;
+    this->subs = NULL;
+    this->properties.data = NULL;
+    this->properties.length = 0;
+    this->user_attributes.data = NULL;
+    this->user_attributes.length = 0;
+}
+
+
+AWDGeomView::~AWDGeomView()
+{
+    if (this->subs) {
+        free(this->subs);
+        this->subs = NULL;
+    }
+}
+
+
+bool
+AWDGeomView::parse(AWD_data_view body)
+{
+    awd_uint16 i;
+    AWDCursor cur(body.data, body.length);
+
+    if (this->subs) {
+        free(this->subs);
+        this->subs = NULL;
+    }
+
+    // Same layout as written by AWDTriGeom::write_body()
+    this->name = cur.get_varstr(&this->name_len);
+    this->num_subs = cur.get_ui16();
+    if (!awd_get_list(&cur, &this->properties))
+        return false;
+
+    this->subs = (AWD_sub_view *)malloc(this->num_subs * sizeof(AWD_sub_view));
+    for (i=0; i<this->num_subs; i++) {
+        AWD_sub_view *sub = &this->subs[i];
+
+        // Sub-mesh header only holds length of streams
+        sub->streams.length = cur.get_ui32();
+        if (!awd_get_list(&cur, &sub->properties))
+            return false;
+
+        sub->streams.data = cur.get_bytes(sub->streams.length);
+        if (!awd_get_list(&cur, &sub->user_attributes))
+            return false;
+    }
+
+    if (!awd_get_list(&cur, &this->user_attributes))
+        return false;
+
+    return !cur.has_error();
+}
+
+
+const char *
+AWDGeomView::get_name(awd_uint16 *len)
+{
+    *len = this->name_len;
+    return this->name;
+}
+
+
+awd_uint16
+AWDGeomView::get_num_subs()
+{
+    return this->num_subs;
+}
+
+
+AWD_sub_view *
+AWDGeomView::get_sub_at(awd_uint16 idx)
+{
+    if (idx >= this->num_subs)
+        return NULL;
+
+    return &this->subs[idx];
+}
+
+
+AWD_data_view
+AWDGeomView::get_properties()
+{
+    return this->properties;
+}
+
+
+AWD_data_view
+AWDGeomView::get_user_attributes()
+{
+    return this->user_attributes;
+}
+
+
+
+
+AWDReader::AWDReader()
+{
+    this->file_data = NULL;
+    this->file_len = 0;
+    this->mapped = false;
+    this->arena = NULL;
+    this->blocks = NULL;
+    this->bodies = NULL;
+    this->objects = NULL;
+    this->materializing = NULL;
+    this->addr_index = NULL;
+    this->num_threads = 0;
+    this->release();
+}
+
+
+AWDReader::~AWDReader()
+{
+    this->release();
+}
+
+
+void
+AWDReader::unmap()
+{
+    if (this->file_data && this->mapped) {
+#ifdef WIN32
+        UnmapViewOfFile(this->file_data);
+#else
+        munmap((void *)this->file_data, this->file_len);
+#endif
+    }
+
+    this->file_data = NULL;
+    this->file_len = 0;
+    this->mapped = false;
+}
+
+
+void
+AWDReader::release()
+{
+    int i;
+
+    if (this->bodies) {
+        for (i=0; i<this->num_blocks; i++) {
+            if (this->bodies[i].data)
+                free((void *)this->bodies[i].data);
+        }
+
+        free(this->bodies);
+    }
+
+    if (this->objects) {
+        for (i=0; i<this->num_blocks; i++) {
+            if (this->objects[i])
+                delete this->objects[i];
+        }
+
+        free(this->objects);
+    }
+
+    if (this->materializing)
+        free(this->materializing);
+
+    if (this->blocks)
+        free(this->blocks);
+
+    if (this->addr_index)
+        free(this->addr_index);
+
+    if (this->arena)
+        delete this->arena;
+
+    this->unmap();
+
+    this->major_version = 0;
+    this->minor_version = 0;
+    this->flags = 0;
+    this->compression = UNCOMPRESSED;
+    this->arena = NULL;
+    this->body = NULL;
+    this->body_len = 0;
+    this->blocks = NULL;
+    this->bodies = NULL;
+    this->objects = NULL;
+    this->materializing = NULL;
+    this->num_blocks = 0;
+    this->max_blocks = 0;
+    this->addr_index = NULL;
+    this->max_addr = 0;
+    this->name_index = -1;
+}
+
+
+bool
+AWDReader::open_file(const char *path)
+{
+    this->release();
+
+#ifdef WIN32
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        printf("Could not map %s\n", path);
+        CloseHandle(file);
+        return false;
+    }
+
+    // View keeps the mapping alive after both handles are closed
+    mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+        this->file_data = (const awd_uint8 *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+
+    if (this->file_data == NULL) {
+        printf("Could not map %s\n", path);
+        return false;
+    }
+
+    this->file_len = (size_t)size.QuadPart;
+#else
+    int fd;
+    void *data;
+    struct stat st;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        printf("Could not map %s\n", path);
+        close(fd);
+        return false;
+    }
+
+    // Mapping stays valid after the descriptor is closed
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        printf("Could not map %s\n", path);
+        return false;
+    }
+
+    this->file_data = (const awd_uint8 *)data;
+    this->file_len = (size_t)st.st_size;
+#endif
+
+    this->mapped = true;
+
+    if (!this->parse_header() || !this->index_blocks()) {
+        this->release();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+AWDReader::open_buffer(const void *data, size_t len)
+{
+    // Buffer is owned by the caller, and must
+    // stay valid for as long as the reader is open
+    this->release();
+
+    this->file_data = (const awd_uint8 *)data;
+    this->file_len = len;
+    this->mapped = false;
+
+    if (!this->parse_header() || !this->index_blocks()) {
+        this->release();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+AWDReader::parse_header()
+{
+    size_t avail_len;
+    awd_uint32 body_len;
+    AWDCursor cur(this->file_data, this->file_len);
+
+    if (this->file_len < AWD_HEADER_LENGTH || memcmp(this->file_data, "AWD", 3) != 0) {
+        printf("Not an AWD file\n");
+        return false;
+    }
+
+    // Same layout as written by AWD::write_header()
+    cur.get_bytes(3);
+    this->major_version = cur.get_ui8();
+    this->minor_version = cur.get_ui8();
+    this->flags = cur.get_ui16();
+    this->compression = (AWD_compression)cur.get_ui8();
+    body_len = cur.get_ui32();
+
+    avail_len = this->file_len - AWD_HEADER_LENGTH;
+    if (this->has_flag(AWD_TOC) && avail_len >= AWD_TOC_FOOTER_LENGTH &&
+        memcmp(this->file_data + this->file_len - 4, AWD_TOC_MAGIC, 4) == 0) {
+
+        // Footer is not part of the body
+        avail_len -= AWD_TOC_FOOTER_LENGTH;
+    }
+
+    // Files streamed to non-seekable outputs have a zero
+    // body length, and the body extends until end of file.
+    if (body_len == 0)
+        body_len = (awd_uint32)avail_len;
+
+    if (body_len > avail_len) {
+        printf("Truncated AWD file (body is %u bytes, %u available)\n",
+            body_len, (awd_uint32)avail_len);
+        return false;
+    }
+
+    if (this->compression == UNCOMPRESSED) {
+        this->body = this->file_data + AWD_HEADER_LENGTH;
+        this->body_len = body_len;
+        return true;
+    }
+
+    // Decompress entire body once, into a buffer that all views of
+    // the body point into for as long as the file is open.
+    this->arena = new AWDMemorySink();
+    if (!awdcomp_decompress(this->compression, this->file_data + AWD_HEADER_LENGTH,
+            body_len, this->arena, awdthread_resolve_count(this->num_threads))) {
+        return false;
+    }
+
+    this->body = this->arena->get_buffer();
+    this->body_len = this->arena->get_length();
+
+    // Compressed data is not needed anymore
+    this->unmap();
+
+    return true;
+}
+
+
+bool
+AWDReader::index_blocks()
+{
+    int num;
+    AWDCursor cur(this->body, this->body_len);
+
+    while (cur.get_remaining() > 0) {
+        AWD_block_view *block;
+        awd_uint64 offset;
+
+        if (this->num_blocks == this->max_blocks) {
+            this->max_blocks = this->max_blocks? 2*this->max_blocks : 256;
+            this->blocks = (AWD_block_view *)realloc(this->blocks,
+                this->max_blocks * sizeof(AWD_block_view));
+        }
+
+        offset = AWD_HEADER_LENGTH + (awd_uint64)(cur.get_pointer() - this->body);
+
+        // Same layout as written by AWDBlock::write_header()
+        block = &this->blocks[this->num_blocks];
+        block->addr = cur.get_ui32();
+        block->ns = cur.get_ui8();
+        block->type = (AWD_block_type)cur.get_ui8();
+        block->flags = cur.get_ui8();
+        block->offset = offset;
+        block->stored.length = cur.get_ui32();
+        block->stored.data = cur.get_bytes(block->stored.length);
+
+        if (cur.has_error()) {
+            printf("Truncated block at offset %llu\n", (unsigned long long)offset);
+            return false;
+        }
+
+        this->num_blocks++;
+    }
+
+    // Per-block state that is only filled in on demand
+    num = this->num_blocks? this->num_blocks : 1;
+    this->bodies = (AWD_data_view *)calloc(num, sizeof(AWD_data_view));
+    this->objects = (AWDBlock **)calloc(num, sizeof(AWDBlock *));
+    this->materializing = (bool *)calloc(num, sizeof(bool));
+    this->index_addresses();
+
+    // Name index is written after all other blocks except the TOC
+    if (this->has_flag(AWD_NAME_INDEX)) {
+        int i;
+
+        for (i=this->num_blocks-1; i>=0; i--) {
+            if (this->blocks[i].type == NAME_INDEX) {
+                this->name_index = i;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void
+AWDReader::index_addresses()
+{
+    int i;
+
+    // Addresses are normally assigned in sequence, so a table indexed
+    // by address gives constant time lookup. For sparse addresses,
+    // find_block() falls back to a linear search.
+    this->max_addr = 0;
+    for (i=0; i<this->num_blocks; i++) {
+        if (this->blocks[i].addr > this->max_addr)
+            this->max_addr = this->blocks[i].addr;
+    }
+
+    if (this->max_addr > 2 * (awd_baddr)this->num_blocks + 256)
+        return;
+
+    this->addr_index = (int *)malloc((this->max_addr + 1) * sizeof(int));
+    for (i=0; i<=(int)this->max_addr; i++)
+        this->addr_index[i] = -1;
+
+    // Keep the first block if addresses are reused
+    for (i=this->num_blocks-1; i>=0; i--)
+        this->addr_index[this->blocks[i].addr] = i;
+}
+
+
+int
+AWDReader::get_num_threads()
+{
+    return this->num_threads;
+}
+
+
+void
+AWDReader::set_num_threads(int num_threads)
+{
+    // Zero means one thread per CPU
+    this->num_threads = num_threads;
+}
+
+
+awd_uint8
+AWDReader::get_major_version()
+{
+    return this->major_version;
+}
+
+
+awd_uint8
+AWDReader::get_minor_version()
+{
+    return this->minor_version;
+}
+
+
+awd_uint16
+AWDReader::get_flags()
+{
+    return this->flags;
+}
+
+
+bool
+AWDReader::has_flag(int flag)
+{
+    return ((this->flags & flag) > 0);
+}
+
+
+AWD_compression
+AWDReader::get_compression()
+{
+    return this->compression;
+}
+
+
+size_t
+AWDReader::get_body_length()
+{
+    // Length of (uncompressed) body
+    return this->body_len;
+}
+
+
+int
+AWDReader::get_num_blocks()
+{
+    return this->num_blocks;
+}
+
+
+AWD_block_view *
+AWDReader::get_block_at(int idx)
+{
+    if (idx < 0 || idx >= this->num_blocks)
+        return NULL;
+
+    return &this->blocks[idx];
+}
+
+
+int
+AWDReader::find_block(awd_baddr addr)
+{
+    int i;
+
+    if (this->addr_index) {
+        if (addr > this->max_addr)
+            return -1;
+
+        return this->addr_index[addr];
+    }
+
+    for (i=0; i<this->num_blocks; i++) {
+        if (this->blocks[i].addr == addr)
+            return i;
+    }
+
+    return -1;
+}
+
+
+bool
+AWDReader::match_name(int idx, const char *name, awd_uint16 name_len, AWD_block_type type)
+{
+    const char *block_name;
+    awd_uint16 block_name_len;
+    AWD_data_view body;
+
+    // Type is checked first, so that only the body of blocks that
+    // might match needs to be decompressed.
+    if (idx < 0 || idx >= this->num_blocks)
+        return false;
+    if (type != NULL_REF && this->blocks[idx].type != type)
+        return false;
+    if (!this->get_body(idx, &body))
+        return false;
+
+    block_name = awdreader_get_block_name(this->blocks[idx].type, body, &block_name_len);
+    return (block_name != NULL && block_name_len == name_len &&
+        memcmp(block_name, name, name_len) == 0);
+}
+
+
+int
+AWDReader::find_block_by_name(const char *name, awd_uint16 name_len, AWD_block_type type)
+{
+    int i;
+    awd_uint32 lo;
+    awd_uint32 hi;
+    awd_uint32 num_entries;
+    awd_uint64 hash;
+    const awd_uint8 *entries;
+    AWD_data_view index;
+
+    // Finds the first block with the given name, among blocks of the
+    // given type (or of any type, for NULL_REF.)
+    hash = awdutil_hash_name(name, name_len);
+    if (hash == 0)
+        return -1;
+
+    if (this->name_index < 0 || !this->get_body(this->name_index, &index)) {
+        for (i=0; i<this->num_blocks; i++) {
+            if (this->match_name(i, name, name_len, type))
+                return i;
+        }
+
+        return -1;
+    }
+
+    // Entries are sorted by hash, and by address within each hash.
+    // Same layout as written by AWDNameIndexBlock::write_body()
+    AWDCursor cur(index.data, index.length);
+    num_entries = cur.get_ui32();
+    if (cur.has_error() || cur.get_remaining() / AWD_NAME_INDEX_ENTRY_LENGTH < num_entries) {
+        printf("Invalid name index\n");
+        return -1;
+    }
+
+    entries = cur.get_pointer();
+    lo = 0;
+    hi = num_entries;
+    while (lo < hi) {
+        awd_uint32 mid = lo + (hi - lo) / 2;
+        AWDCursor entry(entries + mid * AWD_NAME_INDEX_ENTRY_LENGTH, AWD_NAME_INDEX_ENTRY_LENGTH);
+
+        if (entry.get_ui64() < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (; lo < num_entries; lo++) {
+        AWDCursor entry(entries + lo * AWD_NAME_INDEX_ENTRY_LENGTH, AWD_NAME_INDEX_ENTRY_LENGTH);
+
+        if (entry.get_ui64() != hash)
+            break;
+
+        // Names are compared in full, in case of hash collisions
+        i = this->find_block(entry.get_ui32());
+        if (this->match_name(i, name, name_len, type))
+            return i;
+    }
+
+    return -1;
+}
+
+
+bool
+AWDReader::get_body(int idx, AWD_data_view *body)
+{
+    AWD_block_view *block;
+    AWD_compression type;
+    awd_uint32 length;
+    size_t unpacked_len;
+    AWDMemorySink unpacked;
+
+    block = this->get_block_at(idx);
+    if (block == NULL)
+        return false;
+
+    type = (AWD_compression)(block->flags >> AWD_BLOCK_COMPRESSION_SHIFT);
+    if (type == UNCOMPRESSED) {
+        *body = block->stored;
+        return true;
+    }
+
+    // Block was compressed on its own, and is decompressed the first
+    // time it's requested. Body starts with the uncompressed length.
+    if (this->bodies[idx].data == NULL) {
+        AWDCursor cur(block->stored.data, block->stored.length);
+
+        length = cur.get_ui32();
+        if (cur.has_error() || !awdcomp_decompress(type, cur.get_pointer(),
+                cur.get_remaining(), &unpacked, 1)) {
+            printf("Could not decompress block %u\n", block->addr);
+            return false;
+        }
+
+        if (unpacked.get_length() != length) {
+            printf("Block %u decompressed to %u bytes, expected %u\n", block->addr,
+                (awd_uint32)unpacked.get_length(), length);
+            return false;
+        }
+
+        this->bodies[idx].data = unpacked.detach_buffer(&unpacked_len);
+        this->bodies[idx].length = (awd_uint32)unpacked_len;
+    }
+
+    *body = this->bodies[idx];
+    return true;
+}
+
+
+
+static awd_float64 *
+awd_get_mtx(AWDCursor *cur, bool wide_mtx)
+{
+    int i;
+    awd_float64 *mtx;
+
+    // Only the first twelve elements are stored, as written
+    // by AWDOutputStream::put_floats()
+    mtx = awdutil_id_mtx4x4(NULL);
+    for (i=0; i<12; i++)
+        mtx[i] = wide_mtx? cur->get_f64() : (awd_float64)cur->get_f32();
+
+    return mtx;
+}
+
+
+template <typename T>
+static AWDDataStream *
+awd_copy_stream(awd_uint8 type, AWD_data_view data)
+{
+    awd_uint32 i;
+    awd_uint32 num_elements;
+    T *dst;
+    AWDArrayView<T> src(data);
+
+    num_elements = src.get_num_elements();
+    dst = (T *)malloc(num_elements * sizeof(T));
+    for (i=0; i<num_elements; i++)
+        dst[i] = src.get(i);
+
+    return new AWDTypedStream<T>(type, dst, num_elements);
+}
+
+
+static AWDDataStream *
+awd_decode_stream(AWD_stream_view *str)
+{
+    // Streams are kept in memory in their on-disk type
+    switch (str->data_type) {
+        case AWD_FIELD_INT8:
+            return awd_copy_stream<awd_int8>(str->type, str->data);
+        case AWD_FIELD_INT16:
+            return awd_copy_stream<awd_int16>(str->type, str->data);
+        case AWD_FIELD_INT32:
+            return awd_copy_stream<awd_int32>(str->type, str->data);
+        case AWD_FIELD_UINT8:
+            return awd_copy_stream<awd_uint8>(str->type, str->data);
+        case AWD_FIELD_UINT16:
+            return awd_copy_stream<awd_uint16>(str->type, str->data);
+        case AWD_FIELD_UINT32:
+            return awd_copy_stream<awd_uint32>(str->type, str->data);
+        case AWD_FIELD_FLOAT32:
+            return awd_copy_stream<awd_float32>(str->type, str->data);
+        case AWD_FIELD_FLOAT64:
+            return awd_copy_stream<awd_float64>(str->type, str->data);
+        default:
+            return NULL;
+    }
+}
+
+
+AWDTriGeom *
+AWDReader::materialize_geom(AWD_data_view body)
+{
+    awd_uint16 i;
+    awd_uint16 name_len;
+    const char *name;
+    AWDTriGeom *geom;
+    AWDGeomView view;
+
+    if (!view.parse(body))
+        return NULL;
+
+    name = view.get_name(&name_len);
+    geom = new AWDTriGeom(name, name_len);
+
+    for (i=0; i<view.get_num_subs(); i++) {
+        AWDSubGeom *sub;
+        AWD_stream_view str;
+        AWDStreamIterator it(view.get_sub_at(i)->streams);
+
+        sub = new AWDSubGeom();
+        while (it.next(&str)) {
+            AWDDataStream *data;
+
+            data = awd_decode_stream(&str);
+            if (data == NULL) {
+                printf("Unsupported stream data type %d\n", (int)str.data_type);
+                continue;
+            }
+
+            sub->add_stream(data);
+        }
+
+        geom->add_sub_mesh(sub);
+
+        if (it.has_error()) {
+            delete geom;
+            return NULL;
+        }
+    }
+
+    return geom;
+}
+
+
+AWDSkeleton *
+AWDReader::materialize_skeleton(AWD_data_view body)
+{
+    int i;
+    awd_uint16 name_len;
+    awd_uint16 num_joints;
+    const char *name;
+    AWDSkeleton *skel;
+    AWDSkeletonJoint **joints;
+    AWD_data_view list;
+    AWDCursor cur(body.data, body.length);
+
+    // TODO: Don't hard-code (see AWDBlock::write_block)
+    bool wide_mtx = false;
+
+    // Same layout as written by AWDSkeleton::write_body()
+    name = cur.get_varstr(&name_len);
+    num_joints = cur.get_ui16();
+    list.length = cur.get_ui32();
+    cur.get_bytes(list.length);
+    if (cur.has_error())
+        return NULL;
+
+    skel = new AWDSkeleton(name, name_len);
+
+    // Joints are written depth first with ids counting from one, so
+    // parents always precede their children.
+    joints = (AWDSkeletonJoint **)calloc(num_joints + 1, sizeof(AWDSkeletonJoint *));
+    for (i=1; i<=num_joints; i++) {
+        awd_uint16 id;
+        awd_uint16 parent_id;
+        awd_uint16 joint_name_len;
+        const char *joint_name;
+        awd_float64 *mtx;
+
+        id = cur.get_ui16();
+        parent_id = cur.get_ui16();
+        joint_name = cur.get_varstr(&joint_name_len);
+        mtx = awd_get_mtx(&cur, wide_mtx);
+
+        // Skip properties and user attributes
+        cur.get_bytes(cur.get_ui32());
+        cur.get_bytes(cur.get_ui32());
+
+        if (cur.has_error() || id != i || parent_id >= id || (parent_id == 0 && i > 1)) {
+            printf("Invalid joint %d in skeleton\n", i);
+            free(mtx);
+            break;
+        }
+
+        joints[i] = new AWDSkeletonJoint(joint_name, joint_name_len, mtx);
+        if (parent_id == 0)
+            skel->set_root_joint(joints[i]);
+        else
+            joints[parent_id]->add_child_joint(joints[i]);
+    }
+
+    free(joints);
+
+    if (i <= num_joints) {
+        delete skel;
+        return NULL;
+    }
+
+    return skel;
+}
+
+
+AWDMaterial *
+AWDReader::materialize_material(AWD_data_view body)
+{
+    awd_uint16 name_len;
+    const char *name;
+    AWD_mat_type type;
+    AWD_attr_view prop;
+    AWD_data_view props;
+    AWDMaterial *mat;
+    AWDCursor cur(body.data, body.length);
+
+    // Same layout as written by AWDMaterial::write_body(). Shading
+    // methods and user attributes are not materialized.
+    name = cur.get_varstr(&name_len);
+    type = (AWD_mat_type)cur.get_ui8();
+    cur.get_ui8();
+    props.length = cur.get_ui32();
+    props.data = cur.get_bytes(props.length);
+    if (cur.has_error())
+        return NULL;
+
+    mat = new AWDMaterial(type, name, name_len);
+
+    AWDAttrIterator it(props, false);
+    while (it.next(&prop)) {
+        AWDCursor val(prop.value.data, prop.value.length);
+
+        switch (prop.key) {
+            case PROP_MAT_COLOR:
+                mat->color = val.get_ui32();
+                break;
+
+            case PROP_MAT_TEXTURE:
+                {
+                    AWDBlock *tex;
+
+                    tex = this->find_object(val.get_ui32());
+                    if (tex && tex->get_type() == BITMAP_TEXTURE)
+                        mat->set_texture((AWDBitmapTexture *)tex);
+                }
+                break;
+
+            case PROP_MAT_ALPHA_BLENDING:
+                mat->alpha_blending = (val.get_ui8() != 0);
+                break;
+
+            case PROP_MAT_ALPHA_THRESHOLD:
+                mat->alpha_threshold = val.get_f32();
+                break;
+
+            case PROP_MAT_REPEAT:
+                mat->repeat = (val.get_ui8() != 0);
+                break;
+        }
+    }
+
+    return mat;
+}
+
+
+AWDBitmapTexture *
+AWDReader::materialize_texture(AWD_data_view body)
+{
+    awd_uint16 name_len;
+    awd_uint32 data_len;
+    const char *name;
+    const awd_uint8 *data;
+    AWD_tex_type type;
+    AWDBitmapTexture *tex;
+    AWDCursor cur(body.data, body.length);
+
+    // Same layout as written by AWDBitmapTexture::write_body()
+    name = cur.get_varstr(&name_len);
+    type = (AWD_tex_type)cur.get_ui8();
+    data_len = cur.get_ui32();
+    data = cur.get_bytes(data_len);
+    if (cur.has_error())
+        return NULL;
+
+    // URL and embedded data are not copied, but point into the file
+    tex = new AWDBitmapTexture(type, name, name_len);
+    if (type == EXTERNAL)
+        tex->set_url((const char *)data, (awd_uint16)data_len);
+    else
+        tex->set_embed_data((awd_uint8 *)data, data_len);
+
+    return tex;
+}
+
+
+AWDSceneBlock *
+AWDReader::materialize_scene_block(AWD_block_type type, AWD_data_view body)
+{
+    awd_baddr parent_addr;
+    awd_uint16 name_len;
+    const char *name;
+    awd_float64 *mtx;
+    AWDBlock *parent;
+    AWDSceneBlock *block;
+    AWDCursor cur(body.data, body.length);
+
+    // TODO: Don't hard-code (see AWDBlock::write_block)
+    bool wide_mtx = false;
+
+    // Common fields, as written by write_scene_common()
+    parent_addr = cur.get_ui32();
+    mtx = awd_get_mtx(&cur, wide_mtx);
+    name = cur.get_varstr(&name_len);
+    if (cur.has_error()) {
+        free(mtx);
+        return NULL;
+    }
+
+    if (type == MESH_INSTANCE) {
+        int i;
+        awd_baddr geom_addr;
+        awd_uint16 num_materials;
+        AWDMeshInst *inst;
+        AWDBlock *geom;
+
+        inst = new AWDMeshInst(name, name_len, NULL, mtx);
+
+        geom_addr = cur.get_ui32();
+        geom = this->find_object(geom_addr);
+        if (geom && geom->get_type() == TRI_GEOM)
+            inst->set_geom(geom);
+
+        num_materials = cur.get_ui16();
+        for (i=0; i<num_materials && !cur.has_error(); i++) {
+            AWDBlock *mat;
+
+            mat = this->find_object(cur.get_ui32());
+            if (mat && mat->get_type() == SIMPLE_MATERIAL)
+                inst->add_material((AWDMaterial *)mat);
+        }
+
+        block = inst;
+    }
+    else if (type == CONTAINER) {
+        block = new AWDContainer(name, name_len);
+        block->set_transform(mtx);
+    }
+    else {
+        block = new AWDScene(name, name_len);
+        block->set_transform(mtx);
+    }
+
+    parent = this->find_object(parent_addr);
+    if (parent) {
+        AWD_block_type parent_type;
+
+        parent_type = parent->get_type();
+        if (parent_type == SCENE || parent_type == CONTAINER || parent_type == MESH_INSTANCE)
+            block->set_parent((AWDSceneBlock *)parent);
+    }
+
+    return block;
+}
+
+
+AWDBlock *
+AWDReader::materialize(AWD_block_view *view, AWD_data_view body)
+{
+    switch (view->type) {
+        case TRI_GEOM:
+            return this->materialize_geom(body);
+
+        case SKELETON:
+            return this->materialize_skeleton(body);
+
+        case SIMPLE_MATERIAL:
+            return this->materialize_material(body);
+
+        case BITMAP_TEXTURE:
+            return this->materialize_texture(body);
+
+        case SCENE:
+        case CONTAINER:
+        case MESH_INSTANCE:
+            return this->materialize_scene_block(view->type, body);
+
+        default:
+            // Other blocks are only available as views
+            return NULL;
+    }
+}
+
+
+AWDBlock *
+AWDReader::get_object_at(int idx)
+{
+    AWDBlock *obj;
+    AWD_data_view body;
+
+    if (idx < 0 || idx >= this->num_blocks)
+        return NULL;
+
+    if (this->objects[idx])
+        return this->objects[idx];
+
+    // Guard against blocks that (indirectly) refer to themselves
+    if (this->materializing[idx])
+        return NULL;
+
+    if (!this->get_body(idx, &body))
+        return NULL;
+
+    this->materializing[idx] = true;
+    obj = this->materialize(&this->blocks[idx], body);
+    this->materializing[idx] = false;
+
+    if (obj) {
+        obj->set_addr(this->blocks[idx].addr);
+        this->objects[idx] = obj;
+    }
+
+    return obj;
+}
+
+
+AWDBlock *
+AWDReader::find_object(awd_baddr addr)
+{
+    // Address zero is used for null references
+    if (addr == 0)
+        return NULL;
+
+    return this->get_object_at(this->find_block(addr));
+}
@@ -11,6 +11,7 @@ AWDSceneBlock::AWDSceneBlock(AWD_block_type type, const char *name, awd_uint16 n
     AWDAttrElement()
 {
     this->parent = NULL;
+    this->transform_mtx = NULL;
     this->children = new AWDBlockList();
 
     if (mtx == NULL)
@@ -30,20 +31,20 @@ AWDSceneBlock::~AWDSceneBlock()
 
 
 void
-AWDSceneBlock::write_scene_common(int fd, bool wide_mtx)
+AWDSceneBlock::write_scene_common(AWDOutputStream *out, bool wide_mtx)
 {
     awd_baddr parent_addr;
 
-    // Get IDs for references, verify byte-order
+    // Get IDs for references
     parent_addr = 0;
     if (this->parent != NULL)
-        parent_addr = UI32(this->parent->get_addr());
+        parent_addr = this->parent->get_addr();
 
     // Write scene block common fields
     // TODO: Move this to separate base class
-    write(fd, &parent_addr, sizeof(awd_baddr));
-    awdutil_write_floats(fd, this->transform_mtx, 12, wide_mtx);
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
+    out->put_ui32(parent_addr);
+    out->put_floats(this->transform_mtx, 12, wide_mtx);
+    out->put_varstr(this->get_name(), this->get_name_length());
 }
 
 
@@ -57,6 +58,10 @@ AWDSceneBlock::calc_common_length(bool wide_mtx)
 void
 AWDSceneBlock::set_transform(awd_float64 *mtx)
 {
+    // Block owns its transform, so free any previous one
+    if (this->transform_mtx && this->transform_mtx != mtx)
+        free(this->transform_mtx);
+
     this->transform_mtx = mtx;
 }
 
@@ -127,11 +132,11 @@ AWDScene::calc_body_length(bool wide_mtx)
 
 
 void
-AWDScene::write_body(int fd, bool wide_mtx)
+AWDScene::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    this->write_scene_common(fd, wide_mtx);
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->write_scene_common(out, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -159,11 +164,11 @@ AWDContainer::calc_body_length(bool wide_mtx)
 
 
 void
-AWDContainer::write_body(int fd, bool wide_mtx)
+AWDContainer::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    this->write_scene_common(fd, wide_mtx);
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->write_scene_common(out, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
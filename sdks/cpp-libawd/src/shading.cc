@@ -25,14 +25,11 @@ AWDShadingMethod::calc_method_length(bool wide_mtx)
 
 
 void
-AWDShadingMethod::write_method(int fd, bool wide_mtx)
+AWDShadingMethod::write_method(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint16 type_be;
-
-    type_be = UI16(this->type);
-    write(fd, &type_be, sizeof(awd_uint16));
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    out->put_ui16((awd_uint16)this->type);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
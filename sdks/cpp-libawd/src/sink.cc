@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sink.h"
+
+#include "platform.h"
+
+
+AWDSink::~AWDSink()
+{
+}
+
+
+void
+AWDSink::finish()
+{
+    // Does nothing by default. Sinks that keep internal
+    // state (e.g. compressors) override this to flush it.
+}
+
+
+bool
+AWDSink::has_error()
+{
+    return false;
+}
+
+
+
+
+AWDMemorySink::AWDMemorySink()
+{
+    this->buf = NULL;
+    this->buf_len = 0;
+    this->buf_size = 0;
+}
+
+
+AWDMemorySink::AWDMemorySink(size_t initial_size)
+{
+    this->buf = (awd_uint8 *)malloc(initial_size);
+    this->buf_len = 0;
+    this->buf_size = initial_size;
+}
+
+
+AWDMemorySink::~AWDMemorySink()
+{
+    if (this->buf) {
+        free(this->buf);
+        this->buf = NULL;
+    }
+}
+
+
+void
+AWDMemorySink::grow(size_t len)
+{
+    if (this->buf_len + len > this->buf_size) {
+        size_t new_size;
+
+        // Grow geometrically so that the number of reallocations
+        // stays logarithmic in the final size of the buffer.
+        new_size = this->buf_size? this->buf_size : AWD_MEMSINK_INITIAL_SIZE;
+        while (new_size < this->buf_len + len)
+            new_size *= 2;
+
+        this->buf = (awd_uint8 *)realloc(this->buf, new_size);
+        this->buf_size = new_size;
+    }
+}
+
+
+void
+AWDMemorySink::write_bytes(const void *data, size_t len)
+{
+    this->grow(len);
+
+    memcpy(this->buf + this->buf_len, data, len);
+    this->buf_len += len;
+}
+
+
+awd_uint8 *
+AWDMemorySink::reserve(size_t len)
+{
+    // Pointer is only valid until the buffer next grows
+    this->grow(len);
+    return this->buf + this->buf_len;
+}
+
+
+void
+AWDMemorySink::advance(size_t len)
+{
+    // Data has been written to space returned by reserve()
+    this->buf_len += len;
+}
+
+
+awd_uint8 *
+AWDMemorySink::get_buffer()
+{
+    return this->buf;
+}
+
+
+size_t
+AWDMemorySink::get_length()
+{
+    return this->buf_len;
+}
+
+
+awd_uint8 *
+AWDMemorySink::detach_buffer(size_t *len)
+{
+    awd_uint8 *detached;
+
+    // Caller takes over ownership of the buffer, and
+    // is responsible for free()ing it.
+    detached = this->buf;
+    if (len)
+        *len = this->buf_len;
+
+    this->buf = NULL;
+    this->buf_len = 0;
+    this->buf_size = 0;
+
+    return detached;
+}
+
+
+void
+AWDMemorySink::discard(size_t len)
+{
+    // Drop data from the start of the buffer, e.g. once consumed
+    if (len >= this->buf_len) {
+        this->buf_len = 0;
+        return;
+    }
+
+    memmove(this->buf, this->buf + len, this->buf_len - len);
+    this->buf_len -= len;
+}
+
+
+void
+AWDMemorySink::reset()
+{
+    // Keep allocated memory for reuse
+    this->buf_len = 0;
+}
+
+
+
+
+AWDFileSink::AWDFileSink(int fd)
+{
+    this->fd = fd;
+    this->error = false;
+}
+
+
+void
+AWDFileSink::write_bytes(const void *data, size_t len)
+{
+    const awd_uint8 *ptr;
+
+    if (this->error)
+        return;
+
+    // write() may accept fewer bytes than requested, e.g. when
+    // writing to pipes, so keep going until everything is out.
+    ptr = (const awd_uint8 *)data;
+    while (len > 0) {
+        int ret;
+
+        ret = write(this->fd, ptr, len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            this->error = true;
+            return;
+        }
+
+        ptr += ret;
+        len -= ret;
+    }
+}
+
+
+bool
+AWDFileSink::has_error()
+{
+    return this->error;
+}
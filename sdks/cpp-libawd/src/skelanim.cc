@@ -79,35 +79,29 @@ AWDSkeletonPose::calc_body_length(bool wide_mtx)
 
 
 void
-AWDSkeletonPose::write_body(int fd, bool wide_mtx)
+AWDSkeletonPose::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_bool bt;
-    awd_bool bf;
     AWD_joint_tf *cur;
-    awd_uint16 num_joints_be;
 
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-    num_joints_be = UI16(this->num_transforms);
-    write(fd, &num_joints_be, sizeof(awd_uint16));
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_ui16(this->num_transforms);
 
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
-    bt = AWD_TRUE;
-    bf = AWD_FALSE;
     cur = this->first_transform;
     while (cur) {
         if (cur->transform_mtx) {
-            write(fd, &bt, 1);
-            awdutil_write_floats(fd, cur->transform_mtx, 12, wide_mtx);
+            out->put_ui8(AWD_TRUE);
+            out->put_floats(cur->transform_mtx, 12, wide_mtx);
         }
         else {
-            write(fd, &bf, 1);
+            out->put_ui8(AWD_FALSE);
         }
 
         cur = cur->next;
     }
 
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -181,28 +175,22 @@ AWDSkeletonAnimation::calc_body_length(bool wide_mtx)
 
 
 void
-AWDSkeletonAnimation::write_body(int fd, bool wide_mtx)
+AWDSkeletonAnimation::write_body(AWDOutputStream *out, bool wide_mtx)
 {
     AWD_skelanim_fr *frame;
-    awd_uint16 num_frames_be;
 
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_ui16(this->num_frames);
 
-    num_frames_be = UI16(this->num_frames);
-    write(fd, &num_frames_be, sizeof(awd_uint16));
-
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     frame = this->first_frame;
     while (frame) {
-        awd_baddr addr_be = UI32(frame->pose->get_addr());
-        awd_uint16 dur_be = UI16(frame->duration);
-
-        write(fd, &addr_be, sizeof(awd_baddr));
-        write(fd, &dur_be, sizeof(awd_uint16));
+        out->put_ui32(frame->pose->get_addr());
+        out->put_ui16(frame->duration);
 
         frame = frame->next;
     }
 
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
@@ -156,31 +156,28 @@ AWDSkeletonJoint::calc_num_children()
 
 
 int
-AWDSkeletonJoint::write_joint(int fd, awd_uint32 id, bool wide_mtx)
+AWDSkeletonJoint::write_joint(AWDOutputStream *out, awd_uint32 id, bool wide_mtx)
 {
     int num_written;
     awd_uint32 child_id;
     AWDSkeletonJoint *child;
-    awd_uint16 par_id_be;
-    awd_uint16 id_be;
+    awd_uint16 par_id;
 
     this->id = id;
 
-    // Convert numbers to big-endian
-    id_be = UI16(this->id);
     if (this->parent) 
-        par_id_be = UI16(this->parent->id);
-    else par_id_be = 0;
+        par_id = this->parent->id;
+    else par_id = 0;
 
     // Write this joint
-    write(fd, &id_be, sizeof(awd_uint16));
-    write(fd, &par_id_be, sizeof(awd_uint16));
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-    awdutil_write_floats(fd, this->bind_mtx, 12, wide_mtx);
+    out->put_ui16(this->id);
+    out->put_ui16(par_id);
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_floats(this->bind_mtx, 12, wide_mtx);
 
     //  TODO: Write attributes
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 
     // Write children
     child_id = id+1;
@@ -189,7 +186,7 @@ AWDSkeletonJoint::write_joint(int fd, awd_uint32 id, bool wide_mtx)
     while (child) {
         int num_children_written;
 
-        num_children_written = child->write_joint(fd, child_id, wide_mtx);
+        num_children_written = child->write_joint(out, child_id, wide_mtx);
 
         child_id += num_children_written;
         num_written += num_children_written;
@@ -239,26 +236,26 @@ AWDSkeleton::calc_body_length(bool wide_mtx)
 
 
 void
-AWDSkeleton::write_body(int fd, bool wide_mtx)
+AWDSkeleton::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint16 num_joints_be;
+    awd_uint16 num_joints;
 
-    num_joints_be = 0;
+    num_joints = 0;
     if (this->root_joint != NULL)
-        num_joints_be = UI16(1 + this->root_joint->calc_num_children());
+        num_joints = 1 + this->root_joint->calc_num_children();
 
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-    write(fd, &num_joints_be, sizeof(awd_uint16));
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_ui16(num_joints);
 
     // Write optional properties
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     // Write joints (if any)
     if (this->root_joint != NULL)
-        this->root_joint->write_joint(fd, 1, wide_mtx);
+        this->root_joint->write_joint(out, 1, wide_mtx);
 
     // Write user attributes
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <errno.h>
+
+#include "source.h"
+
+#include "platform.h"
+
+
+AWDSource::~AWDSource()
+{
+}
+
+
+bool
+AWDSource::has_error()
+{
+    return false;
+}
+
+
+
+
+AWDFileSource::AWDFileSource(int fd)
+{
+    this->fd = fd;
+    this->error = false;
+}
+
+
+size_t
+AWDFileSource::read_bytes(void *data, size_t len)
+{
+    if (this->error)
+        return 0;
+
+    for (;;) {
+        int ret;
+
+        ret = read(this->fd, data, len);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+
+            this->error = true;
+            return 0;
+        }
+
+        return (size_t)ret;
+    }
+}
+
+
+bool
+AWDFileSource::has_error()
+{
+    return this->error;
+}
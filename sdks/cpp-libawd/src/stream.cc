@@ -13,16 +13,35 @@ AWDDataStream::AWDDataStream(awd_uint8 type, AWD_field_type data_type, AWD_str_p
     this->data = data;
 	this->data_type = data_type;
     this->num_elements = num_elements;
+    this->own_data = true;
+    this->release_func = NULL;
+    this->release_arg = NULL;
+    this->encoder = NULL;
     this->next = NULL;
 }
 
 AWDDataStream::~AWDDataStream()
 {
-    free(this->data.v);
+    if (this->own_data)
+        free(this->data.v);
+    else if (this->release_func)
+        this->release_func(this->data.v, this->release_arg);
+
     this->num_elements = 0;
 }
 
 
+void
+AWDDataStream::set_release_func(awd_release_func release_func, void *release_arg)
+{
+    // Data is owned by the caller from now on. Without a function,
+    // the caller must keep the data until the stream is deleted.
+    this->own_data = false;
+    this->release_func = release_func;
+    this->release_arg = release_arg;
+}
+
+
 
 
 awd_uint32
@@ -42,83 +61,39 @@ AWDDataStream::get_length()
 
 
 
-void
-AWDDataStream::write_stream(int fd)
+AWD_field_type
+AWDDataStream::get_storage_type()
 {
-    unsigned int e;
-    awd_uint32 num;
-    awd_uint32 str_len;
-    
-    str_len = UI32(this->get_length());
-    
-    write(fd, (awd_uint8*)&this->type, sizeof(awd_uint8));
-    write(fd, (awd_uint8*)&this->data_type, sizeof(awd_uint8));
-    write(fd, &str_len, sizeof(awd_uint32));
-    
-    num = this->num_elements;
-
-    // Encode according to data type field
-    if (this->data_type == AWD_FIELD_INT8) {
-        for (e=0; e<num; e++) {
-            awd_int32 *p = (this->data.i32 + e);
-            awd_int8 elem = (awd_int8)*p;
-            write(fd, &elem, sizeof(awd_int8));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_INT16) {
-        for (e=0; e<num; e++) {
-            awd_int32 *p = (this->data.i32 + e);
-            awd_int16 elem = UI16((awd_int16)*p);
-            write(fd, &elem, sizeof(awd_int16));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_INT32) {
-        for (e=0; e<num; e++) {
-            awd_int32 *p = (this->data.i32 + e);
-            awd_int32 elem = UI32((awd_int32)*p);
-            write(fd, &elem, sizeof(awd_int32));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_UINT8) {
-        for (e=0; e<num; e++) {
-            awd_uint32 *p = (this->data.ui32 + e);
-            awd_uint8 elem = (awd_uint8)*p;
-            write(fd, &elem, sizeof(awd_uint8));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_UINT16) {
-        for (e=0; e<num; e++) {
-            awd_uint32 *p = (this->data.ui32 + e);
-            awd_uint16 elem = UI16((awd_uint16)*p);
-            write(fd, &elem, sizeof(awd_uint16));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_UINT32) {
-        for (e=0; e<num; e++) {
-            awd_uint32 *p = (this->data.ui32 + e);
-            awd_uint32 elem = UI32((awd_uint32)*p);
-            write(fd, &elem, sizeof(awd_uint32));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_FLOAT32) {
-        for (e=0; e<num; e++) {
-            awd_float64 *p = (this->data.f64 + e);
-            awd_float32 elem = F32((awd_float32)*p);
-            write(fd, &elem, sizeof(awd_float32));
-        }
-    }
-    else if (this->data_type == AWD_FIELD_FLOAT64) {
-        for (e=0; e<num; e++) {
-            awd_float64 *p = (this->data.f64 + e);
-            awd_float64 elem = F64((awd_float64)*p);
-            write(fd, &elem, sizeof(awd_float64));
-        }
+    switch (this->data_type) {
+        case AWD_FIELD_INT8:
+        case AWD_FIELD_INT16:
+        case AWD_FIELD_INT32:
+            return AWD_FIELD_INT32;
+        case AWD_FIELD_UINT8:
+        case AWD_FIELD_UINT16:
+        case AWD_FIELD_UINT32:
+            return AWD_FIELD_UINT32;
+        default:
+            return AWD_FIELD_FLOAT64;
     }
 }
 
 
 
-
+void
+AWDDataStream::write_stream(AWDOutputStream *out)
+{
+    out->put_ui8((awd_uint8)this->type);
+    out->put_ui8((awd_uint8)this->data_type);
+    out->put_ui32(this->get_length());
+
+    // Encoder converts elements from how they are kept in memory to
+    // the on-disk type in bulk, straight into the stream buffer.
+    if (this->encoder == NULL)
+        this->encoder = awdutil_get_array_encoder(this->data_type, this->get_storage_type());
+    if (this->encoder)
+        this->encoder(out, this->data.v, this->num_elements);
+}
 
 
 AWDGeomDataStream::AWDGeomDataStream(awd_uint8 type, AWD_field_type data_type, AWD_str_ptr data, awd_uint32 num_elements)
@@ -0,0 +1,700 @@
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+
+#include "streamdec.h"
+#include "awd.h"
+#include "block.h"
+#include "compress.h"
+#include "decompress.h"
+#include "awdlzma.h"
+#include "thread.h"
+
+#include "Types.h"
+#include "LzmaDec.h"
+
+
+// Bytes preceding the compressed data of an AWD LZMA body
+// (length of uncompressed data and encoder props.)
+#define AWD_LZMA_HEADER_LENGTH (sizeof(awd_uint32) + LZMA_PROPS_SIZE)
+
+static ISzAlloc awd_lzma_alloc = { &awd_SzAlloc, &awd_SzFree };
+
+
+AWDStreamDecoder::AWDStreamDecoder(AWDSource *source)
+{
+    this->source = source;
+    this->num_threads = 0;
+
+    this->major_version = 0;
+    this->minor_version = 0;
+    this->flags = 0;
+    this->compression = UNCOMPRESSED;
+    this->body_len = 0;
+
+    this->in_buf = (awd_uint8 *)malloc(AWD_STREAMDEC_INPUT_SIZE);
+    this->in_pos = 0;
+    this->in_len = 0;
+    this->num_read = 0;
+    this->eof = false;
+
+    this->out = new AWDMemorySink();
+    this->out_pos = 0;
+    this->out_offset = 0;
+    this->body_done = false;
+
+    this->block_body = new AWDMemorySink();
+
+    this->zstrm_init = false;
+    this->lzma = NULL;
+    this->lzma_out_left = 0;
+    this->lzma_in_left = 0;
+#ifdef AWD_WITH_ZSTD
+    this->zstd = NULL;
+#endif
+#ifdef AWD_WITH_LZ4
+    this->lz4 = NULL;
+#endif
+}
+
+
+AWDStreamDecoder::~AWDStreamDecoder()
+{
+    this->end_decompressor();
+
+    free(this->in_buf);
+    delete this->out;
+    delete this->block_body;
+}
+
+
+int
+AWDStreamDecoder::get_num_threads()
+{
+    return this->num_threads;
+}
+
+
+void
+AWDStreamDecoder::set_num_threads(int num_threads)
+{
+    // Only used for blocks compressed as chunked LZMA
+    this->num_threads = num_threads;
+}
+
+
+awd_uint8
+AWDStreamDecoder::get_major_version()
+{
+    return this->major_version;
+}
+
+
+awd_uint8
+AWDStreamDecoder::get_minor_version()
+{
+    return this->minor_version;
+}
+
+
+awd_uint16
+AWDStreamDecoder::get_flags()
+{
+    return this->flags;
+}
+
+
+bool
+AWDStreamDecoder::has_flag(int flag)
+{
+    return ((this->flags & flag) > 0);
+}
+
+
+AWD_compression
+AWDStreamDecoder::get_compression()
+{
+    return this->compression;
+}
+
+
+
+bool
+AWDStreamDecoder::fill_input(size_t min_len)
+{
+    // Move unconsumed data to the start of the buffer
+    if (this->in_pos > 0) {
+        memmove(this->in_buf, this->in_buf + this->in_pos, this->in_len - this->in_pos);
+        this->in_len -= this->in_pos;
+        this->in_pos = 0;
+    }
+
+    while (this->in_len < min_len && !this->eof) {
+        size_t max_len;
+        size_t len;
+
+        max_len = AWD_STREAMDEC_INPUT_SIZE - this->in_len;
+
+        // Never read past the end of a body of known length, e.g.
+        // into the TOC footer, which is not part of the body.
+        if (this->body_len > 0 && this->body_len - this->num_read < max_len)
+            max_len = this->body_len - this->num_read;
+
+        len = max_len? this->source->read_bytes(this->in_buf + this->in_len, max_len) : 0;
+        if (this->source->has_error()) {
+            printf("Could not read AWD data\n");
+            return false;
+        }
+
+        if (len == 0)
+            this->eof = true;
+
+        this->in_len += len;
+        this->num_read += len;
+    }
+
+    return true;
+}
+
+
+bool
+AWDStreamDecoder::read_header()
+{
+    AWDCursor cur(this->in_buf, AWD_HEADER_LENGTH);
+
+    if (!this->fill_input(AWD_HEADER_LENGTH))
+        return false;
+
+    if (this->in_len < AWD_HEADER_LENGTH || memcmp(this->in_buf, "AWD", 3) != 0) {
+        printf("Not an AWD file\n");
+        return false;
+    }
+
+    // Same layout as written by AWD::write_header()
+    cur.get_bytes(3);
+    this->major_version = cur.get_ui8();
+    this->minor_version = cur.get_ui8();
+    this->flags = cur.get_ui16();
+    this->compression = (AWD_compression)cur.get_ui8();
+    this->body_len = cur.get_ui32();
+    this->in_pos = AWD_HEADER_LENGTH;
+
+    // From here on, only count data that belongs to the body. Files
+    // streamed to non-seekable outputs have a zero body length, in
+    // which case the body extends until end of input.
+    this->num_read = this->in_len - this->in_pos;
+    if (this->body_len > 0 && this->num_read >= this->body_len) {
+        this->in_len = this->in_pos + this->body_len;
+        this->num_read = this->body_len;
+        this->eof = true;
+    }
+
+    return true;
+}
+
+
+bool
+AWDStreamDecoder::init_decompressor()
+{
+    switch (this->compression) {
+        case UNCOMPRESSED:
+            return true;
+
+        case DEFLATE:
+            memset(&this->zstrm, 0, sizeof(z_stream));
+            if (inflateInit(&this->zstrm) != Z_OK) {
+                printf("Could not initialize zlib\n");
+                return false;
+            }
+
+            this->zstrm_init = true;
+            return true;
+
+        case LZMA:
+        case LZMA_CHUNKED:
+            this->lzma = malloc(sizeof(CLzmaDec));
+            LzmaDec_Construct((CLzmaDec *)this->lzma);
+
+            // Regular LZMA bodies are a single chunk that spans the
+            // whole body, without a compressed length preceding it.
+            if (this->compression == LZMA) {
+                this->lzma_in_left = (size_t)-1;
+                return this->begin_lzma();
+            }
+
+            return true;
+
+        case ZSTD:
+#ifdef AWD_WITH_ZSTD
+            this->zstd = ZSTD_createDCtx();
+            if (this->zstd == NULL) {
+                printf("Could not initialize Zstandard\n");
+                return false;
+            }
+
+            // Allow the window used by long distance matching
+            ZSTD_DCtx_setParameter(this->zstd, ZSTD_d_windowLogMax, AWD_ZSTD_LDM_WINDOW_LOG);
+            return true;
+#else
+            printf("libawd was built without Zstandard support (AWD_WITH_ZSTD)\n");
+            return false;
+#endif
+
+        case LZ4:
+#ifdef AWD_WITH_LZ4
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&this->lz4, LZ4F_VERSION))) {
+                this->lz4 = NULL;
+                printf("Could not initialize LZ4\n");
+                return false;
+            }
+            return true;
+#else
+            printf("libawd was built without LZ4 support (AWD_WITH_LZ4)\n");
+            return false;
+#endif
+    }
+
+    printf("Unknown compression type %d\n", (int)this->compression);
+    return false;
+}
+
+
+void
+AWDStreamDecoder::end_decompressor()
+{
+    if (this->zstrm_init) {
+        inflateEnd(&this->zstrm);
+        this->zstrm_init = false;
+    }
+
+    if (this->lzma) {
+        LzmaDec_Free((CLzmaDec *)this->lzma, &awd_lzma_alloc);
+        free(this->lzma);
+        this->lzma = NULL;
+    }
+
+#ifdef AWD_WITH_ZSTD
+    if (this->zstd) {
+        ZSTD_freeDCtx(this->zstd);
+        this->zstd = NULL;
+    }
+#endif
+
+#ifdef AWD_WITH_LZ4
+    if (this->lz4) {
+        LZ4F_freeDecompressionContext(this->lz4);
+        this->lz4 = NULL;
+    }
+#endif
+}
+
+
+
+bool
+AWDStreamDecoder::decode_inflate()
+{
+    int ret;
+    size_t in_avail;
+
+    if (this->in_pos == this->in_len && !this->fill_input(1))
+        return false;
+
+    in_avail = this->in_len - this->in_pos;
+    this->zstrm.next_in = (Bytef *)(this->in_buf + this->in_pos);
+    this->zstrm.avail_in = (uInt)in_avail;
+    this->zstrm.next_out = (Bytef *)this->out->reserve(AWD_ZCHUNK_SIZE);
+    this->zstrm.avail_out = AWD_ZCHUNK_SIZE;
+
+    ret = inflate(&this->zstrm, Z_NO_FLUSH);
+    this->out->advance(AWD_ZCHUNK_SIZE - this->zstrm.avail_out);
+    this->in_pos += in_avail - this->zstrm.avail_in;
+
+    if (ret == Z_STREAM_END) {
+        this->body_done = true;
+        return true;
+    }
+
+    // Buffer error means no progress was possible, which with
+    // plenty of output space means that input ran out.
+    if (ret == Z_BUF_ERROR && in_avail == 0) {
+        printf("Truncated DEFLATE body\n");
+        return false;
+    }
+
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        printf("Could not inflate body (zlib error %d)\n", ret);
+        return false;
+    }
+
+    return true;
+}
+
+
+bool
+AWDStreamDecoder::begin_lzma()
+{
+    awd_uint32 dict_size;
+    awd_uint8 props[LZMA_PROPS_SIZE];
+    AWDCursor cur(NULL, 0);
+
+    if (!this->fill_input(AWD_LZMA_HEADER_LENGTH))
+        return false;
+
+    if (this->in_len - this->in_pos < AWD_LZMA_HEADER_LENGTH ||
+            this->lzma_in_left < AWD_LZMA_HEADER_LENGTH) {
+        printf("Truncated LZMA body\n");
+        return false;
+    }
+
+    // Same layout as written by AWDLzmaSink::finish()
+    cur = AWDCursor(this->in_buf + this->in_pos, AWD_LZMA_HEADER_LENGTH);
+    this->lzma_out_left = cur.get_ui32();
+    memcpy(props, cur.get_bytes(LZMA_PROPS_SIZE), LZMA_PROPS_SIZE);
+    this->in_pos += AWD_LZMA_HEADER_LENGTH;
+    this->lzma_in_left -= AWD_LZMA_HEADER_LENGTH;
+
+    // Matches never reach further back than the start of the data,
+    // so a dictionary larger than the data would never be filled.
+    dict_size = props[1] | (props[2] << 8) | (props[3] << 16) | ((awd_uint32)props[4] << 24);
+    if (this->lzma_out_left < dict_size) {
+        dict_size = this->lzma_out_left;
+        props[1] = (awd_uint8)(dict_size);
+        props[2] = (awd_uint8)(dict_size >> 8);
+        props[3] = (awd_uint8)(dict_size >> 16);
+        props[4] = (awd_uint8)(dict_size >> 24);
+    }
+
+    if (LzmaDec_Allocate((CLzmaDec *)this->lzma, props, LZMA_PROPS_SIZE, &awd_lzma_alloc) != SZ_OK) {
+        printf("Could not initialize LZMA decoder\n");
+        return false;
+    }
+
+    LzmaDec_Init((CLzmaDec *)this->lzma);
+    return true;
+}
+
+
+bool
+AWDStreamDecoder::decode_lzma()
+{
+    SRes res;
+    SizeT src_len;
+    SizeT dst_len;
+    ELzmaStatus status;
+
+    if (this->lzma_out_left == 0) {
+        if (this->compression == LZMA) {
+            this->body_done = true;
+            return true;
+        }
+
+        // Skip anything left of the previous chunk, i.e. data
+        // that the decoder didn't need to finish its output.
+        while (this->lzma_in_left > 0) {
+            size_t len;
+
+            if (this->in_pos == this->in_len && !this->fill_input(1))
+                return false;
+
+            len = this->in_len - this->in_pos;
+            if (len == 0) {
+                printf("Truncated LZMA chunk\n");
+                return false;
+            }
+
+            if (len > this->lzma_in_left)
+                len = this->lzma_in_left;
+
+            this->in_pos += len;
+            this->lzma_in_left -= len;
+        }
+
+        if (!this->fill_input(sizeof(awd_uint32)))
+            return false;
+
+        // Chunked bodies end with the last chunk
+        if (this->in_pos == this->in_len) {
+            this->body_done = true;
+            return true;
+        }
+
+        if (this->in_len - this->in_pos < sizeof(awd_uint32)) {
+            printf("Truncated LZMA chunk\n");
+            return false;
+        }
+
+        // Same layout as written by AWDChunkedLzmaSink
+        this->lzma_in_left = AWDCursor(this->in_buf + this->in_pos, sizeof(awd_uint32)).get_ui32();
+        this->in_pos += sizeof(awd_uint32);
+
+        return this->begin_lzma();
+    }
+
+    if (this->in_pos == this->in_len && !this->fill_input(1))
+        return false;
+
+    src_len = this->in_len - this->in_pos;
+    if (src_len > this->lzma_in_left)
+        src_len = this->lzma_in_left;
+
+    dst_len = this->lzma_out_left;
+    if (dst_len > AWD_ZCHUNK_SIZE)
+        dst_len = AWD_ZCHUNK_SIZE;
+
+    res = LzmaDec_DecodeToBuf((CLzmaDec *)this->lzma, this->out->reserve(dst_len), &dst_len,
+        this->in_buf + this->in_pos, &src_len, LZMA_FINISH_ANY, &status);
+
+    this->out->advance(dst_len);
+    this->in_pos += src_len;
+    this->lzma_in_left -= src_len;
+    this->lzma_out_left -= (awd_uint32)dst_len;
+
+    if (res != SZ_OK) {
+        printf("Could not decode LZMA body\n");
+        return false;
+    }
+
+    // No progress means that input ran out (or that the stream
+    // ended early, with an end marker.)
+    if (src_len == 0 && dst_len == 0) {
+        printf("Truncated LZMA body\n");
+        return false;
+    }
+
+    return true;
+}
+
+
+#ifdef AWD_WITH_ZSTD
+bool
+AWDStreamDecoder::decode_zstd()
+{
+    size_t ret;
+    size_t out_size;
+    ZSTD_inBuffer in;
+    ZSTD_outBuffer zout;
+
+    if (this->in_pos == this->in_len && !this->fill_input(1))
+        return false;
+
+    in.src = this->in_buf + this->in_pos;
+    in.size = this->in_len - this->in_pos;
+    in.pos = 0;
+
+    out_size = ZSTD_DStreamOutSize();
+    zout.dst = this->out->reserve(out_size);
+    zout.size = out_size;
+    zout.pos = 0;
+
+    ret = ZSTD_decompressStream(this->zstd, &zout, &in);
+    if (ZSTD_isError(ret)) {
+        printf("Zstandard error: %s\n", ZSTD_getErrorName(ret));
+        return false;
+    }
+
+    this->out->advance(zout.pos);
+    this->in_pos += in.pos;
+
+    // Frame is complete once all of its output is flushed
+    if (ret == 0) {
+        this->body_done = true;
+        return true;
+    }
+
+    if (in.size == 0 && zout.pos == 0) {
+        printf("Truncated Zstandard body\n");
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+
+#ifdef AWD_WITH_LZ4
+bool
+AWDStreamDecoder::decode_lz4()
+{
+    size_t ret;
+    size_t in_len;
+    size_t out_len;
+
+    if (this->in_pos == this->in_len && !this->fill_input(1))
+        return false;
+
+    in_len = this->in_len - this->in_pos;
+    out_len = AWD_ZCHUNK_SIZE;
+
+    ret = LZ4F_decompress(this->lz4, this->out->reserve(out_len), &out_len,
+        this->in_buf + this->in_pos, &in_len, NULL);
+    if (LZ4F_isError(ret)) {
+        printf("LZ4 error: %s\n", LZ4F_getErrorName(ret));
+        return false;
+    }
+
+    this->out->advance(out_len);
+    this->in_pos += in_len;
+
+    // Zero means that the frame is complete
+    if (ret == 0) {
+        this->body_done = true;
+        return true;
+    }
+
+    if (in_len == 0 && out_len == 0) {
+        printf("Truncated LZ4 body\n");
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+
+bool
+AWDStreamDecoder::decode_more()
+{
+    // Drop blocks that have already been passed on, so that only the
+    // block currently being received is kept in memory.
+    if (this->out_pos > 0) {
+        this->out->discard(this->out_pos);
+        this->out_pos = 0;
+    }
+
+    switch (this->compression) {
+        case UNCOMPRESSED:
+            if (this->in_pos == this->in_len && !this->fill_input(1))
+                return false;
+
+            if (this->in_pos == this->in_len) {
+                this->body_done = true;
+                return true;
+            }
+
+            this->out->write_bytes(this->in_buf + this->in_pos, this->in_len - this->in_pos);
+            this->in_pos = this->in_len;
+            return true;
+
+        case DEFLATE:
+            return this->decode_inflate();
+
+        case LZMA:
+        case LZMA_CHUNKED:
+            return this->decode_lzma();
+
+#ifdef AWD_WITH_ZSTD
+        case ZSTD:
+            return this->decode_zstd();
+#endif
+
+#ifdef AWD_WITH_LZ4
+        case LZ4:
+            return this->decode_lz4();
+#endif
+
+        default:
+            return false;
+    }
+}
+
+
+// Returns -1 on errors, zero if decoding should stop, or one if
+// more data is needed before the next block can be passed on.
+int
+AWDStreamDecoder::emit_blocks(awd_block_func func, void *user)
+{
+    for (;;) {
+        size_t avail;
+        AWD_block_view block;
+        AWD_data_view body;
+        AWD_compression type;
+        AWDCursor cur(NULL, 0);
+
+        avail = this->out->get_length() - this->out_pos;
+        if (avail < AWD_BLOCK_HEADER_LENGTH)
+            return 1;
+
+        // Same layout as written by AWDBlock::write_header()
+        cur = AWDCursor(this->out->get_buffer() + this->out_pos, avail);
+        block.addr = cur.get_ui32();
+        block.ns = cur.get_ui8();
+        block.type = (AWD_block_type)cur.get_ui8();
+        block.flags = cur.get_ui8();
+        block.offset = AWD_HEADER_LENGTH + this->out_offset;
+        block.stored.length = cur.get_ui32();
+        block.stored.data = cur.get_bytes(block.stored.length);
+
+        // Rest of block has not been decoded yet
+        if (cur.has_error())
+            return 1;
+
+        body = block.stored;
+        type = (AWD_compression)(block.flags >> AWD_BLOCK_COMPRESSION_SHIFT);
+        if (type != UNCOMPRESSED) {
+            awd_uint32 length;
+            AWDCursor bcur(block.stored.data, block.stored.length);
+
+            // Same as AWDReader::get_body(), but into a buffer that is
+            // reused for every block.
+            this->block_body->reset();
+            length = bcur.get_ui32();
+            if (bcur.has_error() || !awdcomp_decompress(type, bcur.get_pointer(), bcur.get_remaining(),
+                    this->block_body, awdthread_resolve_count(this->num_threads))) {
+                printf("Could not decompress block %u\n", block.addr);
+                return -1;
+            }
+
+            if (this->block_body->get_length() != length) {
+                printf("Block %u decompressed to %u bytes, expected %u\n", block.addr,
+                    (awd_uint32)this->block_body->get_length(), length);
+                return -1;
+            }
+
+            body.data = this->block_body->get_buffer();
+            body.length = length;
+        }
+
+        this->out_pos += AWD_BLOCK_HEADER_LENGTH + block.stored.length;
+        this->out_offset += AWD_BLOCK_HEADER_LENGTH + block.stored.length;
+
+        if (!func(&block, body, user))
+            return 0;
+
+        // TOC is always the last block, and only followed by the
+        // footer, which doesn't count towards the body length.
+        if (block.type == TOC)
+            return 0;
+    }
+}
+
+
+bool
+AWDStreamDecoder::decode(awd_block_func func, void *user)
+{
+    int ret;
+
+    if (!this->read_header() || !this->init_decompressor())
+        return false;
+
+    for (;;) {
+        ret = this->emit_blocks(func, user);
+        if (ret < 0)
+            return false;
+
+        if (ret == 0)
+            return true;
+
+        if (this->body_done)
+            break;
+
+        if (!this->decode_more())
+            return false;
+    }
+
+    if (this->out->get_length() > this->out_pos) {
+        printf("Truncated block at offset %u\n", (awd_uint32)(AWD_HEADER_LENGTH + this->out_offset));
+        return false;
+    }
+
+    return true;
+}
@@ -89,26 +89,22 @@ AWDBitmapTexture::prepare_write()
 
 
 void
-AWDBitmapTexture::write_body(int fd, bool wide_mtx)
+AWDBitmapTexture::write_body(AWDOutputStream *out, bool wide_mtx)
 {
-    awd_uint32 data_len;
+    out->put_varstr(this->get_name(), this->get_name_length());
 
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-
-    write(fd, &this->type, sizeof(awd_uint8));
+    out->put_ui8((awd_uint8)this->type);
     if (this->type == EXTERNAL) {
-        data_len = UI32(this->url_len);
-        write(fd, &data_len, sizeof(awd_uint32));
-        write(fd, this->url, this->url_len);
+        out->put_ui32(this->url_len);
+        out->put_bytes(this->url, this->url_len);
     }
     else {
-        data_len = UI32(this->embed_data_len);
-        write(fd, &data_len, sizeof(awd_uint32));
-        write(fd, this->embed_data, this->embed_data_len);
+        out->put_ui32(this->embed_data_len);
+        out->put_bytes(this->embed_data, this->embed_data_len);
     }
 
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
@@ -163,30 +159,29 @@ AWDCubeTexture::prepare_write()
 
 
 void
-AWDCubeTexture::write_dir_tex(int fd, AWD_cube_dir dir)
+AWDCubeTexture::write_dir_tex(AWDOutputStream *out, AWD_cube_dir dir)
 {
     AWDBlock *side;
 
     side = this->sides[(int)dir];
     if (side != NULL) {
-        awd_baddr addr = UI32(side->get_addr());
-        write(fd, &addr, sizeof(awd_baddr));
+        out->put_ui32(side->get_addr());
     }
 }
 
 
 void
-AWDCubeTexture::write_body(int fd, bool wide_mtx)
-{
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
-    this->write_dir_tex(fd, POS_X);
-    this->write_dir_tex(fd, NEG_X);
-    this->write_dir_tex(fd, POS_Y);
-    this->write_dir_tex(fd, NEG_Y);
-    this->write_dir_tex(fd, POS_Z);
-    this->write_dir_tex(fd, NEG_Z);
-
-    this->properties->write_attributes(fd, wide_mtx);
-    this->user_attributes->write_attributes(fd, wide_mtx);
+AWDCubeTexture::write_body(AWDOutputStream *out, bool wide_mtx)
+{
+    out->put_varstr(this->get_name(), this->get_name_length());
+    this->write_dir_tex(out, POS_X);
+    this->write_dir_tex(out, NEG_X);
+    this->write_dir_tex(out, POS_Y);
+    this->write_dir_tex(out, NEG_Y);
+    this->write_dir_tex(out, POS_Z);
+    this->write_dir_tex(out, NEG_Z);
+
+    this->properties->write_attributes(out, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
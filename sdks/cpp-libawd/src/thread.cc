@@ -0,0 +1,176 @@
+#include <stdlib.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "thread.h"
+
+
+// Jobs are handed out one at a time to whichever worker asks first,
+// so that workers that get short jobs go on to take more of them,
+// instead of waiting for workers that got long ones.
+typedef struct {
+    awd_job_func func;
+    void **jobs;
+    int num_jobs;
+    int next_job;
+#ifdef WIN32
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} awd_job_queue;
+
+
+static int
+awdthread_take_job(awd_job_queue *q)
+{
+    int idx;
+
+#ifdef WIN32
+    EnterCriticalSection(&q->lock);
+    idx = q->next_job++;
+    LeaveCriticalSection(&q->lock);
+#else
+    pthread_mutex_lock(&q->lock);
+    idx = q->next_job++;
+    pthread_mutex_unlock(&q->lock);
+#endif
+
+    return idx;
+}
+
+
+static void
+awdthread_work(awd_job_queue *q)
+{
+    int i;
+
+    while ((i = awdthread_take_job(q)) < q->num_jobs) {
+        q->func(q->jobs[i]);
+    }
+}
+
+
+#ifdef WIN32
+static DWORD WINAPI
+awdthread_main(LPVOID arg)
+{
+    awdthread_work((awd_job_queue *)arg);
+    return 0;
+}
+#else
+static void *
+awdthread_main(void *arg)
+{
+    awdthread_work((awd_job_queue *)arg);
+    return NULL;
+}
+#endif
+
+
+int
+awdthread_num_cpus()
+{
+    int num;
+
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    num = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    num = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    num = 1;
+#endif
+
+    if (num < 1)
+        num = 1;
+
+    return num;
+}
+
+
+int
+awdthread_resolve_count(int num_threads)
+{
+    // Zero (or negative) means one thread per CPU
+    if (num_threads <= 0)
+        return awdthread_num_cpus();
+
+    return num_threads;
+}
+
+
+void
+awdthread_run_jobs(awd_job_func func, void **jobs, int num_jobs, int num_threads)
+{
+    int i;
+    int num_started;
+    awd_job_queue queue;
+#ifdef WIN32
+    HANDLE *threads;
+#else
+    pthread_t *threads;
+#endif
+
+    if (num_threads > num_jobs)
+        num_threads = num_jobs;
+
+    // Nothing to gain from threads, run jobs right here
+    if (num_threads <= 1) {
+        for (i=0; i<num_jobs; i++)
+            func(jobs[i]);
+        return;
+    }
+
+    queue.func = func;
+    queue.jobs = jobs;
+    queue.num_jobs = num_jobs;
+    queue.next_job = 0;
+#ifdef WIN32
+    InitializeCriticalSection(&queue.lock);
+    threads = (HANDLE *)malloc(num_threads * sizeof(HANDLE));
+#else
+    pthread_mutex_init(&queue.lock, NULL);
+    threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
+#endif
+
+    // The calling thread works on the queue as well. If a thread
+    // can not be started, the remaining threads take its share.
+    num_started = 0;
+    for (i=1; i<num_threads; i++) {
+#ifdef WIN32
+        threads[i] = CreateThread(NULL, 0, awdthread_main, &queue, 0, NULL);
+        if (threads[i] == NULL)
+            break;
+#else
+        if (pthread_create(&threads[i], NULL, awdthread_main, &queue) != 0)
+            break;
+#endif
+        num_started++;
+    }
+
+    awdthread_work(&queue);
+
+    for (i=1; i<=num_started; i++) {
+#ifdef WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+
+#ifdef WIN32
+    DeleteCriticalSection(&queue.lock);
+#else
+    pthread_mutex_destroy(&queue.lock);
+#endif
+
+    free(threads);
+}
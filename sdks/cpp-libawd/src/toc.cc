@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include "toc.h"
+#include "name.h"
+#include "util.h"
+
+#include "platform.h"
+
+
+AWDTocBlock::AWDTocBlock() :
+    AWDBlock(TOC)
+{
+    this->entries = NULL;
+    this->num_entries = 0;
+    this->max_entries = 0;
+}
+
+
+AWDTocBlock::~AWDTocBlock()
+{
+    if (this->entries) {
+        free(this->entries);
+        this->entries = NULL;
+    }
+}
+
+
+void
+AWDTocBlock::add_entry(AWDBlock *block, awd_uint64 offset, AWD_block_info *info)
+{
+    AWD_toc_entry *entry;
+    AWDNamedElement *named;
+
+    if (this->num_entries == this->max_entries) {
+        this->max_entries = this->max_entries? 2*this->max_entries : 64;
+        this->entries = (AWD_toc_entry *)realloc(this->entries,
+            this->max_entries * sizeof(AWD_toc_entry));
+    }
+
+    entry = &this->entries[this->num_entries++];
+    entry->addr = block->get_addr();
+    entry->type = (awd_uint8)block->get_type();
+    entry->flags = info->flags;
+    entry->offset = offset;
+    entry->stored_length = info->stored_length;
+    entry->length = info->length;
+
+    // Not all blocks have names
+    named = dynamic_cast<AWDNamedElement *>(block);
+    if (named)
+        entry->name_hash = awdutil_hash_name(named->get_name(), named->get_name_length());
+    else
+        entry->name_hash = 0;
+}
+
+
+awd_uint32
+AWDTocBlock::get_num_entries()
+{
+    return this->num_entries;
+}
+
+
+awd_uint32
+AWDTocBlock::calc_body_length(bool wide_mtx)
+{
+    return sizeof(awd_uint32) + this->num_entries * AWD_TOC_ENTRY_LENGTH;
+}
+
+
+void
+AWDTocBlock::write_body(AWDOutputStream *out, bool wide_mtx)
+{
+    awd_uint32 i;
+
+    out->put_ui32(this->num_entries);
+    for (i=0; i<this->num_entries; i++) {
+        AWD_toc_entry *entry = &this->entries[i];
+
+        out->put_ui32(entry->addr);
+        out->put_ui8(entry->type);
+        out->put_ui8(entry->flags);
+        out->put_ui64(entry->name_hash);
+        out->put_ui64(entry->offset);
+        out->put_ui32(entry->stored_length);
+        out->put_ui32(entry->length);
+    }
+}
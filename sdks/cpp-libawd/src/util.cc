@@ -3,9 +3,9 @@
 #include <cstdio>
 
 #include "util.h"
+#include "field.h"
 #include "awd_types.h"
 
-// Get mkstemp replacement
 #include "platform.h"
 
 awd_float64 *
@@ -24,118 +24,40 @@ awdutil_id_mtx4x4(awd_float64 *mtx)
 }
 
 
-//TODO: Consider replacing with macro
+#define AWD_FIELD_SIZE(F) \
+    case F: return wide_mtx? (size_t)AWDField<F>::wide_size : (size_t)AWDField<F>::size;
+
 size_t
 awdutil_get_type_size(AWD_field_type type, bool wide_mtx)
 {
-    size_t elem_size;
-
+    // Sizes are known at compile time (see field.h)
     switch (type) {
-        case AWD_FIELD_INT8:
-        case AWD_FIELD_BOOL:
-        case AWD_FIELD_UINT8:
-            elem_size = sizeof(awd_int8);
-            break;
-
-        case AWD_FIELD_INT16:
-        case AWD_FIELD_UINT16:
-            elem_size = sizeof(awd_int16);
-            break;
-
-        case AWD_FIELD_INT32:
-        case AWD_FIELD_UINT32:
-        case AWD_FIELD_FLOAT32:
-        case AWD_FIELD_COLOR:
-        case AWD_FIELD_BADDR:
-            elem_size = sizeof(awd_int32);
-            break;
-
-        case AWD_FIELD_FLOAT64:
-            elem_size = sizeof(awd_float64);
-            break;
-
-        case AWD_FIELD_VECTOR2x1:
-            elem_size = VEC2_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_VECTOR3x1:
-            elem_size = VEC3_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_VECTOR4x1:
-            elem_size = VEC4_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_MTX3x2:
-            elem_size = MTX32_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_MTX3x3:
-            elem_size = MTX33_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_MTX4x3:
-            elem_size = MTX43_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_MTX4x4:
-            elem_size = MTX44_SIZE(wide_mtx);
-            break;
-
-        case AWD_FIELD_STRING:
-        case AWD_FIELD_BYTEARRAY:
-            // Can't know
-            elem_size = 0;
-            break;
-    }
-
-    return elem_size;
-
-}
-
-
-awd_uint32
-awdutil_write_floats(int fd, awd_float64 *list, int len, bool wide)
-{
-    int i;
-    awd_uint32 bytes_written = 0;
-
-    for (i=0; i<len; i++) {
-        if (wide) {
-            awd_float64 n;
-            n = F64(list[i]);
-            write(fd, &n, sizeof(awd_float64));
-            bytes_written += sizeof(awd_float64);
-        }
-        else {
-            awd_float32 n;
-            n = F32((awd_float32)list[i]);
-            write(fd, &n, sizeof(awd_float32));
-            bytes_written += sizeof(awd_float64);
-        }
+        AWD_FIELD_SIZE(AWD_FIELD_INT8)
+        AWD_FIELD_SIZE(AWD_FIELD_INT16)
+        AWD_FIELD_SIZE(AWD_FIELD_INT32)
+        AWD_FIELD_SIZE(AWD_FIELD_UINT8)
+        AWD_FIELD_SIZE(AWD_FIELD_UINT16)
+        AWD_FIELD_SIZE(AWD_FIELD_UINT32)
+        AWD_FIELD_SIZE(AWD_FIELD_FLOAT32)
+        AWD_FIELD_SIZE(AWD_FIELD_FLOAT64)
+        AWD_FIELD_SIZE(AWD_FIELD_BOOL)
+        AWD_FIELD_SIZE(AWD_FIELD_COLOR)
+        AWD_FIELD_SIZE(AWD_FIELD_BADDR)
+        AWD_FIELD_SIZE(AWD_FIELD_VECTOR2x1)
+        AWD_FIELD_SIZE(AWD_FIELD_VECTOR3x1)
+        AWD_FIELD_SIZE(AWD_FIELD_VECTOR4x1)
+        AWD_FIELD_SIZE(AWD_FIELD_MTX3x2)
+        AWD_FIELD_SIZE(AWD_FIELD_MTX3x3)
+        AWD_FIELD_SIZE(AWD_FIELD_MTX4x3)
+        AWD_FIELD_SIZE(AWD_FIELD_MTX4x4)
+
+        default:
+            // Can't know (strings and byte arrays)
+            return 0;
     }
-
-    return bytes_written;
 }
 
-
-awd_uint32
-awdutil_write_varstr(int fd, const char *str, awd_uint16 str_len)
-{
-    awd_uint16 len_be;
-
-    if (str != NULL) {
-        len_be = UI16(str_len);
-        write(fd, &len_be, sizeof(awd_uint16));
-        write(fd, str, str_len);
-    }
-    else {
-        len_be = 0;
-        write(fd, &len_be, sizeof(awd_uint16));
-    }
-
-    return str_len + sizeof(awd_uint16);
-}
+#undef AWD_FIELD_SIZE
 
 
 awd_color
@@ -152,49 +74,6 @@ awdutil_int_color(int r, int g, int b, int a)
 }
 
 
-int
-awdutil_mktmp(char **path)
-{
-    int fd;
-    int tpl_len;
-    char *tmp_path;
-
-#ifdef WIN32
-    int ret;
-	int path_len;
-
-    tmp_path = (char*)malloc(TMPPATH_MAXLEN);
-
-    tpl_len = strlen(TMPFILE_TEMPLATE);
-	path_len = GetTempPath(TMPPATH_MAXLEN, tmp_path);
-    if (path_len==0 || (path_len+tpl_len) > TMPPATH_MAXLEN)
-        return -1;
-
-    // Concatenate path and template and null-terminate.
-    strncpy(tmp_path+path_len, TMPFILE_TEMPLATE, tpl_len);
-    memset(tmp_path+path_len+tpl_len, 0, 1);
-
-    ret = _mktemp_s(tmp_path, path_len+tpl_len+1);
-	if (ret==0)
-		fd = _open(tmp_path, _O_CREAT|_O_TEMPORARY|_O_RDWR|_O_BINARY, _S_IWRITE);
-	else fd = -1;
-
-#else
-    tpl_len = strlen(TMPFILE_TEMPLATE);
-    tmp_path = (char *)malloc(tpl_len);
-    strncpy(tmp_path, TMPFILE_TEMPLATE, tpl_len);
-
-    fd = mkstemp(tmp_path);
-#endif
-
-    if (path)
-	    *path = tmp_path;
-    else free(tmp_path);
-
-    return fd;
-}
-
-
 awd_uint16
 awdutil_swapui16(awd_uint16 n)
 {
@@ -229,6 +108,27 @@ awdutil_swapui32(awd_uint32 n)
     return out.i;
 }
 
+awd_uint64
+awdutil_swapui64(awd_uint64 n)
+{
+    union {
+        awd_uint64 i;
+        awd_uint8 b[8];
+    } in, out;
+
+    in.i = n;
+    out.b[0] = in.b[7];
+    out.b[1] = in.b[6];
+    out.b[2] = in.b[5];
+    out.b[3] = in.b[4];
+    out.b[4] = in.b[3];
+    out.b[5] = in.b[2];
+    out.b[6] = in.b[1];
+    out.b[7] = in.b[0];
+
+    return out.i;
+}
+
 awd_float32 
 awdutil_swapf32(awd_float32 n)
 {
@@ -268,6 +168,22 @@ awdutil_swapf64(awd_float64 n)
 }
 
 
+awd_uint64
+awdutil_hash_name(const char *name, awd_uint16 name_len)
+{
+    awd_uint16 i;
+    awd_uint64 hash;
+
+    // Unnamed elements hash to zero
+    if (name == NULL || name_len == 0)
+        return 0;
+
+    // 64-bit FNV-1a
+    hash = 0xcbf29ce484222325ULL;
+    for (i=0; i<name_len; i++) {
+        hash ^= (awd_uint8)name[i];
+        hash *= 0x100000001b3ULL;
+    }
 
-
-
+    return hash;
+}
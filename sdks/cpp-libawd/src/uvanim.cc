@@ -50,29 +50,24 @@ AWDUVAnimation::calc_body_length(bool wide_mtx)
 
 
 void
-AWDUVAnimation::write_body(int fd, bool wide_mtx)
+AWDUVAnimation::write_body(AWDOutputStream *out, bool wide_mtx)
 {
     AWD_uvanim_fr *cur_fr;
 
-    awd_uint16 num_frames;
-    awdutil_write_varstr(fd, this->get_name(), this->get_name_length());
+    out->put_varstr(this->get_name(), this->get_name_length());
+    out->put_ui16(this->num_frames);
 
-    num_frames = UI16(this->num_frames);
-    write(fd, &num_frames, sizeof(awd_uint16));
-
-    this->properties->write_attributes(fd, wide_mtx);
+    this->properties->write_attributes(out, wide_mtx);
 
     cur_fr = this->first_frame;
     while (cur_fr) {
-        awd_uint16 dur_be = UI16(cur_fr->duration);
-
-        awdutil_write_floats(fd, cur_fr->transform_mtx, 12, wide_mtx);
-        write(fd, &dur_be, sizeof(awd_uint16));
+        out->put_floats(cur_fr->transform_mtx, 12, wide_mtx);
+        out->put_ui16(cur_fr->duration);
 
         cur_fr = cur_fr->next;
     }
 
-    this->user_attributes->write_attributes(fd, wide_mtx);
+    this->user_attributes->write_attributes(out, wide_mtx);
 }
 
 
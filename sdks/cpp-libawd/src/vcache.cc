@@ -0,0 +1,291 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vcache.h"
+
+#include "platform.h"
+
+
+// Scoring parameters from the original description of the algorithm
+#define AWD_VCACHE_DECAY_POWER 1.5
+#define AWD_VCACHE_LAST_TRI_SCORE 0.75
+#define AWD_VCACHE_VALENCE_BOOST_SCALE 2.0
+#define AWD_VCACHE_VALENCE_BOOST_POWER 0.5
+
+// Cache size range that the optimizer works with
+#define AWD_VCACHE_MIN_SIZE 4
+#define AWD_VCACHE_MAX_SIZE 64
+
+
+static int
+awdvcache_clamp_size(int cache_size)
+{
+    if (cache_size <= 0)
+        return AWD_VCACHE_SIZE;
+    if (cache_size < AWD_VCACHE_MIN_SIZE)
+        return AWD_VCACHE_MIN_SIZE;
+    if (cache_size > AWD_VCACHE_MAX_SIZE)
+        return AWD_VCACHE_MAX_SIZE;
+
+    return cache_size;
+}
+
+
+void
+awdvcache_measure(const awd_uint32 *tris, awd_uint32 num_indices, awd_uint32 num_verts,
+    int cache_size, AWD_vcache_stats *stats)
+{
+    awd_uint32 i;
+    awd_uint32 misses;
+    awd_uint32 num_used;
+    awd_uint32 *inserted;
+
+    stats->acmr = 0.0;
+    stats->atvr = 0.0;
+    if (num_indices < 3 || num_verts == 0)
+        return;
+
+    cache_size = awdvcache_clamp_size(cache_size);
+
+    // A vertex is in the FIFO cache if fewer than cache_size other
+    // vertices were inserted after it, which can be told from the
+    // miss count at the time it was inserted.
+    inserted = (awd_uint32 *)malloc(num_verts * sizeof(awd_uint32));
+    memset(inserted, 0xff, num_verts * sizeof(awd_uint32));
+
+    misses = 0;
+    num_used = 0;
+    for (i=0; i<num_indices; i++) {
+        awd_uint32 v = tris[i];
+
+        if (v >= num_verts)
+            continue;
+
+        if (inserted[v] == 0xffffffff)
+            num_used++;
+        else if (misses - inserted[v] < (awd_uint32)cache_size)
+            continue;
+
+        inserted[v] = misses++;
+    }
+
+    free(inserted);
+
+    stats->acmr = (double)misses / (num_indices / 3);
+    stats->atvr = (double)misses / num_used;
+}
+
+
+static double
+awdvcache_vert_score(int cache_pos, awd_uint32 num_tris, int cache_size)
+{
+    double score;
+
+    // No triangles left to add, so vertex is of no interest
+    if (num_tris == 0)
+        return -1.0;
+
+    score = 0.0;
+    if (cache_pos >= 0) {
+        if (cache_pos < 3) {
+            // Vertices of the most recent triangle get a fixed score,
+            // so that the same triangle isn't favored over others that
+            // use the same vertices, whatever order they are in.
+            score = AWD_VCACHE_LAST_TRI_SCORE;
+        }
+        else {
+            double scaler = 1.0 / (cache_size - 3);
+            score = pow(1.0 - (cache_pos - 3) * scaler, AWD_VCACHE_DECAY_POWER);
+        }
+    }
+
+    // Boost vertices with few triangles left, to get rid of lone
+    // triangles that would otherwise require a vertex later on.
+    score += AWD_VCACHE_VALENCE_BOOST_SCALE * pow((double)num_tris, -AWD_VCACHE_VALENCE_BOOST_POWER);
+
+    return score;
+}
+
+
+void
+awdvcache_optimize(awd_uint32 *tris, awd_uint32 num_indices, awd_uint32 num_verts, int cache_size)
+{
+    awd_uint32 i, t, v;
+    awd_uint32 num_tris;
+    awd_uint32 num_added;
+    awd_uint32 next_tri;
+    int best_tri;
+    double best_score;
+
+    awd_uint32 *vert_offset;
+    awd_uint32 *vert_active;
+    awd_uint32 *vert_tris;
+    int *vert_cache_pos;
+    double *vert_score;
+    double *tri_score;
+    bool *tri_added;
+    awd_uint32 *out;
+
+    int num_cached;
+    int *cache;
+    int *new_cache;
+
+    num_tris = num_indices / 3;
+    if (num_tris < 2 || num_verts == 0)
+        return;
+
+    // Only valid triangle lists can be reordered
+    for (i=0; i<num_tris*3; i++) {
+        if (tris[i] >= num_verts)
+            return;
+    }
+
+    cache_size = awdvcache_clamp_size(cache_size);
+
+    // Triangles using each vertex, of which the first vert_active are
+    // those not yet added to the output.
+    vert_offset = (awd_uint32 *)calloc(num_verts + 1, sizeof(awd_uint32));
+    vert_active = (awd_uint32 *)calloc(num_verts, sizeof(awd_uint32));
+    vert_tris = (awd_uint32 *)malloc(num_tris * 3 * sizeof(awd_uint32));
+
+    for (i=0; i<num_tris*3; i++)
+        vert_offset[tris[i]+1]++;
+    for (v=0; v<num_verts; v++)
+        vert_offset[v+1] += vert_offset[v];
+    for (i=0; i<num_tris*3; i++) {
+        v = tris[i];
+        vert_tris[vert_offset[v] + vert_active[v]++] = i / 3;
+    }
+
+    vert_cache_pos = (int *)malloc(num_verts * sizeof(int));
+    vert_score = (double *)malloc(num_verts * sizeof(double));
+    for (v=0; v<num_verts; v++) {
+        vert_cache_pos[v] = -1;
+        vert_score[v] = awdvcache_vert_score(-1, vert_active[v], cache_size);
+    }
+
+    tri_score = (double *)malloc(num_tris * sizeof(double));
+    tri_added = (bool *)calloc(num_tris, sizeof(bool));
+
+    best_tri = -1;
+    best_score = -1.0;
+    for (t=0; t<num_tris; t++) {
+        tri_score[t] = vert_score[tris[t*3+0]] + vert_score[tris[t*3+1]] + vert_score[tris[t*3+2]];
+        if (tri_score[t] > best_score) {
+            best_score = tri_score[t];
+            best_tri = t;
+        }
+    }
+
+    // Room for a full cache plus the vertices of a new triangle
+    cache = (int *)malloc((cache_size + 3) * sizeof(int));
+    new_cache = (int *)malloc((cache_size + 3) * sizeof(int));
+    num_cached = 0;
+
+    out = (awd_uint32 *)malloc(num_tris * 3 * sizeof(awd_uint32));
+    next_tri = 0;
+
+    for (num_added=0; num_added<num_tris; num_added++) {
+        int c;
+        int num_new;
+        int *tmp;
+
+        // If no triangle in the cache is of any use, continue with
+        // the next triangle in the original order.
+        if (best_tri < 0) {
+            while (tri_added[next_tri])
+                next_tri++;
+
+            best_tri = next_tri;
+        }
+
+        t = best_tri;
+        tri_added[t] = true;
+        memcpy(&out[num_added*3], &tris[t*3], 3 * sizeof(awd_uint32));
+
+        // Remove triangle from the active triangles of its vertices,
+        // and put those vertices first in the cache.
+        num_new = 0;
+        for (i=0; i<3; i++) {
+            awd_uint32 *vt;
+            awd_uint32 j;
+
+            v = tris[t*3+i];
+            vt = &vert_tris[vert_offset[v]];
+            for (j=0; j<vert_active[v]; j++) {
+                if (vt[j] == t) {
+                    vt[j] = vt[vert_active[v]-1];
+                    vt[vert_active[v]-1] = t;
+                    vert_active[v]--;
+                    break;
+                }
+            }
+
+            for (c=0; c<num_new; c++) {
+                if (new_cache[c] == (int)v)
+                    break;
+            }
+            if (c == num_new)
+                new_cache[num_new++] = v;
+        }
+
+        for (c=0; c<num_cached; c++) {
+            int k;
+
+            for (k=0; k<3; k++) {
+                if (cache[c] == (int)tris[t*3+k])
+                    break;
+            }
+            if (k == 3)
+                new_cache[num_new++] = cache[c];
+        }
+
+        // Update scores of all vertices that were in the cache, or were
+        // just added to it, including any that just fell out of it.
+        for (c=0; c<num_new; c++) {
+            v = new_cache[c];
+            vert_cache_pos[v] = (c < cache_size)? c : -1;
+            vert_score[v] = awdvcache_vert_score(vert_cache_pos[v], vert_active[v], cache_size);
+        }
+
+        // Update scores of the triangles using those vertices, and pick
+        // the best of them to add next.
+        best_tri = -1;
+        best_score = -1.0;
+        for (c=0; c<num_new; c++) {
+            awd_uint32 j;
+            awd_uint32 *vt;
+
+            v = new_cache[c];
+            vt = &vert_tris[vert_offset[v]];
+            for (j=0; j<vert_active[v]; j++) {
+                awd_uint32 at = vt[j];
+
+                tri_score[at] = vert_score[tris[at*3+0]] + vert_score[tris[at*3+1]] + vert_score[tris[at*3+2]];
+                if (tri_score[at] > best_score) {
+                    best_score = tri_score[at];
+                    best_tri = at;
+                }
+            }
+        }
+
+        tmp = cache;
+        cache = new_cache;
+        new_cache = tmp;
+        num_cached = (num_new < cache_size)? num_new : cache_size;
+    }
+
+    memcpy(tris, out, num_tris * 3 * sizeof(awd_uint32));
+
+    free(out);
+    free(cache);
+    free(new_cache);
+    free(tri_added);
+    free(tri_score);
+    free(vert_score);
+    free(vert_cache_pos);
+    free(vert_tris);
+    free(vert_active);
+    free(vert_offset);
+}
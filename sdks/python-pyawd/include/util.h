@@ -11,6 +11,9 @@ awd_float32 *   pyawdutil_pylist_to_float32(PyObject *, awd_float32 *, unsigned
 awd_uint32 *    pyawdutil_pylist_to_uint32(PyObject *, awd_uint32 *, unsigned int);
 awd_uint16 *    pyawdutil_pylist_to_uint16(PyObject *, awd_uint16 *, unsigned int);
 PyObject *      pyawdutil_float64_to_pylist(awd_float64 *, unsigned int);
+PyObject *      pyawdutil_float32_to_pylist(awd_float32 *, unsigned int);
 PyObject *      pyawdutil_uint32_to_pylist(awd_uint32 *, unsigned int);
+PyObject *      pyawdutil_uint16_to_pylist(awd_uint16 *, unsigned int);
+AWDDataStream * pyawdutil_buffer_to_stream(PyObject *, AWD_mesh_str_type, bool);
 
 #endif
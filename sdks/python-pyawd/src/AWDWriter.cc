@@ -80,6 +80,13 @@ cpyawd_AWDWriter_write(cpyawd_AWDWriter *self, PyObject *args)
     PyObject *fobj;
     PyObject *flags_attr;
     PyObject *compression_attr;
+    PyObject *threads_attr;
+    PyObject *pdeflate_attr;
+    PyObject *pblocks_attr;
+    PyObject *level_attr;
+    PyObject *ldm_attr;
+    PyObject *bcomp_attr;
+    PyObject *bthres_attr;
     awd_uint16 flags;
     AWD_compression compression;
     int fd;
@@ -113,6 +120,39 @@ cpyawd_AWDWriter_write(cpyawd_AWDWriter *self, PyObject *args)
     // Create AWD document
     lawd_awd = new AWD(compression,flags);
 
+    threads_attr = PyObject_GetAttrString(awd_obj, "num_threads");
+    if (threads_attr!=NULL) {
+        lawd_awd->set_num_threads((int)PyLong_AsLong(threads_attr));
+    }
+
+    pdeflate_attr = PyObject_GetAttrString(awd_obj, "parallel_deflate");
+    if (pdeflate_attr!=NULL) {
+        lawd_awd->set_parallel_deflate(PyObject_IsTrue(pdeflate_attr)==1);
+    }
+
+    pblocks_attr = PyObject_GetAttrString(awd_obj, "parallel_blocks");
+    if (pblocks_attr!=NULL) {
+        lawd_awd->set_parallel_blocks(PyObject_IsTrue(pblocks_attr)==1);
+    }
+
+    level_attr = PyObject_GetAttrString(awd_obj, "compression_level");
+    if (level_attr!=NULL) {
+        lawd_awd->set_compression_level((int)PyLong_AsLong(level_attr));
+    }
+
+    ldm_attr = PyObject_GetAttrString(awd_obj, "long_distance");
+    if (ldm_attr!=NULL) {
+        lawd_awd->set_long_distance_matching(PyObject_IsTrue(ldm_attr)==1);
+    }
+
+    bcomp_attr = PyObject_GetAttrString(awd_obj, "block_compression");
+    bthres_attr = PyObject_GetAttrString(awd_obj, "block_threshold");
+    if (bcomp_attr!=NULL && bthres_attr!=NULL) {
+        lawd_awd->set_block_compression(
+            (AWD_compression)PyLong_AsLong(bcomp_attr),
+            (awd_uint32)PyLong_AsLong(bthres_attr));
+    }
+
     if (fd >= 0) {
         pyawd_bcache *bcache;
 
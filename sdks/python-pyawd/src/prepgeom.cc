@@ -42,9 +42,9 @@ __prepare_mesh_data(PyObject *block, AWD *awd, pyawd_bcache *bcache)
         num_streams = PyList_Size(streams_list);
         for (str_i=0; str_i<num_streams; str_i++) {
             int data_len;
-			AWD_field_type elem_type;
+            bool indices;
             AWD_mesh_str_type str_type;
-            AWD_str_ptr lawd_data;
+            AWDDataStream *lawd_str;
             PyObject *type;
             PyObject *data;
             PyObject *str_tuple;
@@ -54,24 +54,30 @@ __prepare_mesh_data(PyObject *block, AWD *awd, pyawd_bcache *bcache)
             str_tuple = PyList_GetItem(streams_list, str_i);
             type = PyTuple_GetItem(str_tuple, 0);
             data = PyTuple_GetItem(str_tuple, 1);
-            data_len = PyList_Size(data);
 
             // Read stream type and treat data differently depending on whether it
-            // should be float or integer data.
+            // should be float or integer data. Arrays supporting the buffer protocol
+            // (e.g. numpy arrays) are used without copying, while lists are converted
+            // straight to the type they are written in.
             str_type = (AWD_mesh_str_type)PyLong_AsLong(type);
-            if (str_type == TRIANGLES || str_type == JOINT_INDICES) {
-                lawd_data.ui32 = pyawdutil_pylist_to_uint32(data, NULL, data_len);
-				elem_type = AWD_FIELD_UINT16;
-            }
-            else {
-                lawd_data.f64 = pyawdutil_pylist_to_float64(data, NULL, data_len);
-				elem_type = AWD_FIELD_FLOAT32;
+            indices = (str_type == TRIANGLES || str_type == JOINT_INDICES);
+            lawd_str = pyawdutil_buffer_to_stream(data, str_type, indices);
+            if (lawd_str == NULL) {
+                data_len = PyList_Size(data);
+                if (indices) {
+                    lawd_str = new AWDTypedStream<awd_uint16>(str_type,
+                        pyawdutil_pylist_to_uint16(data, NULL, data_len), data_len);
+                }
+                else {
+                    lawd_str = new AWDTypedStream<awd_float32>(str_type,
+                        pyawdutil_pylist_to_float32(data, NULL, data_len), data_len);
+                }
             }
 
-			// TODO: Make elem_type configurable
+			// TODO: Make element type configurable
 
             // Add stream to libawd sub-mesh
-            lawd_sub->add_stream(str_type, elem_type, lawd_data, data_len);
+            lawd_sub->add_stream(lawd_str);
         }
 
         // Add sub-mesh to libawd mesh data
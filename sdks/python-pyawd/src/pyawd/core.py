@@ -5,6 +5,12 @@ import sys
 UNCOMPRESSED = 0
 DEFLATE = 1
 LZMA = 2
+LZMA_CHUNKED = 3
+ZSTD = 4
+LZ4 = 5
+
+# Selects the default compression level of each codec
+DEFAULT_LEVEL = -1
 
 
 class AWDBlockBase(object):
@@ -59,8 +65,18 @@ class AWDAttrElement(object):
 
 class AWD(object):
 
-    def __init__(self, compression=0, streaming=False, wide_geom=False, wide_mtx=False):
+    def __init__(self, compression=0, streaming=False, wide_geom=False, wide_mtx=False, num_threads=0, parallel_deflate=False,
+            compression_level=DEFAULT_LEVEL, long_distance=False,
+            block_compression=UNCOMPRESSED, block_threshold=4096, toc=False, parallel_blocks=False,
+            name_index=False):
         self.compression = compression
+        self.block_compression = block_compression
+        self.block_threshold = block_threshold
+        self.compression_level = compression_level
+        self.long_distance = long_distance
+        self.num_threads = num_threads
+        self.parallel_deflate = parallel_deflate
+        self.parallel_blocks = parallel_blocks
 
         self.flags = 0
         if streaming:
@@ -69,6 +85,10 @@ class AWD(object):
             self.flags |= 2
         if wide_mtx:
             self.flags |= 4
+        if toc:
+            self.flags |= 8
+        if name_index:
+            self.flags |= 16
 
         self.metadata = None
         self.texture_blocks = []
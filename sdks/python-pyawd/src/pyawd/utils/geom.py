@@ -2,6 +2,9 @@ class AWDGeomUtil(object):
     def __init__(self):
         self._vertices = []
         self.normal_threshold = 0.0
+        self.optimize_vertex_cache = False
+        self.vertex_cache_size = 32
+        self.vertex_cache_stats = {}
 
     def append_vert_data(self, index, pos, uv=None, norm=None, joint_wheights=None, joint_indices=None, force_hard = False):
         if uv is None:
@@ -17,5 +20,9 @@ class AWDGeomUtil(object):
         from pyawd.cpyawd import util_build_geom
 
 
-        return util_build_geom(self._vertices, mesh_data, self.normal_threshold)
+        # Filled in with ACMR/ATVR before and after optimization
+        self.vertex_cache_stats = {}
+
+        return util_build_geom(self._vertices, mesh_data, self.normal_threshold,
+            int(self.optimize_vertex_cache), self.vertex_cache_size, self.vertex_cache_stats)
 
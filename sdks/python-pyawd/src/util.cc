@@ -68,6 +68,20 @@ pyawdutil_float64_to_pylist(awd_float64 *buf, unsigned int num_items)
     return list;
 }
 
+PyObject *
+pyawdutil_float32_to_pylist(awd_float32 *buf, unsigned int num_items)
+{
+    unsigned int i;
+    PyObject *list;
+
+    list = PyList_New(num_items);
+    for (i=0; i<num_items; i++) {
+        PyList_SetItem(list, i, PyFloat_FromDouble(buf[i]));
+    }
+
+    return list;
+}
+
 PyObject *
 pyawdutil_uint32_to_pylist(awd_uint32 *buf, unsigned int num_items)
 {
@@ -82,6 +96,20 @@ pyawdutil_uint32_to_pylist(awd_uint32 *buf, unsigned int num_items)
     return list;
 }
 
+PyObject *
+pyawdutil_uint16_to_pylist(awd_uint16 *buf, unsigned int num_items)
+{
+    unsigned int i;
+    PyObject *list;
+
+    list = PyList_New(num_items);
+    for (i=0; i<num_items; i++) {
+        PyList_SetItem(list, i, PyLong_FromLong(buf[i]));
+    }
+
+    return list;
+}
+
 awd_float64 *
 pyawdutil_pylist_to_float64(PyObject *list, awd_float64 *buf, unsigned int num_items)
 {
@@ -192,3 +220,71 @@ pyawdutil_pylist_to_uint16(PyObject *list, awd_uint16 *buf, unsigned int num_ite
     return NULL;
 }
 
+
+static void
+pyawdutil_release_buffer(void *data, void *arg)
+{
+    Py_buffer *view = (Py_buffer *)arg;
+
+    PyBuffer_Release(view);
+    free(view);
+}
+
+AWDDataStream *
+pyawdutil_buffer_to_stream(PyObject *obj, AWD_mesh_str_type str_type, bool indices)
+{
+    char format;
+    awd_uint32 num_items;
+    AWDDataStream *str;
+    Py_buffer *view;
+
+    if (!PyObject_CheckBuffer(obj))
+        return NULL;
+
+    view = (Py_buffer *)malloc(sizeof(Py_buffer));
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0) {
+        PyErr_Clear();
+        free(view);
+        return NULL;
+    }
+
+    // Only native (little-endian) byte order can be used as is
+    format = view->format? view->format[0] : 'B';
+    if (format == '@' || format == '=' || format == '<')
+        format = view->format[1];
+
+    // Buffer (e.g. a numpy array) is written straight from its memory,
+    // and released along with the libawd stream. Integer indices and
+    // doubles are narrowed when written.
+    str = NULL;
+    num_items = (awd_uint32)(view->len / (view->itemsize? view->itemsize : 1));
+    if (indices && format == 'H' && view->itemsize == 2) {
+        str = new AWDTypedStream<awd_uint16>(str_type, (awd_uint16 *)view->buf, num_items,
+            pyawdutil_release_buffer, view);
+    }
+    else if (indices && format == 'I' && view->itemsize == 4) {
+        AWD_str_ptr data;
+
+        data.v = view->buf;
+        str = new AWDGeomDataStream(str_type, AWD_FIELD_UINT16, data, num_items);
+        str->set_release_func(pyawdutil_release_buffer, view);
+    }
+    else if (!indices && format == 'f' && view->itemsize == 4) {
+        str = new AWDTypedStream<awd_float32>(str_type, (awd_float32 *)view->buf, num_items,
+            pyawdutil_release_buffer, view);
+    }
+    else if (!indices && format == 'd' && view->itemsize == 8) {
+        AWD_str_ptr data;
+
+        data.v = view->buf;
+        str = new AWDGeomDataStream(str_type, AWD_FIELD_FLOAT32, data, num_items);
+        str->set_release_func(pyawdutil_release_buffer, view);
+    }
+
+    if (str == NULL) {
+        PyBuffer_Release(view);
+        free(view);
+    }
+
+    return str;
+}
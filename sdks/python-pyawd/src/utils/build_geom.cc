@@ -1,6 +1,8 @@
 #include <awd/mesh.h>
 #include <awd/geomutil.h>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "utils.h"
 #include "util.h"
@@ -10,7 +12,15 @@ cpyawd_util_build_geom(PyObject *self, PyObject *args, PyObject *kwds)
 {
     int i, len;
     int ret;
+    unsigned int num_verts;
+    unsigned int *indices;
+    double *positions, *uvs, *normals;
+    bool *force_hard;
+    vdata_arrays arrays;
     double normal_threshold;
+    int optimize_vertex_cache;
+    int vertex_cache_size;
+    PyObject *stats;
     PyObject *verts_list;
     PyObject *py_md;
     AWDTriGeom *lawd_md;
@@ -19,43 +29,89 @@ cpyawd_util_build_geom(PyObject *self, PyObject *args, PyObject *kwds)
     PyObject *geom_mod;
     PyObject *sub_class;
 
-    static const char *kwlist[] = {"vertices", "mesh_data", "normal_threshold", NULL};
+    static const char *kwlist[] = {"vertices", "mesh_data", "normal_threshold",
+        "optimize_vertex_cache", "vertex_cache_size", "stats", NULL};
 
     normal_threshold = 0.0;
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O|d", (char**)kwlist, 
-                &PyList_Type, &verts_list, &py_md, &normal_threshold))
+    optimize_vertex_cache = 0;
+    vertex_cache_size = AWD_VCACHE_SIZE;
+    stats = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O|diiO!", (char**)kwlist, 
+                &PyList_Type, &verts_list, &py_md, &normal_threshold,
+                &optimize_vertex_cache, &vertex_cache_size, &PyDict_Type, &stats))
         return NULL;
 
     lawd_util = new AWDGeomUtil();
     lawd_util->normal_threshold = normal_threshold;
+    lawd_util->num_threads = 0; // One per CPU
+    lawd_util->optimize_vertex_cache = (optimize_vertex_cache != 0);
+    lawd_util->vertex_cache_size = vertex_cache_size;
 
+    // Unpack vertex tuples into flat arrays, which are then
+    // appended to the util all at once.
     len = PyList_Size(verts_list);
+    indices = (unsigned int *)malloc(len * sizeof(unsigned int));
+    positions = (double *)malloc(len * 3 * sizeof(double));
+    uvs = (double *)malloc(len * 2 * sizeof(double));
+    normals = (double *)malloc(len * 3 * sizeof(double));
+    force_hard = (bool *)malloc(len * sizeof(bool));
+
+    num_verts = 0;
     for (i=0; i<len; i++) {
         PyObject *vert_obj = PyList_GetItem(verts_list, i);
         
         if (PyTuple_Check(vert_obj)) {
-            unsigned int idx;
-            double x, y, z, u, v, nx, ny, nz;
-            bool force_hard;
-
-            idx = PyLong_AsLong(PyTuple_GetItem(vert_obj, 0));
-            x = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 1));
-            y = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 2));
-            z = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 3));
-            u = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 4));
-            v = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 5));
-            nx = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 6));
-            ny = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 7));
-            nz = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 8));
-            force_hard = PyLong_AsLong(PyTuple_GetItem(vert_obj, 9));
-
-            lawd_util->append_vert_data(idx, x, y, z, u, v, nx, ny, nz, force_hard);
+            unsigned int n = num_verts++;
+
+            indices[n] = PyLong_AsLong(PyTuple_GetItem(vert_obj, 0));
+            positions[n*3+0] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 1));
+            positions[n*3+1] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 2));
+            positions[n*3+2] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 3));
+            uvs[n*2+0] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 4));
+            uvs[n*2+1] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 5));
+            normals[n*3+0] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 6));
+            normals[n*3+1] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 7));
+            normals[n*3+2] = PyFloat_AsDouble(PyTuple_GetItem(vert_obj, 8));
+            force_hard[n] = PyLong_AsLong(PyTuple_GetItem(vert_obj, 9));
         }
     }
 
+    memset(&arrays, 0, sizeof(vdata_arrays));
+    arrays.num_verts = num_verts;
+    arrays.indices = indices;
+    arrays.positions = positions;
+    arrays.uvs = uvs;
+    arrays.normals = normals;
+    arrays.force_hard = force_hard;
+    lawd_util->append_vert_arrays(&arrays);
+
+    free(indices);
+    free(positions);
+    free(uvs);
+    free(normals);
+    free(force_hard);
+
     lawd_md = new AWDTriGeom("dummy", 5);
     ret = lawd_util->build_geom(lawd_md);
 
+    // Report vertex cache efficiency before and after optimization
+    if (stats) {
+        PyObject *val;
+
+        val = PyFloat_FromDouble(lawd_util->vcache_before.acmr);
+        PyDict_SetItemString(stats, "acmr_before", val);
+        Py_DECREF(val);
+        val = PyFloat_FromDouble(lawd_util->vcache_before.atvr);
+        PyDict_SetItemString(stats, "atvr_before", val);
+        Py_DECREF(val);
+        val = PyFloat_FromDouble(lawd_util->vcache_after.acmr);
+        PyDict_SetItemString(stats, "acmr_after", val);
+        Py_DECREF(val);
+        val = PyFloat_FromDouble(lawd_util->vcache_after.atvr);
+        PyDict_SetItemString(stats, "atvr_after", val);
+        Py_DECREF(val);
+    }
+
     // Import pyawd.geom module and get the AWDSubMesh classobj, which
     // will be used to instantiate new sub-meshes
     geom_mod = PyImport_ImportModule("pyawd.geom");
@@ -88,12 +144,18 @@ cpyawd_util_build_geom(PyObject *self, PyObject *args, PyObject *kwds)
                 case VERTEX_NORMALS:
                 case VERTEX_TANGENTS:
                 case VERTEX_WEIGHTS:
-                    py_list = pyawdutil_float64_to_pylist(stream->data.f64, stream->get_num_elements());
+                    if (stream->get_storage_type() == AWD_FIELD_FLOAT32)
+                        py_list = pyawdutil_float32_to_pylist(stream->data.f32, stream->get_num_elements());
+                    else
+                        py_list = pyawdutil_float64_to_pylist(stream->data.f64, stream->get_num_elements());
                     break;
 
                 case TRIANGLES:
                 case JOINT_INDICES:
-                    py_list = pyawdutil_uint32_to_pylist(stream->data.ui32, stream->get_num_elements());
+                    if (stream->get_storage_type() == AWD_FIELD_UINT16)
+                        py_list = pyawdutil_uint16_to_pylist(stream->data.ui16, stream->get_num_elements());
+                    else
+                        py_list = pyawdutil_uint32_to_pylist(stream->data.ui32, stream->get_num_elements());
                     break;
             }
 
@@ -0,0 +1,725 @@
+/**
+ * awd-repack: Re-encodes AWD files, e.g. to change their compression,
+ * the precision of their geometry streams or the order of their blocks.
+ *
+ * Blocks are copied as raw, already serialized bodies, keeping their
+ * addresses so that references between blocks remain valid, and only
+ * geometry bodies are rewritten when their precision changes. Files
+ * are processed in parallel, each one on a single thread.
+*/
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "libawd.h"
+#include "thread.h"
+
+
+#define AWDREPACK_KEEP      -1
+
+typedef enum {
+    PRECISION_KEEP=0,
+    PRECISION_NARROW,
+    PRECISION_WIDE
+} awdrepack_precision;
+
+typedef struct {
+    int compression;
+    int block_compression;
+    int level;
+    awd_uint32 threshold;
+    awdrepack_precision precision;
+    bool reorder;
+    int toc;
+    int name_index;
+} awdrepack_options;
+
+typedef struct {
+    char *in_path;
+    char *out_path;
+    awdrepack_options *opts;
+    awd_uint64 in_len;
+    awd_uint64 out_len;
+    bool ok;
+} awdrepack_job;
+
+typedef struct {
+    awdrepack_job *jobs;
+    int num_jobs;
+    int max_jobs;
+} awdrepack_job_list;
+
+
+static const char *awdrepack_compression_names[] = {
+    "none", "deflate", "lzma", "lzma-chunked", "zstd", "lz4", NULL
+};
+
+
+static int
+awdrepack_parse_compression(const char *name)
+{
+    int i;
+
+    for (i=0; awdrepack_compression_names[i]; i++) {
+        if (strcmp(name, awdrepack_compression_names[i]) == 0)
+            return i;
+    }
+
+    printf("Unknown compression: %s\n", name);
+    return AWDREPACK_KEEP;
+}
+
+
+static int
+awdrepack_block_rank(AWD_block_type type)
+{
+    // Same order that blocks are written in by AWD::write_all_blocks(),
+    // in which blocks never refer to blocks that come after them.
+    switch (type) {
+        case METADATA:          return 0;
+        case NAMESPACE:         return 1;
+        case SKELETON:          return 2;
+        case SKELETON_POSE:     return 3;
+        case SKELETON_ANIM:     return 4;
+        case BITMAP_TEXTURE:
+        case CUBE_TEXTURE:      return 5;
+        case SIMPLE_MATERIAL:   return 6;
+        case TRI_GEOM:
+        case PRIM_GEOM:         return 7;
+        case UV_ANIM:           return 8;
+        case SCENE:
+        case CONTAINER:
+        case MESH_INSTANCE:
+        case LIGHT:
+        case CAMERA:            return 9;
+        default:                return 10;
+    }
+}
+
+
+static AWD_field_type
+awdrepack_stream_type(AWD_stream_view *str, awdrepack_precision precision)
+{
+    awd_uint32 i;
+
+    if (precision == PRECISION_WIDE) {
+        if (str->data_type == AWD_FIELD_FLOAT32)
+            return AWD_FIELD_FLOAT64;
+        if (str->data_type == AWD_FIELD_UINT16)
+            return AWD_FIELD_UINT32;
+    }
+    else if (precision == PRECISION_NARROW) {
+        if (str->data_type == AWD_FIELD_FLOAT64)
+            return AWD_FIELD_FLOAT32;
+
+        // Indices are only narrowed if they all fit
+        if (str->data_type == AWD_FIELD_UINT32) {
+            AWDArrayView<awd_uint32> src(str->data);
+
+            for (i=0; i<src.get_num_elements(); i++) {
+                if (src.get(i) > 0xffff)
+                    return AWD_FIELD_UINT32;
+            }
+
+            return AWD_FIELD_UINT16;
+        }
+    }
+
+    return str->data_type;
+}
+
+
+static void
+awdrepack_write_stream(AWDOutputStream *out, AWD_stream_view *str, AWD_field_type data_type)
+{
+    awd_uint32 i;
+    awd_uint32 num_elements;
+
+    out->put_ui8(str->type);
+    out->put_ui8((awd_uint8)data_type);
+
+    if (data_type == str->data_type) {
+        out->put_ui32(str->data.length);
+        out->put_bytes(str->data.data, str->data.length);
+        return;
+    }
+
+    // Only scalar types are ever converted
+    num_elements = str->data.length / awdutil_get_type_size(str->data_type, false);
+    out->put_ui32(num_elements * awdutil_get_type_size(data_type, false));
+
+    if (str->data_type == AWD_FIELD_FLOAT32) {
+        AWDArrayView<awd_float32> src(str->data);
+        for (i=0; i<num_elements; i++)
+            out->put_f64((awd_float64)src.get(i));
+    }
+    else if (str->data_type == AWD_FIELD_FLOAT64) {
+        AWDArrayView<awd_float64> src(str->data);
+        for (i=0; i<num_elements; i++)
+            out->put_f32((awd_float32)src.get(i));
+    }
+    else if (str->data_type == AWD_FIELD_UINT16) {
+        AWDArrayView<awd_uint16> src(str->data);
+        for (i=0; i<num_elements; i++)
+            out->put_ui32((awd_uint32)src.get(i));
+    }
+    else {
+        AWDArrayView<awd_uint32> src(str->data);
+        for (i=0; i<num_elements; i++)
+            out->put_ui16((awd_uint16)src.get(i));
+    }
+}
+
+
+static void
+awdrepack_write_list(AWDOutputStream *out, AWD_data_view list)
+{
+    out->put_ui32(list.length);
+    out->put_bytes(list.data, list.length);
+}
+
+
+static awd_uint8 *
+awdrepack_convert_geom(AWD_data_view body, awdrepack_precision precision, awd_uint32 *len)
+{
+    awd_uint16 i;
+    awd_uint16 name_len;
+    const char *name;
+    size_t buf_len;
+    AWDGeomView geom;
+    AWDMemorySink sink;
+    AWDMemorySink streams;
+
+    if (!geom.parse(body))
+        return NULL;
+
+    // Same layout as written by AWDTriGeom::write_body(), with all
+    // but the streams copied as is.
+    AWDOutputStream out(&sink);
+    name = geom.get_name(&name_len);
+    out.put_varstr(name, name_len);
+    out.put_ui16(geom.get_num_subs());
+    awdrepack_write_list(&out, geom.get_properties());
+
+    for (i=0; i<geom.get_num_subs(); i++) {
+        AWD_sub_view *sub;
+        AWD_stream_view str;
+
+        sub = geom.get_sub_at(i);
+
+        streams.reset();
+        AWDOutputStream str_out(&streams);
+        AWDStreamIterator it(sub->streams);
+        while (it.next(&str)) {
+            awdrepack_write_stream(&str_out, &str, awdrepack_stream_type(&str, precision));
+        }
+        str_out.flush();
+
+        if (it.has_error())
+            return NULL;
+
+        out.put_ui32((awd_uint32)streams.get_length());
+        awdrepack_write_list(&out, sub->properties);
+        out.put_bytes(streams.get_buffer(), streams.get_length());
+        awdrepack_write_list(&out, sub->user_attributes);
+    }
+
+    awdrepack_write_list(&out, geom.get_user_attributes());
+    out.flush();
+
+    *len = (awd_uint32)sink.get_length();
+    return sink.detach_buffer(&buf_len);
+}
+
+
+static bool
+awdrepack_write_file(const char *path, awd_uint8 major, awd_uint8 minor, awd_uint16 flags,
+    AWD_compression compression, AWDMemorySink *body, awd_uint64 toc_offset, awd_uint64 *file_len)
+{
+    int fd;
+    bool ok;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        printf("Could not open %s for writing\n", path);
+        return false;
+    }
+
+    // Same layout as written by AWD::write_header() and
+    // AWD::write_toc_footer()
+    AWDFileSink file_sink(fd);
+    AWDOutputStream *out = new AWDOutputStream(&file_sink);
+    out->put_bytes("AWD", 3);
+    out->put_ui8(major);
+    out->put_ui8(minor);
+    out->put_ui16(flags);
+    out->put_ui8((awd_uint8)compression);
+    out->put_ui32((awd_uint32)body->get_length());
+    out->put_bytes(body->get_buffer(), body->get_length());
+    if (flags & AWD_TOC) {
+        out->put_ui64(toc_offset);
+        out->put_bytes(AWD_TOC_MAGIC, 4);
+    }
+
+    out->flush();
+    *file_len = out->get_position();
+    delete out;
+
+    ok = !file_sink.has_error();
+    close(fd);
+
+    if (!ok)
+        printf("Could not write %s\n", path);
+
+    return ok;
+}
+
+
+static bool
+awdrepack_file(awdrepack_job *job)
+{
+    int i;
+    int rank;
+    int num_blocks;
+    int max_rank;
+    awd_baddr max_addr;
+    awd_uint16 flags;
+    awd_uint64 toc_offset;
+    AWD_compression compression;
+    AWDRawBlock **blocks;
+    AWD_compression *block_comps;
+    AWDTocBlock *toc;
+    AWDNameIndexBlock *name_index;
+    AWDSink *comp_sink;
+    AWDMemorySink body;
+    AWDReader reader;
+    awdrepack_options *opts;
+    bool ok;
+
+    opts = job->opts;
+    reader.set_num_threads(1);
+    if (!reader.open_file(job->in_path))
+        return false;
+
+    compression = reader.get_compression();
+    if (opts->compression != AWDREPACK_KEEP)
+        compression = (AWD_compression)opts->compression;
+
+    // TOC offsets are only meaningful in uncompressed bodies
+    flags = reader.get_flags();
+    if (opts->toc != AWDREPACK_KEEP)
+        flags = opts->toc? (flags | AWD_TOC) : (flags & ~AWD_TOC);
+    if (compression != UNCOMPRESSED)
+        flags &= ~AWD_TOC;
+    if (opts->name_index != AWDREPACK_KEEP)
+        flags = opts->name_index? (flags | AWD_NAME_INDEX) : (flags & ~AWD_NAME_INDEX);
+
+    if (opts->precision == PRECISION_WIDE)
+        flags |= AWD_WIDE_GEOM;
+    else if (opts->precision == PRECISION_NARROW)
+        flags &= ~AWD_WIDE_GEOM;
+
+    num_blocks = 0;
+    blocks = (AWDRawBlock **)malloc(reader.get_num_blocks() * sizeof(AWDRawBlock *));
+    block_comps = (AWD_compression *)malloc(reader.get_num_blocks() * sizeof(AWD_compression));
+
+    ok = true;
+    for (i=0; i<reader.get_num_blocks(); i++) {
+        const char *name;
+        const awd_uint8 *data;
+        awd_uint16 name_len;
+        awd_uint32 len;
+        bool own;
+        AWD_block_view *view;
+        AWD_data_view block_body;
+
+        view = reader.get_block_at(i);
+
+        // TOC and name index are written anew, if at all
+        if (view->type == TOC || view->type == NAME_INDEX)
+            continue;
+
+        if (!reader.get_body(i, &block_body)) {
+            ok = false;
+            break;
+        }
+
+        data = block_body.data;
+        len = block_body.length;
+        own = false;
+        if (view->type == TRI_GEOM && opts->precision != PRECISION_KEEP) {
+            data = awdrepack_convert_geom(block_body, opts->precision, &len);
+            if (data == NULL) {
+                printf("Could not convert geometry %u\n", view->addr);
+                ok = false;
+                break;
+            }
+            own = true;
+        }
+
+        name = awdreader_get_block_name(view->type, block_body, &name_len);
+        blocks[num_blocks] = new AWDRawBlock(view->type, name, name_len, data, len, own);
+        blocks[num_blocks]->set_addr(view->addr);
+
+        block_comps[num_blocks] = (AWD_compression)(view->flags >> AWD_BLOCK_COMPRESSION_SHIFT);
+        if (opts->block_compression != AWDREPACK_KEEP)
+            block_comps[num_blocks] = (AWD_compression)opts->block_compression;
+
+        num_blocks++;
+    }
+
+    comp_sink = ok? awdcomp_create_sink(&body, compression, opts->level, 1, false, false) : NULL;
+    if (comp_sink) {
+        AWDOutputStream *out = new AWDOutputStream(comp_sink);
+
+        toc = NULL;
+        if (flags & AWD_TOC)
+            toc = new AWDTocBlock();
+
+        name_index = NULL;
+        if (flags & AWD_NAME_INDEX)
+            name_index = new AWDNameIndexBlock();
+
+        // Blocks keep their addresses, and are optionally written in
+        // the order of their rank, keeping the order within each rank.
+        max_addr = 0;
+        max_rank = opts->reorder? 10 : 0;
+        for (rank=0; rank<=max_rank; rank++) {
+            for (i=0; i<num_blocks; i++) {
+                AWD_block_info info;
+                awd_uint64 offset;
+                awd_baddr addr;
+
+                if (opts->reorder && awdrepack_block_rank(blocks[i]->get_type()) != rank)
+                    continue;
+
+                addr = blocks[i]->get_addr();
+                offset = AWD_HEADER_LENGTH + out->get_position();
+                blocks[i]->write_block(out, addr, block_comps[i], opts->level,
+                    opts->block_compression == AWDREPACK_KEEP? 0 : opts->threshold, &info);
+
+                if (toc)
+                    toc->add_entry(blocks[i], offset, &info);
+                if (name_index)
+                    name_index->add_entry(blocks[i], offset);
+
+                if (addr > max_addr)
+                    max_addr = addr;
+            }
+        }
+
+        // Same order as written by AWD::write_all_blocks()
+        if (name_index) {
+            AWD_block_info info;
+            awd_uint64 offset;
+
+            offset = AWD_HEADER_LENGTH + out->get_position();
+            name_index->write_block(out, ++max_addr,
+                opts->block_compression == AWDREPACK_KEEP? UNCOMPRESSED : (AWD_compression)opts->block_compression,
+                opts->level, opts->threshold, &info);
+
+            if (toc)
+                toc->add_entry(name_index, offset, &info);
+
+            delete name_index;
+        }
+
+        toc_offset = 0;
+        if (toc) {
+            toc_offset = AWD_HEADER_LENGTH + out->get_position();
+            toc->write_block(out, max_addr + 1);
+            delete toc;
+        }
+
+        out->flush();
+        delete out;
+
+        comp_sink->finish();
+        if (comp_sink->has_error()) {
+            printf("Could not compress %s\n", job->in_path);
+            ok = false;
+        }
+
+        if (comp_sink != &body)
+            delete comp_sink;
+
+        if (ok) {
+            ok = awdrepack_write_file(job->out_path, reader.get_major_version(),
+                reader.get_minor_version(), flags, compression, &body, toc_offset, &job->out_len);
+        }
+    }
+    else {
+        ok = false;
+    }
+
+    for (i=0; i<num_blocks; i++)
+        delete blocks[i];
+
+    free(block_comps);
+    free(blocks);
+
+    return ok;
+}
+
+
+static void
+awdrepack_job_main(void *arg)
+{
+    awdrepack_job *job = (awdrepack_job *)arg;
+
+    job->ok = awdrepack_file(job);
+}
+
+
+static char *
+awdrepack_join(const char *dir, const char *name)
+{
+    char *path;
+    size_t len;
+
+    len = strlen(dir) + 1 + strlen(name) + 1;
+    path = (char *)malloc(len);
+    snprintf(path, len, "%s/%s", dir, name);
+
+    return path;
+}
+
+
+static void
+awdrepack_add_job(awdrepack_job_list *list, const char *in_path, const char *out_path,
+    awdrepack_options *opts, awd_uint64 in_len)
+{
+    awdrepack_job *job;
+
+    if (list->num_jobs == list->max_jobs) {
+        list->max_jobs = list->max_jobs? 2*list->max_jobs : 256;
+        list->jobs = (awdrepack_job *)realloc(list->jobs, list->max_jobs * sizeof(awdrepack_job));
+    }
+
+    job = &list->jobs[list->num_jobs++];
+    job->in_path = strdup(in_path);
+    job->out_path = strdup(out_path);
+    job->opts = opts;
+    job->in_len = in_len;
+    job->out_len = 0;
+    job->ok = false;
+}
+
+
+static bool
+awdrepack_scan(const char *in_dir, const char *out_dir, awdrepack_options *opts,
+    awdrepack_job_list *list)
+{
+    DIR *dir;
+    struct dirent *entry;
+
+    dir = opendir(in_dir);
+    if (dir == NULL) {
+        printf("Could not open directory %s\n", in_dir);
+        return false;
+    }
+
+    if (mkdir(out_dir, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create directory %s\n", out_dir);
+        closedir(dir);
+        return false;
+    }
+
+    // Output mirrors the directory tree of the input
+    while ((entry = readdir(dir)) != NULL) {
+        char *in_path;
+        char *out_path;
+        size_t name_len;
+        struct stat st;
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        in_path = awdrepack_join(in_dir, entry->d_name);
+        out_path = awdrepack_join(out_dir, entry->d_name);
+        name_len = strlen(entry->d_name);
+
+        if (stat(in_path, &st) == 0) {
+            if (S_ISDIR(st.st_mode))
+                awdrepack_scan(in_path, out_path, opts, list);
+            else if (name_len > 4 && strcmp(entry->d_name + name_len - 4, ".awd") == 0)
+                awdrepack_add_job(list, in_path, out_path, opts, (awd_uint64)st.st_size);
+        }
+
+        free(in_path);
+        free(out_path);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+
+static void
+awdrepack_usage()
+{
+    printf("Usage: awd-repack [options] <input dir> <output dir>\n");
+    printf("       awd-repack [options] <input file> <output file>\n");
+    printf("  -c <type>   Compression of file body\n");
+    printf("  -b <type>   Compression of individual blocks\n");
+    printf("  -l <level>  Compression level\n");
+    printf("  -m <bytes>  Smallest block to compress (with -b, default %d)\n", AWD_BLOCK_COMPRESS_THRESHOLD);
+    printf("  -p <prec>   Precision of geometry streams (narrow or wide)\n");
+    printf("  -r          Reorder blocks by type, the way libawd writes them\n");
+    printf("  -t / -T     Write / don't write a table of contents\n");
+    printf("  -n / -N     Write / don't write a name index\n");
+    printf("  -j <num>    Number of files processed in parallel (default: one per CPU)\n");
+    printf("  -q          Don't list files\n");
+    printf("Compression types: none, deflate, lzma, lzma-chunked, zstd, lz4.\n");
+    printf("Unless specified, compression, TOC and name index are kept as in the input.\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int num_threads;
+    int num_failed;
+    bool quiet;
+    awd_uint64 in_total;
+    awd_uint64 out_total;
+    awdrepack_options opts;
+    awdrepack_job_list list;
+    void **job_ptrs;
+    struct stat st;
+
+    opts.compression = AWDREPACK_KEEP;
+    opts.block_compression = AWDREPACK_KEEP;
+    opts.level = AWD_DEFAULT_LEVEL;
+    opts.threshold = AWD_BLOCK_COMPRESS_THRESHOLD;
+    opts.precision = PRECISION_KEEP;
+    opts.reorder = false;
+    opts.toc = AWDREPACK_KEEP;
+    opts.name_index = AWDREPACK_KEEP;
+    num_threads = 0;
+    quiet = false;
+
+    while ((c = getopt(argc, argv, "c:b:l:m:p:rtTnNj:qh")) != -1) {
+        switch (c) {
+            case 'c':
+                opts.compression = awdrepack_parse_compression(optarg);
+                if (opts.compression == AWDREPACK_KEEP)
+                    return 2;
+                break;
+            case 'b':
+                opts.block_compression = awdrepack_parse_compression(optarg);
+                if (opts.block_compression == AWDREPACK_KEEP)
+                    return 2;
+                break;
+            case 'l':
+                opts.level = atoi(optarg);
+                break;
+            case 'm':
+                opts.threshold = (awd_uint32)atoi(optarg);
+                break;
+            case 'p':
+                if (strcmp(optarg, "narrow") == 0)
+                    opts.precision = PRECISION_NARROW;
+                else if (strcmp(optarg, "wide") == 0)
+                    opts.precision = PRECISION_WIDE;
+                else {
+                    printf("Unknown precision: %s\n", optarg);
+                    return 2;
+                }
+                break;
+            case 'r':
+                opts.reorder = true;
+                break;
+            case 't':
+                opts.toc = 1;
+                break;
+            case 'T':
+                opts.toc = 0;
+                break;
+            case 'n':
+                opts.name_index = 1;
+                break;
+            case 'N':
+                opts.name_index = 0;
+                break;
+            case 'j':
+                num_threads = atoi(optarg);
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                awdrepack_usage();
+                return 2;
+        }
+    }
+
+    if (argc - optind != 2) {
+        awdrepack_usage();
+        return 2;
+    }
+
+    list.jobs = NULL;
+    list.num_jobs = 0;
+    list.max_jobs = 0;
+
+    if (stat(argv[optind], &st) != 0) {
+        printf("Could not open %s\n", argv[optind]);
+        return 1;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (!awdrepack_scan(argv[optind], argv[optind+1], &opts, &list))
+            return 1;
+    }
+    else {
+        awdrepack_add_job(&list, argv[optind], argv[optind+1], &opts, (awd_uint64)st.st_size);
+    }
+
+    // Files vary a lot in size, so each thread takes the next file as
+    // soon as it's done with its previous one.
+    job_ptrs = (void **)malloc(list.num_jobs * sizeof(void *));
+    for (i=0; i<list.num_jobs; i++)
+        job_ptrs[i] = &list.jobs[i];
+
+    awdthread_run_jobs(awdrepack_job_main, job_ptrs, list.num_jobs,
+        awdthread_resolve_count(num_threads));
+
+    num_failed = 0;
+    in_total = 0;
+    out_total = 0;
+    for (i=0; i<list.num_jobs; i++) {
+        awdrepack_job *job = &list.jobs[i];
+
+        if (job->ok) {
+            in_total += job->in_len;
+            out_total += job->out_len;
+            if (!quiet) {
+                printf("%s: %llu -> %llu bytes\n", job->out_path,
+                    (unsigned long long)job->in_len, (unsigned long long)job->out_len);
+            }
+        }
+        else {
+            printf("%s: FAILED\n", job->in_path);
+            num_failed++;
+        }
+
+        free(job->in_path);
+        free(job->out_path);
+    }
+
+    printf("%d files repacked, %d failed, %llu -> %llu bytes\n", list.num_jobs - num_failed,
+        num_failed, (unsigned long long)in_total, (unsigned long long)out_total);
+
+    free(job_ptrs);
+    free(list.jobs);
+
+    return num_failed? 1 : 0;
+}
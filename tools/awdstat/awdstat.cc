@@ -0,0 +1,511 @@
+/**
+ * awd-stat: Lists the blocks of AWD files, and breaks their size down
+ * per block type, geometry stream type and attribute list, comparing
+ * stored (compressed) and uncompressed sizes.
+ *
+ * Files are memory-mapped and only blocks that need to be looked into
+ * (e.g. geometries) are parsed, without copying any data, so that it is
+ * fast enough to run over large sets of files.
+*/
+#include <cstdio>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "libawd.h"
+
+
+// Attribute lists are counted per kind of element they belong to
+typedef enum {
+    ATTR_BLOCK=0,
+    ATTR_SUB_MESH,
+    ATTR_METHOD,
+    ATTR_NUM_OWNERS
+} awdstat_attr_owner;
+
+typedef struct {
+    awd_uint64 num;
+    awd_uint64 stored;
+    awd_uint64 length;
+} awdstat_count;
+
+typedef struct {
+    int num_files;
+    awd_uint64 file_bytes;
+    awd_uint64 body_stored;
+    awd_uint64 body_length;
+    awdstat_count blocks[256];
+    awdstat_count streams[256];
+    awdstat_count props[ATTR_NUM_OWNERS];
+    awdstat_count user_attrs[ATTR_NUM_OWNERS];
+} awdstat_totals;
+
+
+static const char *
+awdstat_block_type_name(int type)
+{
+    switch (type) {
+        case NULL_REF:          return "NULL_REF";
+        case TRI_GEOM:          return "TRI_GEOM";
+        case PRIM_GEOM:         return "PRIM_GEOM";
+        case SCENE:             return "SCENE";
+        case CONTAINER:         return "CONTAINER";
+        case MESH_INSTANCE:     return "MESH_INSTANCE";
+        case LIGHT:             return "LIGHT";
+        case CAMERA:            return "CAMERA";
+        case SOUND_SOURCE:      return "SOUND_SOURCE";
+        case BSP_TREE:          return "BSP_TREE";
+        case OCT_TREE:          return "OCT_TREE";
+        case SIMPLE_MATERIAL:   return "SIMPLE_MATERIAL";
+        case BITMAP_TEXTURE:    return "BITMAP_TEXTURE";
+        case CUBE_TEXTURE:      return "CUBE_TEXTURE";
+        case SKELETON:          return "SKELETON";
+        case SKELETON_POSE:     return "SKELETON_POSE";
+        case SKELETON_ANIM:     return "SKELETON_ANIM";
+        case UV_ANIM:           return "UV_ANIM";
+        case NAME_INDEX:        return "NAME_INDEX";
+        case TOC:               return "TOC";
+        case NAMESPACE:         return "NAMESPACE";
+        case METADATA:          return "METADATA";
+    }
+
+    return NULL;
+}
+
+
+static const char *
+awdstat_stream_type_name(int type)
+{
+    switch (type) {
+        case VERTICES:          return "VERTICES";
+        case TRIANGLES:         return "TRIANGLES";
+        case UVS:               return "UVS";
+        case VERTEX_NORMALS:    return "VERTEX_NORMALS";
+        case VERTEX_TANGENTS:   return "VERTEX_TANGENTS";
+        case JOINT_INDICES:     return "JOINT_INDICES";
+        case VERTEX_WEIGHTS:    return "VERTEX_WEIGHTS";
+    }
+
+    return NULL;
+}
+
+
+static const char *
+awdstat_compression_name(AWD_compression compression)
+{
+    switch (compression) {
+        case UNCOMPRESSED:      return "uncompressed";
+        case DEFLATE:           return "deflate";
+        case LZMA:              return "lzma";
+        case LZMA_CHUNKED:      return "lzma (chunked)";
+        case ZSTD:              return "zstandard";
+        case LZ4:               return "lz4";
+    }
+
+    return "unknown";
+}
+
+
+static void
+awdstat_add(awdstat_count *count, awd_uint64 stored, awd_uint64 length)
+{
+    count->num++;
+    count->stored += stored;
+    count->length += length;
+}
+
+
+static void
+awdstat_add_list(awdstat_count *count, AWD_data_view list)
+{
+    // Stored length includes the length field preceding the list
+    awdstat_add(count, sizeof(awd_uint32) + list.length, list.length);
+}
+
+
+static bool
+awdstat_get_list(AWDCursor *cur, AWD_data_view *list)
+{
+    list->length = cur->get_ui32();
+    list->data = cur->get_bytes(list->length);
+
+    return !cur->has_error();
+}
+
+
+static void
+awdstat_count_geom(awdstat_totals *t, AWD_data_view body)
+{
+    awd_uint16 i;
+    AWDGeomView geom;
+
+    if (!geom.parse(body))
+        return;
+
+    awdstat_add_list(&t->props[ATTR_BLOCK], geom.get_properties());
+    awdstat_add_list(&t->user_attrs[ATTR_BLOCK], geom.get_user_attributes());
+
+    for (i=0; i<geom.get_num_subs(); i++) {
+        AWD_sub_view *sub;
+        AWD_stream_view str;
+
+        sub = geom.get_sub_at(i);
+        awdstat_add_list(&t->props[ATTR_SUB_MESH], sub->properties);
+        awdstat_add_list(&t->user_attrs[ATTR_SUB_MESH], sub->user_attributes);
+
+        // Stream header is type, data type and length
+        AWDStreamIterator it(sub->streams);
+        while (it.next(&str)) {
+            awdstat_add(&t->streams[str.type], 6 + str.data.length, str.data.length);
+        }
+    }
+}
+
+
+static void
+awdstat_count_material(awdstat_totals *t, AWD_data_view body)
+{
+    int i;
+    awd_uint8 num_methods;
+    AWD_data_view list;
+    AWDCursor cur(body.data, body.length);
+
+    // Same layout as written by AWDMaterial::write_body()
+    cur.get_bytes(cur.get_ui16());
+    cur.get_ui8();
+    num_methods = cur.get_ui8();
+    if (!awdstat_get_list(&cur, &list))
+        return;
+    awdstat_add_list(&t->props[ATTR_BLOCK], list);
+
+    for (i=0; i<num_methods; i++) {
+        cur.get_ui16();
+        if (!awdstat_get_list(&cur, &list))
+            return;
+        awdstat_add_list(&t->props[ATTR_METHOD], list);
+
+        if (!awdstat_get_list(&cur, &list))
+            return;
+        awdstat_add_list(&t->user_attrs[ATTR_METHOD], list);
+    }
+
+    if (awdstat_get_list(&cur, &list))
+        awdstat_add_list(&t->user_attrs[ATTR_BLOCK], list);
+}
+
+
+static void
+awdstat_count_trailing_lists(awdstat_totals *t, AWDCursor *cur)
+{
+    AWD_data_view list;
+
+    // Properties followed by user attributes, which is how most
+    // block bodies end.
+    if (!awdstat_get_list(cur, &list))
+        return;
+    awdstat_add_list(&t->props[ATTR_BLOCK], list);
+
+    if (awdstat_get_list(cur, &list))
+        awdstat_add_list(&t->user_attrs[ATTR_BLOCK], list);
+}
+
+
+static void
+awdstat_count_body(awdstat_totals *t, AWD_block_view *block, AWD_data_view body)
+{
+    AWDCursor cur(body.data, body.length);
+
+    switch (block->type) {
+        case TRI_GEOM:
+            awdstat_count_geom(t, body);
+            break;
+
+        case SIMPLE_MATERIAL:
+            awdstat_count_material(t, body);
+            break;
+
+        case BITMAP_TEXTURE:
+            // Name, type and URL or embedded data
+            cur.get_bytes(cur.get_ui16());
+            cur.get_ui8();
+            cur.get_bytes(cur.get_ui32());
+            awdstat_count_trailing_lists(t, &cur);
+            break;
+
+        case SCENE:
+        case CONTAINER:
+        case MESH_INSTANCE:
+            // Common fields (narrow matrix, like the writer) and, for
+            // mesh instances, geometry and material addresses.
+            cur.get_bytes(sizeof(awd_baddr) + 12 * sizeof(awd_float32));
+            cur.get_bytes(cur.get_ui16());
+            if (block->type == MESH_INSTANCE) {
+                cur.get_ui32();
+                cur.get_bytes(cur.get_ui16() * sizeof(awd_baddr));
+            }
+            awdstat_count_trailing_lists(t, &cur);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+static double
+awdstat_ratio(awd_uint64 stored, awd_uint64 length)
+{
+    if (length == 0)
+        return 1.0;
+
+    return (double)stored / (double)length;
+}
+
+
+static void
+awdstat_print_count(const char *label, awdstat_count *count)
+{
+    printf("  %-24s %8llu %12llu %12llu %6.3f\n", label,
+        (unsigned long long)count->num, (unsigned long long)count->stored,
+        (unsigned long long)count->length, awdstat_ratio(count->stored, count->length));
+}
+
+
+static void
+awdstat_print_totals(awdstat_totals *t)
+{
+    int i;
+    char label[32];
+    static const char *owners[] = { "block", "sub-mesh", "method" };
+
+    printf("  %-24s %8s %12s %12s %6s\n", "", "count", "stored", "length", "ratio");
+
+    printf("  %-24s %8d %12llu %12llu %6.3f\n", "files", t->num_files,
+        (unsigned long long)t->file_bytes, (unsigned long long)t->body_length,
+        awdstat_ratio(t->file_bytes, t->body_length));
+    printf("  %-24s %8s %12llu %12llu %6.3f\n", "body", "",
+        (unsigned long long)t->body_stored, (unsigned long long)t->body_length,
+        awdstat_ratio(t->body_stored, t->body_length));
+
+    printf("\n  Blocks:\n");
+    for (i=0; i<256; i++) {
+        const char *name;
+
+        if (t->blocks[i].num == 0)
+            continue;
+
+        name = awdstat_block_type_name(i);
+        if (name == NULL) {
+            snprintf(label, sizeof(label), "type %d", i);
+            name = label;
+        }
+
+        awdstat_print_count(name, &t->blocks[i]);
+    }
+
+    printf("\n  Geometry streams:\n");
+    for (i=0; i<256; i++) {
+        const char *name;
+
+        if (t->streams[i].num == 0)
+            continue;
+
+        name = awdstat_stream_type_name(i);
+        if (name == NULL) {
+            snprintf(label, sizeof(label), "type %d", i);
+            name = label;
+        }
+
+        awdstat_print_count(name, &t->streams[i]);
+    }
+
+    printf("\n  Attribute lists:\n");
+    for (i=0; i<ATTR_NUM_OWNERS; i++) {
+        if (t->props[i].num) {
+            snprintf(label, sizeof(label), "%s properties", owners[i]);
+            awdstat_print_count(label, &t->props[i]);
+        }
+
+        if (t->user_attrs[i].num) {
+            snprintf(label, sizeof(label), "%s user attributes", owners[i]);
+            awdstat_print_count(label, &t->user_attrs[i]);
+        }
+    }
+}
+
+
+static void
+awdstat_merge(awdstat_totals *dst, awdstat_totals *src)
+{
+    int i;
+
+    dst->num_files += src->num_files;
+    dst->file_bytes += src->file_bytes;
+    dst->body_stored += src->body_stored;
+    dst->body_length += src->body_length;
+
+    for (i=0; i<256; i++) {
+        dst->blocks[i].num += src->blocks[i].num;
+        dst->blocks[i].stored += src->blocks[i].stored;
+        dst->blocks[i].length += src->blocks[i].length;
+        dst->streams[i].num += src->streams[i].num;
+        dst->streams[i].stored += src->streams[i].stored;
+        dst->streams[i].length += src->streams[i].length;
+    }
+
+    for (i=0; i<ATTR_NUM_OWNERS; i++) {
+        dst->props[i].num += src->props[i].num;
+        dst->props[i].stored += src->props[i].stored;
+        dst->props[i].length += src->props[i].length;
+        dst->user_attrs[i].num += src->user_attrs[i].num;
+        dst->user_attrs[i].stored += src->user_attrs[i].stored;
+        dst->user_attrs[i].length += src->user_attrs[i].length;
+    }
+}
+
+
+static bool
+awdstat_file(const char *path, awdstat_totals *t, bool list_blocks)
+{
+    int i;
+    struct stat st;
+    AWDReader reader;
+
+    if (stat(path, &st) != 0 || !reader.open_file(path))
+        return false;
+
+    // Stored size of the body is what is left of the file besides
+    // header and (if any) TOC footer.
+    t->num_files = 1;
+    t->file_bytes = (awd_uint64)st.st_size;
+    t->body_length = reader.get_body_length();
+    t->body_stored = t->file_bytes - AWD_HEADER_LENGTH;
+    if (reader.has_flag(AWD_TOC) && t->body_stored >= AWD_TOC_FOOTER_LENGTH)
+        t->body_stored -= AWD_TOC_FOOTER_LENGTH;
+
+    if (list_blocks) {
+        printf("%s: version %d.%d, %s, flags 0x%x, %d blocks\n", path,
+            reader.get_major_version(), reader.get_minor_version(),
+            awdstat_compression_name(reader.get_compression()),
+            reader.get_flags(), reader.get_num_blocks());
+        printf("  %6s %8s %-16s %10s %10s %6s  %s\n", "addr", "ns", "type",
+            "stored", "length", "ratio", "name");
+    }
+
+    for (i=0; i<reader.get_num_blocks(); i++) {
+        AWD_block_view *block;
+        AWD_data_view body;
+        awd_uint32 stored_len;
+
+        block = reader.get_block_at(i);
+        if (!reader.get_body(i, &body)) {
+            body.data = NULL;
+            body.length = 0;
+        }
+
+        stored_len = AWD_BLOCK_HEADER_LENGTH + block->stored.length;
+        awdstat_add(&t->blocks[block->type], stored_len, AWD_BLOCK_HEADER_LENGTH + body.length);
+        awdstat_count_body(t, block, body);
+
+        if (list_blocks) {
+            const char *type_name;
+            const char *name;
+            awd_uint16 name_len;
+            char label[16];
+
+            type_name = awdstat_block_type_name(block->type);
+            if (type_name == NULL) {
+                snprintf(label, sizeof(label), "type %d", block->type);
+                type_name = label;
+            }
+
+            name = awdreader_get_block_name(block->type, body, &name_len);
+            printf("  %6u %8d %-16s %10u %10u %6.3f  %.*s\n", block->addr, block->ns,
+                type_name, block->stored.length, body.length,
+                awdstat_ratio(block->stored.length, body.length),
+                (int)name_len, name? name : "");
+        }
+    }
+
+    if (list_blocks)
+        printf("\n");
+
+    return true;
+}
+
+
+static void
+awdstat_usage()
+{
+    printf("Usage: awd-stat [-s] [-t] file ...\n");
+    printf("  -s  Summaries only, don't list blocks\n");
+    printf("  -t  Totals over all files only\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int num_failed;
+    bool list_blocks;
+    bool per_file;
+    awdstat_totals *totals;
+    awdstat_totals *file_totals;
+
+    list_blocks = true;
+    per_file = true;
+    while ((c = getopt(argc, argv, "sth")) != -1) {
+        switch (c) {
+            case 's':
+                list_blocks = false;
+                break;
+            case 't':
+                list_blocks = false;
+                per_file = false;
+                break;
+            default:
+                awdstat_usage();
+                return 2;
+        }
+    }
+
+    if (optind >= argc) {
+        awdstat_usage();
+        return 2;
+    }
+
+    totals = (awdstat_totals *)calloc(1, sizeof(awdstat_totals));
+    file_totals = (awdstat_totals *)malloc(sizeof(awdstat_totals));
+
+    num_failed = 0;
+    for (i=optind; i<argc; i++) {
+        memset(file_totals, 0, sizeof(awdstat_totals));
+        if (!awdstat_file(argv[i], file_totals, list_blocks)) {
+            printf("%s: could not read file\n", argv[i]);
+            num_failed++;
+            continue;
+        }
+
+        if (per_file) {
+            if (!list_blocks)
+                printf("%s:\n", argv[i]);
+            awdstat_print_totals(file_totals);
+            printf("\n");
+        }
+
+        awdstat_merge(totals, file_totals);
+    }
+
+    if (!per_file || totals->num_files > 1) {
+        printf("Total:\n");
+        awdstat_print_totals(totals);
+    }
+
+    free(file_totals);
+    free(totals);
+
+    return num_failed? 1 : 0;
+}
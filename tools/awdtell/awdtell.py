@@ -25,6 +25,7 @@ BT_MESH_INST = 23
 BT_SKELETON = 101
 BT_SKELPOSE = 102
 BT_SKELANIM = 103
+BT_TOC = 253
 
 
 def printl(str=''):
@@ -36,7 +37,8 @@ def printl(str=''):
 
 
 def print_header(data):
-    compressions = ('uncompressed', 'deflate (file-level)', 'lzma (file-level)')
+    compressions = ('uncompressed', 'deflate (file-level)', 'lzma (file-level)',
+        'lzma (chunked)', 'zstandard (file-level)', 'lz4 (file-level)')
     header = struct.unpack_from('<BBHBI', data, 3)
 
     if header[3] < len(compressions):
@@ -49,7 +51,35 @@ def print_header(data):
     printl('body size:    %d (%s)' % (header[4], hex(header[4])))
     printl()
 
-    return (header[3], header[2] & 2, header[2] & 4)
+    return (header[3], header[2] & 2, header[2] & 4, header[2] & 8)
+
+def decompress(compression, data):
+    if compression == 1:
+        return zlib.decompress(data)
+    elif compression == 2:
+        import pylzma
+
+        uncompressed_len = struct.unpack_from('<I', data, 0)[0]
+        return pylzma.decompress(data[4:], uncompressed_len, uncompressed_len)
+    elif compression == 3:
+        # Sequence of chunks, each a length-prefixed LZMA body
+        chunks = []
+        chunk_offs = 0
+        while chunk_offs < len(data):
+            chunk_len = struct.unpack_from('<I', data, chunk_offs)[0]
+            chunks.append(decompress(2, data[chunk_offs+4 : chunk_offs+4+chunk_len]))
+            chunk_offs += 4 + chunk_len
+        return b''.join(chunks)
+    elif compression == 4:
+        import zstandard
+
+        return zstandard.ZstdDecompressor().decompressobj().decompress(data)
+    elif compression == 5:
+        import lz4.frame
+
+        return lz4.frame.decompress(data)
+
+    return None
 
 def read_var_str(data, offs=0):
     len = struct.unpack_from('<H', data, offs)
@@ -295,6 +325,21 @@ def print_mesh_data(data):
     offs += print_user_attributes(data[offs:])
 
 
+def print_toc(data):
+    global indent_level
+
+    num_entries = struct.unpack_from('<I', data, 0)[0]
+    printl('ENTRIES: %d' % num_entries)
+
+    indent_level += 1
+    for i in range(num_entries):
+        addr, type, flags, name_hash, offs, stored_len, uncompressed_len = \
+            struct.unpack_from('<IBBQQII', data, 4 + i*30)
+        printl('%d: type %d, flags %x, name %016x, offset %d, length %d/%d' % (
+            addr, type, flags, name_hash, offs, stored_len, uncompressed_len))
+    indent_level -= 1
+
+
 def print_next_block(data):
     global indent_level
 
@@ -305,6 +350,7 @@ def print_next_block(data):
     block_types[BT_SKELETON] =  'Skeleton'
     block_types[BT_SKELPOSE] =  'SkeletonPose'
     block_types[BT_SKELANIM] =  'SkeletonAnimation'
+    block_types[BT_TOC] =  'TableOfContents'
 
     block_header = struct.unpack_from('<IBBBI', data, offset)
 
@@ -323,21 +369,30 @@ def print_next_block(data):
     printl('Flags: %x' % flags)
     printl('Length: %d' % length)
 
+    # Block body compressed on its own (upper four bits of flags)
+    body = data[offset+11 : offset+11+length]
+    if flags >> 4:
+        body = decompress(flags >> 4, body[4:])
+        printl('Uncompressed length: %d' % len(body))
+
     if type == BT_MESH_INST and include&SCENE:
         printl()
-        print_mesh_instance(data[offset+11 : offset+11+length])
+        print_mesh_instance(body)
     elif type == BT_CONTAINER and include &SCENE:
         printl()
-        print_container(data[offset+11 : offset+11+length])
+        print_container(body)
     elif type == BT_MESH_DATA and include&GEOMETRY:
         printl()
-        print_mesh_data(data[offset+11 : offset+11+length])
+        print_mesh_data(body)
     elif type == BT_SKELETON and include&ANIMATION:
         printl()
-        print_skeleton(data[offset+11 : offset+11+length])
+        print_skeleton(body)
     elif type == BT_SKELPOSE and include&ANIMATION:
         printl()
-        print_skelpose(data[offset+11 : offset+11+length])
+        print_skelpose(body)
+    elif type == BT_TOC:
+        printl()
+        print_toc(body)
 
 
     printl()
@@ -367,26 +422,22 @@ if __name__ == '__main__':
         printl(file)
 
         indent_level += 1
-        compression, wide_geom, wide_mtx = print_header(data)
+        compression, wide_geom, wide_mtx, toc = print_header(data)
+
+        # TOC footer follows the body
+        if toc and data[-4:] == b'AWDT':
+            data = data[:-12]
 
         uncompressed_data = None
         if compression == 0:
             offset = 12
             uncompressed_data = data
-        elif compression == 1:
-            offset = 0
-            data = data[12:]
-            uncompressed_data = zlib.decompress(data)
-        elif compression == 2:
-            import pylzma
-
-            offset = 0
-            uncompressed_len = struct.unpack_from('<I', data, 12)[0]
-            data = data[16:]
-            uncompressed_data = pylzma.decompress(data, uncompressed_len, uncompressed_len)
         else:
-            print('unknown compression: %d' % compression)
-            sys.exit(-1)
+            offset = 0
+            uncompressed_data = decompress(compression, data[12:])
+            if uncompressed_data is None:
+                print('unknown compression: %d' % compression)
+                sys.exit(-1)
             
         if include & BLOCKS:
             while offset < len(uncompressed_data):